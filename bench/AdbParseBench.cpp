@@ -0,0 +1,231 @@
+// ADB protocol parsing micro-benchmark: the istringstream/substr parsers the
+// provider used before vs. the string_view parsers in AdbProtocol.
+//
+// Inputs are a track-devices-l block and a getprop dump. The built-in samples
+// follow real adb output; pass files to replay your own recordings:
+//   AdbParseBench [track-block-file [getprop-dump-file]]
+// Allocations are counted through a replaced global operator new.
+
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "providers/AdbProtocol.h"
+
+namespace {
+std::atomic<std::size_t> gAllocs{0};
+}
+
+void* operator new(std::size_t n) {
+    gAllocs.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+const char* kTrackLines[] = {
+    "R58M12ABCDE            device usb:1-1.2 product:beyond1lteeea model:SM_G973F device:beyond1 transport_id:3",
+    "emulator-5554          device product:sdk_gphone64_x86_64 model:sdk_gphone64_x86_64 device:emu64xa transport_id:1",
+    "0A1B2C3D4E5F           unauthorized usb:1-1.3 transport_id:7",
+    "192.168.1.23:5555      device product:oriole model:Pixel_6 device:oriole transport_id:12",
+    "HT7A1B234567           offline usb:2-1 product:marlin model:Pixel_XL device:marlin transport_id:9",
+    "ZY22FGH7KL             device usb:1-4.1 product:kane_retail model:moto_g_power device:kane transport_id:15",
+};
+
+const char* kGetpropLines[] = {
+    "[dalvik.vm.heapsize]: [512m]",
+    "[init.svc.adbd]: [running]",
+    "[persist.sys.timezone]: [Europe/Berlin]",
+    "[ro.board.platform]: [gs101]",
+    "[ro.build.fingerprint]: [google/oriole/oriole:14/AP2A.240805.005/12025142:user/release-keys]",
+    "[ro.build.id]: [AP2A.240805.005]",
+    "[ro.build.type]: [user]",
+    "[ro.build.version.release]: [14]",
+    "[ro.build.version.sdk]: [34]",
+    "[ro.build.version.security_patch]: [2024-08-05]",
+    "[ro.hardware]: [oriole]",
+    "[ro.product.brand]: [google]",
+    "[ro.product.cpu.abi]: [arm64-v8a]",
+    "[ro.product.cpu.abilist]: [arm64-v8a,armeabi-v7a,armeabi]",
+    "[ro.product.manufacturer]: [Google]",
+    "[ro.product.model]: [Pixel 6]",
+    "[ro.serialno]: [1A2B3C4D5E6F]",
+    "[sys.boot_completed]: [1]",
+};
+
+const std::vector<std::string> kWanted = {
+    "ro.product.manufacturer", "ro.product.model", "ro.build.version.release", "ro.product.cpu.abi"};
+
+// A hub's worth of devices, cycling the sample lines with distinct serials.
+std::string makeTrackBlock(std::size_t devices) {
+    std::string block;
+    for (std::size_t i = 0; i < devices; ++i) {
+        std::string_view line = kTrackLines[i % std::size(kTrackLines)];
+        block += fmt::format("SER{:06}", i);
+        block += line.substr(line.find(' '));
+        block += '\n';
+    }
+    return block;
+}
+
+// A full dump is ~1000 properties; pad the sample with vendor-style keys.
+std::string makeGetpropDump() {
+    std::string dump;
+    for (std::size_t i = 0; i < 1000; ++i) {
+        if (i % 55 == 0) {
+            dump += kGetpropLines[(i / 55) % std::size(kGetpropLines)];
+        } else {
+            dump += fmt::format("[vendor.debug.prop{:04}]: [value{}]", i, i % 7);
+        }
+        dump += '\n';
+    }
+    return dump;
+}
+
+std::string readFile(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+// The pre-AdbProtocol parse loops, minus the DeviceInfo they filled.
+std::size_t legacyTrack(const std::string& block) {
+    std::size_t n = 0;
+    std::string line;
+    std::istringstream iss(block);
+    while (std::getline(iss, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) continue;
+        std::string serial, state, product, model, device, transportId;
+        std::istringstream ws(line);
+        if (!(ws >> serial) || !(ws >> state)) continue;
+        std::string tok;
+        while (ws >> tok) {
+            if (tok.rfind("product:", 0) == 0) product = tok.substr(8);
+            else if (tok.rfind("model:", 0) == 0) model = tok.substr(6);
+            else if (tok.rfind("device:", 0) == 0) device = tok.substr(7);
+            else if (tok.rfind("transport_id:", 0) == 0) transportId = tok.substr(13);
+        }
+        n += serial.size() + model.size();
+    }
+    return n;
+}
+
+std::size_t viewTrack(const std::string& block) {
+    std::size_t n = 0;
+    adb::forEachLine(block, [&](std::string_view line) {
+        adb::TrackLine t;
+        if (adb::parseTrackLine(line, t)) n += t.serial.size() + t.model.size();
+    });
+    return n;
+}
+
+std::size_t legacyGetprop(const std::string& text) {
+    std::size_t n = 0;
+    std::istringstream iss(text);
+    std::string line;
+    auto trim = [](std::string s) {
+        size_t i = 0, j = s.size();
+        while (i < j && (unsigned char)s[i] <= 32) ++i;
+        while (j > i && (unsigned char)s[j - 1] <= 32) --j;
+        return s.substr(i, j - i);
+    };
+    while (std::getline(iss, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line.front() != '[') continue;
+        auto rb1 = line.find(']');
+        auto lb2 = line.find('[', rb1 != std::string::npos ? rb1 : 0);
+        auto rb2 = line.find(']', lb2 != std::string::npos ? lb2 : 0);
+        if (rb1 == std::string::npos || lb2 == std::string::npos || rb2 == std::string::npos) continue;
+        std::string key = trim(line.substr(1, rb1 - 1));
+        std::string val = trim(line.substr(lb2 + 1, rb2 - lb2 - 1));
+        for (const auto& w : kWanted) {
+            if (w == key) n += val.size();
+        }
+    }
+    return n;
+}
+
+std::size_t viewGetprop(const std::string& text) {
+    std::size_t n = 0;
+    adb::forEachLine(text, [&](std::string_view line) {
+        std::string_view key, val;
+        if (!adb::parseGetpropLine(line, key, val)) return;
+        for (const auto& w : kWanted) {
+            if (w == key) n += val.size();
+        }
+    });
+    return n;
+}
+
+std::size_t legacyHeader(const std::string& hdr) {
+    std::stringstream ss;
+    ss << std::hex << hdr;
+    std::size_t v = 0;
+    ss >> v;
+    return v;
+}
+
+std::size_t viewHeader(const std::string& hdr) {
+    std::size_t v = 0;
+    adb::parseHexLen4(hdr, v);
+    return v;
+}
+
+struct Result {
+    double nsPerIter;
+    double allocsPerIter;
+    std::size_t check;
+};
+
+template <typename F>
+Result measure(F&& fn, const std::string& input, std::size_t iters) {
+    std::size_t check = 0;
+    const std::size_t allocs0 = gAllocs.load();
+    const auto t0 = Clock::now();
+    for (std::size_t i = 0; i < iters; ++i) check += fn(input);
+    const auto t1 = Clock::now();
+    const std::size_t allocs = gAllocs.load() - allocs0;
+    return {std::chrono::duration<double, std::nano>(t1 - t0).count() / static_cast<double>(iters),
+            static_cast<double>(allocs) / static_cast<double>(iters), check};
+}
+
+template <typename L, typename V>
+bool row(const char* name, L&& legacy, V&& view, const std::string& input, std::size_t iters) {
+    const Result a = measure(legacy, input, iters);
+    const Result b = measure(view, input, iters);
+    if (a.check != b.check) {
+        fmt::print("mismatch in {}: legacy {} view {}\n", name, a.check, b.check);
+        return false;
+    }
+    fmt::print("{:<16} {:>9} {:>14.1f} {:>10.1f} {:>14.1f} {:>10.1f} {:>8.1f}x\n", name, input.size(),
+               a.nsPerIter, a.allocsPerIter, b.nsPerIter, b.allocsPerIter, a.nsPerIter / b.nsPerIter);
+    return true;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::string track = argc > 1 ? readFile(argv[1]) : makeTrackBlock(48);
+    const std::string dump = argc > 2 ? readFile(argv[2]) : makeGetpropDump();
+    const std::string header = "01a4";
+
+    fmt::print("{:<16} {:>9} {:>14} {:>10} {:>14} {:>10} {:>9}\n", "input", "bytes", "legacy ns", "allocs",
+               "view ns", "allocs", "speedup");
+    bool ok = row("length header", legacyHeader, viewHeader, header, 200000);
+    ok = row("track block", legacyTrack, viewTrack, track, 2000) && ok;
+    ok = row("getprop dump", legacyGetprop, viewGetprop, dump, 200) && ok;
+    return ok ? 0 : 1;
+}
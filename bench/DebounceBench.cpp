@@ -0,0 +1,116 @@
+// Debounce scheduler micro-benchmark: linear pendings_ scan vs. TimerHeap.
+//
+// Replays a simulated attach/detach storm (every uid flaps once) through the
+// worker's per-wakeup steps: enqueue pending, find next deadline, fire expired.
+// Time is simulated so the run measures bookkeeping cost only.
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "core/TimerHeap.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+constexpr std::chrono::milliseconds kDebounceMs(800);
+constexpr std::chrono::microseconds kEventSpacing(100);
+
+struct StormEvent {
+    std::string uid;
+    bool attach;
+};
+
+std::vector<StormEvent> makeStorm(std::size_t devices) {
+    std::vector<StormEvent> evts;
+    evts.reserve(devices * 3);
+    for (std::size_t i = 0; i < devices; ++i) evts.push_back({fmt::format("SER{:06}", i), true});
+    for (std::size_t i = 0; i < devices; ++i) evts.push_back({fmt::format("SER{:06}", i), false});
+    for (std::size_t i = 0; i < devices; ++i) evts.push_back({fmt::format("SER{:06}", i), true});
+    return evts;
+}
+
+// The pre-TimerHeap workerLoop(): full scan for the deadline, full scan to fire.
+std::size_t runLinear(const std::vector<StormEvent>& storm) {
+    struct Pending { bool attach; Clock::time_point deadline; };
+    std::unordered_map<std::string, Pending> pendings;
+    std::size_t fired = 0;
+    Clock::time_point now{};
+    auto wakeup = [&]() {
+        auto next = Clock::time_point::max();
+        for (const auto& kv : pendings) {
+            if (kv.second.deadline < next) next = kv.second.deadline;
+        }
+        (void)next;
+        for (auto it = pendings.begin(); it != pendings.end(); ) {
+            if (it->second.deadline <= now) { ++fired; it = pendings.erase(it); }
+            else ++it;
+        }
+    };
+    for (const auto& e : storm) {
+        now += kEventSpacing;
+        pendings[e.uid] = Pending{e.attach, now + kDebounceMs};
+        wakeup();
+    }
+    now += kDebounceMs;
+    wakeup();
+    return fired;
+}
+
+std::size_t runHeap(const std::vector<StormEvent>& storm) {
+    std::unordered_map<std::string, bool> pendings;
+    TimerHeap timers;
+    std::size_t fired = 0;
+    Clock::time_point now{};
+    std::string uid;
+    auto wakeup = [&]() {
+        (void)timers.nextDeadline();
+        while (timers.popExpired(now, uid)) {
+            pendings.erase(uid);
+            ++fired;
+        }
+    };
+    for (const auto& e : storm) {
+        now += kEventSpacing;
+        pendings[e.uid] = e.attach;
+        timers.schedule(e.uid, now + kDebounceMs);
+        wakeup();
+    }
+    now += kDebounceMs;
+    wakeup();
+    return fired;
+}
+
+template <typename F>
+double timeNsPerEvent(F&& fn, const std::vector<StormEvent>& storm, std::size_t& firedOut) {
+    const auto t0 = Clock::now();
+    firedOut = fn(storm);
+    const auto t1 = Clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / static_cast<double>(storm.size());
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::size_t> sizes = {100, 1000, 5000, 20000};
+    if (argc > 1) {
+        sizes.clear();
+        for (int i = 1; i < argc; ++i) sizes.push_back(static_cast<std::size_t>(std::strtoul(argv[i], nullptr, 10)));
+    }
+
+    fmt::print("{:>8} {:>10} {:>14} {:>14} {:>9}\n", "devices", "events", "linear ns/ev", "heap ns/ev", "speedup");
+    for (auto n : sizes) {
+        const auto storm = makeStorm(n);
+        std::size_t firedLinear = 0, firedHeap = 0;
+        const double linear = timeNsPerEvent(runLinear, storm, firedLinear);
+        const double heap = timeNsPerEvent(runHeap, storm, firedHeap);
+        if (firedLinear != firedHeap) {
+            fmt::print("mismatch: linear fired {} heap fired {}\n", firedLinear, firedHeap);
+            return 1;
+        }
+        fmt::print("{:>8} {:>10} {:>14.1f} {:>14.1f} {:>8.1f}x\n", n, storm.size(), linear, heap, linear / heap);
+    }
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Provider ingestion benchmark: DeviceManager::onEvent() per event vs.
+// DeviceManager::onEvents() per diff.
+//
+// Each round is one track-devices-sized diff: an InfoUpdated for every device
+// with a new osVersion. We time the producer side (cost of handing the diff
+// over) and end-to-end (until the published table shows the last round).
+
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "core/DeviceManager.h"
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+std::vector<DeviceEvent> makeDiff(std::size_t devices, std::size_t round) {
+    std::vector<DeviceEvent> diff;
+    diff.reserve(devices);
+    const std::string os = std::to_string(round);
+    for (std::size_t i = 0; i < devices; ++i) {
+        DeviceInfo info;
+        info.type = Type::Android;
+        info.uid = fmt::format("SER{:06}", i);
+        info.online = true;
+        info.adbState = "device";
+        info.osVersion = os;
+        diff.push_back(DeviceEvent{DeviceEvent::Kind::InfoUpdated, std::move(info)});
+    }
+    return diff;
+}
+
+void waitForRound(const DeviceManager& manager, const std::string& lastUid, std::size_t round) {
+    const std::string want = std::to_string(round);
+    for (;;) {
+        auto t = manager.table();
+        auto it = t->records.find(lastUid);
+        if (it != t->records.end() && it->second->info.osVersion == want) return;
+        std::this_thread::yield();
+    }
+}
+
+struct Result {
+    double producerUsPerDiff;
+    double endToEndEvPerSec;
+};
+
+Result run(std::size_t devices, std::size_t rounds, bool batched) {
+    // Prebuild diffs so only ingestion is measured
+    std::vector<std::vector<DeviceEvent>> diffs;
+    diffs.reserve(rounds);
+    for (std::size_t r = 1; r <= rounds; ++r) diffs.push_back(makeDiff(devices, r));
+    const std::string lastUid = diffs.back().back().info.uid;
+
+    DeviceManager manager;
+    Clock::duration producer{};
+    const auto t0 = Clock::now();
+    for (auto& diff : diffs) {
+        const auto p0 = Clock::now();
+        if (batched) {
+            manager.onEvents(std::move(diff));
+        } else {
+            for (const auto& evt : diff) manager.onEvent(evt);
+        }
+        producer += Clock::now() - p0;
+    }
+    waitForRound(manager, lastUid, rounds);
+    const auto total = Clock::now() - t0;
+
+    const double events = static_cast<double>(devices * rounds);
+    return Result{
+        std::chrono::duration<double, std::micro>(producer).count() / static_cast<double>(rounds),
+        events / std::chrono::duration<double>(total).count(),
+    };
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    const std::size_t devices = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000;
+    const std::size_t rounds = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 200;
+
+    fmt::print("{} devices x {} diffs\n", devices, rounds);
+    fmt::print("{:<8} {:>18} {:>18}\n", "mode", "producer us/diff", "end-to-end ev/s");
+    const auto single = run(devices, rounds, false);
+    fmt::print("{:<8} {:>18.2f} {:>18.0f}\n", "single", single.producerUsPerDiff, single.endToEndEvPerSec);
+    const auto batch = run(devices, rounds, true);
+    fmt::print("{:<8} {:>18.2f} {:>18.0f}\n", "batched", batch.producerUsPerDiff, batch.endToEndEvPerSec);
+    return 0;
+}
@@ -0,0 +1,429 @@
+// End-to-end pipeline benchmark: synthetic device storm -> DeviceManager ->
+// subscriber dispatch -> ExternalNotifier -> local NDJSON/TCP sink.
+//
+// StormProvider drives N synthetic Android devices the way a provider would:
+// one onEvents() batch per tick with attaches, detaches, fast flaps and
+// enrichment bursts (several InfoUpdated right after an attach). Every
+// attach/info event carries its emit sequence number as a token in `model`.
+// The manager coalesces an attach with its burst, so a delivered event
+// stands for every emit of that uid up to its token; its latency is taken
+// from the first of them. Detaches are matched by uid.
+//
+// Stages reported (ms):
+//   ingest     provider onEvents() call, per batch
+//   manager    provider emit -> subscriber callback (includes debounce/coalesce)
+//   notify     subscriber callback -> line received by the sink
+//   end2end    provider emit -> line received by the sink
+//
+// The pipeline's own per-stage histograms (core/Metrics.h) are printed after.
+//
+// Usage: PipelineBench [--devices N] [--seconds S] [--attach-rate R] [--detach-rate R]
+//                      [--flap-fraction F] [--flap-rate R] [--enrich-burst K] [--no-notifier]
+// Rates are per device per second.
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <asio.hpp>
+#include <fmt/core.h>
+#include <nlohmann/json.hpp>
+#include <spdlog/spdlog.h>
+
+#include "core/DeviceManager.h"
+#include "core/ExternalNotifier.h"
+#include "core/Metrics.h"
+
+namespace {
+using SteadyClock = std::chrono::steady_clock;
+using asio::ip::tcp;
+
+struct Config {
+    std::size_t devices{200};
+    double seconds{10.0};
+    double attachRate{0.5};
+    double detachRate{0.5};
+    double flapFraction{0.1};
+    double flapRate{4.0};
+    std::size_t enrichBurst{3};
+    bool notifier{true};
+};
+
+// Latency samples for one stage.
+class Stage {
+public:
+    void add(SteadyClock::duration d) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        samples_.push_back(std::chrono::duration<double, std::milli>(d).count());
+    }
+
+    void print(const char* name) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (samples_.empty()) {
+            fmt::print("{:<10} {:>9}\n", name, 0);
+            return;
+        }
+        std::sort(samples_.begin(), samples_.end());
+        auto pct = [this](double p) {
+            const auto idx = static_cast<std::size_t>(p * static_cast<double>(samples_.size() - 1));
+            return samples_[idx];
+        };
+        fmt::print("{:<10} {:>9} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f}\n",
+                   name, samples_.size(), pct(0.50), pct(0.99), pct(0.999), samples_.back());
+    }
+
+private:
+    std::mutex mtx_;
+    std::vector<double> samples_;
+};
+
+// Emit/delivery/receive timestamps. Subscribers run on their own threads, so
+// the sink can see a line before the tracking subscriber has recorded its
+// delivery; that case counts as 0 ms.
+class Tracker {
+public:
+    void emitted(const DeviceEvent& e, SteadyClock::time_point t) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        const std::string& uid = e.info.uid;
+        if (e.kind == DeviceEvent::Kind::Detach) {
+            // Whatever was still pending for uid is superseded, never delivered
+            open_.erase(uid);
+            samples_["D:" + uid] = Sample{t, {}, {}};
+            return;
+        }
+        open_[uid].push_back(Emit{token(e.info), t});
+    }
+    void delivered(const DeviceEvent& e, SteadyClock::time_point t) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto it = sampleFor(e.kind, e.info);
+        if (it == samples_.end() || it->second.delivered) return;
+        Sample& s = it->second;
+        s.delivered = t;
+        manager.add(t - s.emit);
+        if (s.received) {
+            notify.add(SteadyClock::duration::zero());
+            samples_.erase(it);
+        }
+    }
+    void received(DeviceEvent::Kind kind, const DeviceInfo& info, SteadyClock::time_point t) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        auto it = sampleFor(kind, info);
+        if (it == samples_.end() || it->second.received) return;
+        Sample& s = it->second;
+        s.received = t;
+        end2end.add(t - s.emit);
+        if (s.delivered) {
+            notify.add(t - *s.delivered);
+            samples_.erase(it);
+        }
+    }
+
+    Stage ingest;
+    Stage manager;
+    Stage notify;
+    Stage end2end;
+
+private:
+    struct Emit {
+        std::uint64_t token;
+        SteadyClock::time_point at;
+    };
+    struct Sample {
+        SteadyClock::time_point emit;   // first emit the delivered event covers
+        std::optional<SteadyClock::time_point> delivered;
+        std::optional<SteadyClock::time_point> received;
+    };
+    using Samples = std::unordered_map<std::string, Sample>;
+
+    static std::uint64_t token(const DeviceInfo& info) {
+        return info.model.size() > 1 ? std::strtoull(info.model.c_str() + 1, nullptr, 10) : 0;
+    }
+
+    // Sample for a delivered or received event. The first to see an
+    // attach/info event resolves it: it covers every open emit of its uid up
+    // to its token.
+    Samples::iterator sampleFor(DeviceEvent::Kind kind, const DeviceInfo& info) {
+        if (kind == DeviceEvent::Kind::Detach) return samples_.find("D:" + info.uid);
+        const std::string key = info.uid + "#" + info.model;
+        auto it = samples_.find(key);
+        if (it != samples_.end()) return it;
+        auto q = open_.find(info.uid);
+        if (q == open_.end()) return samples_.end();
+        const std::uint64_t upTo = token(info);
+        std::optional<SteadyClock::time_point> first;
+        auto& emits = q->second;
+        while (!emits.empty() && emits.front().token <= upTo) {
+            if (!first) first = emits.front().at;
+            emits.pop_front();
+        }
+        if (emits.empty()) open_.erase(q);
+        if (!first) return samples_.end();
+        return samples_.emplace(key, Sample{*first, {}, {}}).first;
+    }
+
+    std::mutex mtx_;
+    std::unordered_map<std::string, std::deque<Emit>> open_; // uid -> attach/info emits not yet delivered
+    Samples samples_; // "uid#token" or "D:uid" -> timestamps
+};
+
+// Synthetic provider producing storms into DeviceManager.
+class StormProvider {
+public:
+    StormProvider(DeviceManager& manager, Tracker& tracker, const Config& cfg)
+        : manager_(manager), tracker_(tracker), cfg_(cfg), rng_(42) {
+        devices_.resize(cfg_.devices);
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        for (std::size_t i = 0; i < devices_.size(); ++i) {
+            devices_[i].uid = fmt::format("STORM{:05}", i);
+            devices_[i].flapper = u(rng_) < cfg_.flapFraction;
+        }
+    }
+
+    // Runs on the calling thread for cfg.seconds; returns events emitted.
+    std::size_t run() {
+        const auto tick = std::chrono::milliseconds(5);
+        const double dt = std::chrono::duration<double>(tick).count();
+        const auto end = SteadyClock::now() + std::chrono::duration_cast<SteadyClock::duration>(
+                                                  std::chrono::duration<double>(cfg_.seconds));
+        std::uniform_real_distribution<double> u(0.0, 1.0);
+        std::size_t emitted = 0;
+        auto next = SteadyClock::now();
+        while (SteadyClock::now() < end) {
+            std::vector<DeviceEvent> batch;
+            for (auto& d : devices_) {
+                if (d.burstLeft > 0) {
+                    --d.burstLeft;
+                    batch.push_back(makeEvent(DeviceEvent::Kind::InfoUpdated, d));
+                    continue;
+                }
+                const double rate = d.flapper ? cfg_.flapRate : (d.online ? cfg_.detachRate : cfg_.attachRate);
+                if (u(rng_) >= rate * dt) continue;
+                d.online = !d.online;
+                if (d.online) {
+                    batch.push_back(makeEvent(DeviceEvent::Kind::Attach, d));
+                    d.burstLeft = cfg_.enrichBurst;
+                } else {
+                    batch.push_back(makeEvent(DeviceEvent::Kind::Detach, d));
+                    d.burstLeft = 0;
+                }
+            }
+            if (!batch.empty()) {
+                const auto t = SteadyClock::now();
+                for (auto& e : batch) {
+                    e.observed = t;
+                    tracker_.emitted(e, t);
+                }
+                emitted += batch.size();
+                manager_.onEvents(std::move(batch));
+                tracker_.ingest.add(SteadyClock::now() - t);
+            }
+            next += tick;
+            std::this_thread::sleep_until(next);
+        }
+        return emitted;
+    }
+
+private:
+    struct Device {
+        std::string uid;
+        bool online{false};
+        bool flapper{false};
+        std::size_t burstLeft{0};
+    };
+
+    DeviceEvent makeEvent(DeviceEvent::Kind kind, const Device& d) {
+        DeviceEvent e;
+        e.kind = kind;
+        e.info.type = Type::Android;
+        e.info.uid = d.uid;
+        e.info.online = kind != DeviceEvent::Kind::Detach;
+        if (e.info.online) {
+            e.info.adbState = "device";
+            e.info.model = fmt::format("T{}", nextToken_++);
+        }
+        return e;
+    }
+
+    DeviceManager& manager_;
+    Tracker& tracker_;
+    Config cfg_;
+    std::mt19937 rng_;
+    std::vector<Device> devices_;
+    std::uint64_t nextToken_{0};
+};
+
+// Accepts ExternalNotifier's one-line TCP connections and timestamps them.
+class Sink {
+public:
+    explicit Sink(Tracker& tracker)
+        : tracker_(tracker), acceptor_(io_, tcp::endpoint(asio::ip::make_address("127.0.0.1"), 0)) {
+        thread_ = std::thread([this]() { run(); });
+    }
+    ~Sink() {
+        running_ = false;
+        // Wake the blocking accept().
+        asio::error_code ec;
+        tcp::socket poke(io_);
+        poke.connect(acceptor_.local_endpoint(), ec);
+        poke.close(ec);
+        if (thread_.joinable()) thread_.join();
+    }
+
+    unsigned short port() const { return acceptor_.local_endpoint().port(); }
+    std::size_t lines() const { return lines_.load(); }
+
+private:
+    void run() {
+        while (running_) {
+            asio::error_code ec;
+            tcp::socket sock(io_);
+            acceptor_.accept(sock, ec);
+            if (ec) continue;
+            std::string buf;
+            std::array<char, 4096> chunk{};
+            for (;;) {
+                const std::size_t n = sock.read_some(asio::buffer(chunk), ec);
+                buf.append(chunk.data(), n);
+                if (ec) break;
+            }
+            const auto t = SteadyClock::now();
+            std::size_t start = 0;
+            for (std::size_t nl; (nl = buf.find('\n', start)) != std::string::npos; start = nl + 1) {
+                handleLine(buf.substr(start, nl - start), t);
+            }
+        }
+    }
+
+    void handleLine(const std::string& line, SteadyClock::time_point t) {
+        const auto j = nlohmann::json::parse(line, nullptr, false);
+        if (j.is_discarded()) return;
+        ++lines_;
+        DeviceInfo info;
+        info.uid = j["device"].value("uid", "");
+        info.model = j["device"].value("model", "");
+        const auto kind = j.value("event", "") == "detach" ? DeviceEvent::Kind::Detach : DeviceEvent::Kind::Attach;
+        tracker_.received(kind, info, t);
+    }
+
+    Tracker& tracker_;
+    asio::io_context io_;
+    tcp::acceptor acceptor_;
+    std::atomic<bool> running_{true};
+    std::atomic<std::size_t> lines_{0};
+    std::thread thread_;
+};
+
+void usage(const char* argv0) {
+    fmt::print(stderr,
+               "Usage: {} [--devices N] [--seconds S] [--attach-rate R] [--detach-rate R]\n"
+               "       [--flap-fraction F] [--flap-rate R] [--enrich-burst K] [--no-notifier]\n"
+               "Rates are per device per second.\n",
+               argv0);
+}
+
+// Whole string must be a non-negative number.
+bool parseNumber(const char* s, double& out) {
+    char* end = nullptr;
+    out = std::strtod(s, &end);
+    return end != s && *end == '\0' && out >= 0;
+}
+
+// nullopt (after printing why) on an unknown flag or a bad/missing value.
+std::optional<Config> parseArgs(int argc, char** argv) {
+    Config cfg;
+    for (int i = 1; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--no-notifier") {
+            cfg.notifier = false;
+            continue;
+        }
+        double* real = nullptr;
+        std::size_t* count = nullptr;
+        if (a == "--devices") count = &cfg.devices;
+        else if (a == "--seconds") real = &cfg.seconds;
+        else if (a == "--attach-rate") real = &cfg.attachRate;
+        else if (a == "--detach-rate") real = &cfg.detachRate;
+        else if (a == "--flap-fraction") real = &cfg.flapFraction;
+        else if (a == "--flap-rate") real = &cfg.flapRate;
+        else if (a == "--enrich-burst") count = &cfg.enrichBurst;
+        else {
+            fmt::print(stderr, "unknown option {}\n", a);
+            return std::nullopt;
+        }
+        if (i + 1 >= argc) {
+            fmt::print(stderr, "{} needs a value\n", a);
+            return std::nullopt;
+        }
+        double v = 0;
+        if (!parseNumber(argv[++i], v) || (count && v != static_cast<double>(static_cast<std::size_t>(v)))) {
+            fmt::print(stderr, "bad value for {}: {}\n", a, argv[i]);
+            return std::nullopt;
+        }
+        if (count) *count = static_cast<std::size_t>(v);
+        else *real = v;
+    }
+    return cfg;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    spdlog::set_level(spdlog::level::err);
+    const auto parsed = parseArgs(argc, argv);
+    if (!parsed) {
+        usage(argv[0]);
+        return 2;
+    }
+    const Config cfg = *parsed;
+    fmt::print("{} devices, {:.1f}s, attach {}/s, detach {}/s, flappers {:.0f}% at {}/s, enrich burst {}\n",
+               cfg.devices, cfg.seconds, cfg.attachRate, cfg.detachRate, cfg.flapFraction * 100,
+               cfg.flapRate, cfg.enrichBurst);
+
+    Tracker tracker;
+    std::atomic<std::size_t> delivered{0};
+    std::size_t emitted = 0;
+    std::size_t sunk = 0;
+    double elapsed = 0;
+    {
+        DeviceManager manager;
+        Sink sink(tracker);
+        manager.subscribe([&](const DeviceEvent& evt) {
+            tracker.delivered(evt, SteadyClock::now());
+            ++delivered;
+        }, DeviceManager::SubscribeOptions{});
+        std::unique_ptr<ExternalNotifier> notifier;
+        if (cfg.notifier) {
+            notifier = std::make_unique<ExternalNotifier>(manager);
+            notifier->setLocalTcpEndpoint(fmt::format("127.0.0.1:{}", sink.port()));
+        }
+
+        StormProvider storm(manager, tracker, cfg);
+        const auto t0 = SteadyClock::now();
+        emitted = storm.run();
+        // Let debounce windows close and the notifier drain.
+        std::this_thread::sleep_for(std::chrono::seconds(2));
+        elapsed = std::chrono::duration<double>(SteadyClock::now() - t0).count();
+        notifier.reset();
+        sunk = sink.lines();
+    }
+
+    fmt::print("\n{:<10} {:>9} {:>10} {:>10} {:>10} {:>10}\n", "stage", "count", "p50 ms", "p99 ms", "p999 ms", "max ms");
+    tracker.ingest.print("ingest");
+    tracker.manager.print("manager");
+    tracker.notify.print("notify");
+    tracker.end2end.print("end2end");
+    fmt::print("\ninternal stages (Metrics::global()):\n{}", Metrics::global().summary());
+    fmt::print("\nemitted {} ({:.0f} ev/s), delivered {} ({:.0f} ev/s), notified {} ({:.0f} ev/s)\n",
+               emitted, emitted / cfg.seconds, delivered.load(), delivered.load() / elapsed, sunk, sunk / elapsed);
+    return 0;
+}
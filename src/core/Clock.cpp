@@ -0,0 +1,125 @@
+#include "core/Clock.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+class RealClock : public Clock {
+public:
+    TimePoint now() const override { return std::chrono::steady_clock::now(); }
+    std::chrono::system_clock::time_point wallNow() const override { return std::chrono::system_clock::now(); }
+    void waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lk, TimePoint deadline) override {
+        if (deadline == TimePoint::max()) {
+            cv.wait(lk);
+        } else {
+            cv.wait_until(lk, deadline);
+        }
+    }
+};
+} // namespace
+
+Clock& Clock::real() {
+    static RealClock clock;
+    return clock;
+}
+
+SimulatedClock::SimulatedClock(std::chrono::system_clock::time_point wallStart)
+    : start_(TimePoint{} + std::chrono::hours(1)), now_(start_), wallStart_(wallStart) {}
+
+Clock::TimePoint SimulatedClock::now() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return now_;
+}
+
+std::chrono::system_clock::time_point SimulatedClock::wallNow() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return wallStart_ + std::chrono::duration_cast<std::chrono::system_clock::duration>(now_ - start_);
+}
+
+void SimulatedClock::waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lk, TimePoint deadline) {
+    std::uint64_t id;
+    {
+        std::lock_guard<std::mutex> g(mtx_);
+        if (now_ >= deadline) return;
+        id = nextId_++;
+        waiters_.push_back(Waiter{&cv, lk.mutex(), gen_, id});
+    }
+    parked_.notify_all();
+    // lk stays held until cv.wait releases it, so advance() cannot notify in between.
+    cv.wait(lk);
+    std::lock_guard<std::mutex> g(mtx_);
+    waiters_.erase(std::find_if(waiters_.begin(), waiters_.end(),
+                                [id](const Waiter& w) { return w.id == id; }));
+}
+
+void SimulatedClock::advance(std::chrono::nanoseconds d) {
+    advanceTo(now() + std::chrono::duration_cast<TimePoint::duration>(d));
+}
+
+void SimulatedClock::advanceTo(TimePoint t) {
+    std::vector<Waiter> wake;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (t > now_) now_ = t;
+        ++gen_;
+        wake = waiters_;
+    }
+    for (const auto& w : wake) {
+        std::lock_guard<std::mutex> lk(*w.mtx);
+        w.cv->notify_all();
+    }
+}
+
+bool SimulatedClock::waitIdle(std::size_t n, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lk(mtx_);
+    return parked_.wait_for(lk, timeout, [&]() {
+        const auto caughtUp = std::count_if(waiters_.begin(), waiters_.end(),
+                                            [this](const Waiter& w) { return w.gen == gen_; });
+        return static_cast<std::size_t>(caughtUp) >= n;
+    });
+}
+
+ClockTimer::ClockTimer(Clock& clock, std::function<void()> onDue)
+    : clock_(clock), onDue_(std::move(onDue)) {
+    thread_ = std::thread([this]() { run(); });
+}
+
+ClockTimer::~ClockTimer() {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        stop_ = true;
+    }
+    cv_.notify_all();
+    thread_.join();
+}
+
+void ClockTimer::expiresAt(Clock::TimePoint deadline) {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        deadline_ = deadline;
+    }
+    cv_.notify_all();
+}
+
+void ClockTimer::cancel() {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        deadline_.reset();
+    }
+    cv_.notify_all();
+}
+
+void ClockTimer::run() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (!stop_) {
+        if (deadline_ && clock_.now() >= *deadline_) {
+            deadline_.reset();
+            // Unlocked, so onDue may re-arm
+            lk.unlock();
+            onDue_();
+            lk.lock();
+            continue;
+        }
+        clock_.waitUntil(cv_, lk, deadline_ ? *deadline_ : Clock::TimePoint::max());
+    }
+}
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+// Time source for debounce, throttling and backoff. Components take a Clock&
+// (DeviceManager exposes its own via clock()), so tests and benchmarks can
+// swap in SimulatedClock and run long scenarios without real waiting.
+class Clock {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    virtual ~Clock() = default;
+
+    virtual TimePoint now() const = 0;
+    virtual std::chrono::system_clock::time_point wallNow() const = 0;
+
+    // cv.wait_until(lk, deadline) in this clock's time. TimePoint::max() waits
+    // for a notify only. May return early; callers re-check their condition.
+    virtual void waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lk,
+                           TimePoint deadline) = 0;
+
+    // Process-wide real clock (steady_clock / system_clock).
+    static Clock& real();
+};
+
+// Manually driven clock. Time only moves on advance(), which wakes every
+// thread parked in waitUntil() so it can re-check its deadline.
+// Objects whose condition variables are parked here must outlive any
+// concurrent advance() call.
+class SimulatedClock : public Clock {
+public:
+    // Wall time reported at the simulated start (fixed by default for reproducible runs).
+    explicit SimulatedClock(std::chrono::system_clock::time_point wallStart = {});
+
+    TimePoint now() const override;
+    std::chrono::system_clock::time_point wallNow() const override;
+    void waitUntil(std::condition_variable& cv, std::unique_lock<std::mutex>& lk,
+                   TimePoint deadline) override;
+
+    void advance(std::chrono::nanoseconds d);
+    void advanceTo(TimePoint t);
+
+    // Block (in real time) until at least n threads have parked in waitUntil()
+    // since the last advance, i.e. they have caught up with the new time.
+    // Returns false on timeout.
+    bool waitIdle(std::size_t n, std::chrono::milliseconds timeout = std::chrono::seconds(5));
+
+private:
+    struct Waiter {
+        std::condition_variable* cv;
+        std::mutex* mtx;
+        std::uint64_t gen;   // advance() generation when it parked
+        std::uint64_t id;
+    };
+
+    mutable std::mutex mtx_;
+    std::condition_variable parked_;
+    TimePoint start_;
+    TimePoint now_;
+    std::chrono::system_clock::time_point wallStart_;
+    std::uint64_t gen_{0};
+    std::uint64_t nextId_{0};
+    std::vector<Waiter> waiters_;
+};
+
+// One-shot deadline on a Clock, for code that cannot park a thread of its own
+// in waitUntil() (an io_context, say). A helper thread waits for the deadline
+// and calls onDue there; onDue typically posts back to the owner's executor.
+// Re-arming replaces the pending deadline. Under SimulatedClock it fires on
+// the advance() that reaches the deadline, and counts as one waitIdle() thread.
+class ClockTimer {
+public:
+    ClockTimer(Clock& clock, std::function<void()> onDue);
+    ~ClockTimer();
+
+    ClockTimer(const ClockTimer&) = delete;
+    ClockTimer& operator=(const ClockTimer&) = delete;
+
+    void expiresAt(Clock::TimePoint deadline);
+    void cancel();
+
+private:
+    void run();
+
+    Clock& clock_;
+    std::function<void()> onDue_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::optional<Clock::TimePoint> deadline_;
+    bool stop_{false};
+    std::thread thread_;
+};
@@ -2,191 +2,621 @@
 
 #include <algorithm>
 
+#include <spdlog/spdlog.h>
+
+#include "core/Metrics.h"
+
 namespace {
+// Attach/Detach hold-down for a stable device; flapping devices get longer.
 constexpr std::chrono::milliseconds kDebounceMs(800);
+// InfoUpdated bursts for one uid within this window are folded into one event.
+constexpr std::chrono::milliseconds kCoalesceMs(50);
+// Devices restored from the journal must be re-reported by a provider within this.
+constexpr std::chrono::seconds kRestoreGrace(15);
+// Deltas kept for changesSince().
+constexpr std::size_t kFeedCapacity = 8192;
+
+FlapDamper::Options flapOptions() {
+    FlapDamper::Options o;
+    o.baseHold = kDebounceMs;
+    return o;
+}
+
+std::uint32_t usbId(std::uint16_t vid, std::uint16_t pid) {
+    return (static_cast<std::uint32_t>(vid) << 16) | pid;
 }
 
-DeviceManager::DeviceManager() {
+// Moves uid between the buckets of one index; empty buckets are dropped.
+template <class K>
+void indexMove(DeviceManager::Table::Index<K>& idx, const std::string& uid, const K* from, const K* to) {
+    using Bucket = DeviceManager::Table::Bucket;
+    if (from && to && *from == *to) return;
+    if (from) {
+        auto it = idx.find(*from);
+        if (it != idx.end()) {
+            Bucket b = it->second;
+            b.erase(uid);
+            if (b.empty()) {
+                idx.erase(*from);
+            } else {
+                idx.insert({*from, std::move(b)});
+            }
+        }
+    }
+    if (to) {
+        auto it = idx.find(*to);
+        Bucket b = it != idx.end() ? it->second : Bucket();
+        b.insert(uid);
+        idx.insert({*to, std::move(b)});
+    }
+}
+
+template <class K>
+const DeviceManager::Table::Bucket* lookup(const DeviceManager::Table::Index<K>& idx, const K& key) {
+    static const DeviceManager::Table::Bucket kEmpty;
+    auto it = idx.find(key);
+    return it == idx.end() ? &kEmpty : &it->second;
+}
+}
+
+std::vector<DeviceManager::RecordPtr> DeviceManager::Table::query(const Query& q) const {
+    // Narrow to the smallest bucket among the indexed criteria.
+    const Bucket* best = nullptr;
+    auto consider = [&best](const Bucket* b) {
+        if (!best || b->size() < best->size()) best = b;
+    };
+    if (q.type) consider(lookup(byType, *q.type));
+    if (q.online) consider(lookup(byOnline, *q.online));
+    if (q.manufacturer) consider(lookup(byManufacturer, *q.manufacturer));
+    if (q.model) consider(lookup(byModel, *q.model));
+    if (q.osVersion) consider(lookup(byOsVersion, *q.osVersion));
+    if (q.vid && q.pid) consider(lookup(byUsbId, usbId(*q.vid, *q.pid)));
+
+    auto matches = [&q](const DeviceInfo& d) {
+        return (!q.type || d.type == *q.type) &&
+               (!q.online || d.online == *q.online) &&
+               (!q.manufacturer || d.manufacturer == *q.manufacturer) &&
+               (!q.model || d.model == *q.model) &&
+               (!q.osVersion || d.osVersion == *q.osVersion) &&
+               (!q.vid || d.vid == *q.vid) &&
+               (!q.pid || d.pid == *q.pid);
+    };
+
+    std::vector<RecordPtr> out;
+    if (best) {
+        out.reserve(best->size());
+        for (const auto& uid : *best) {
+            auto it = records.find(uid);
+            if (it != records.end() && matches(it->second->info)) out.push_back(it->second);
+        }
+    } else {
+        out.reserve(records.size());
+        for (const auto& kv : records) {
+            if (matches(kv.second->info)) out.push_back(kv.second);
+        }
+    }
+    return out;
+}
+
+DeviceManager::DeviceManager(Clock& clock)
+    : clock_(clock), feed_(kFeedCapacity), flaps_(flapOptions()) {
+    feedBase_ = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+    auto t = std::make_shared<Table>();
+    t->version = feedBase_;
+    table_ = std::move(t);
     worker_ = std::thread([this]{ workerLoop(); });
 }
 
 DeviceManager::~DeviceManager() {
     {
-        std::lock_guard<std::mutex> lk(mtx_);
+        std::scoped_lock lk(queueMtx_, mtx_);
         running_ = false;
+        // Unconfirmed restored devices stay as journaled; don't wait out their
+        // grace. Everything else is delivered now rather than after its
+        // (possibly long, flap-damped) hold-down.
+        const auto now = clock_.now();
+        for (auto it = pendings_.begin(); it != pendings_.end();) {
+            if (it->second.reconcile) {
+                timers_.cancel(it->first);
+                it = pendings_.erase(it);
+            } else {
+                timers_.schedule(it->first, now);
+                ++it;
+            }
+        }
     }
     cv_.notify_all();
     if (worker_.joinable()) worker_.join();
+    // bus_ is destroyed after this body and lets subscribers drain what the
+    // worker already published.
+    // Worker is gone; flush and close the journal before the table goes away.
+    journal_.reset();
+}
+
+DeviceManager::TablePtr DeviceManager::table() const {
+    return std::atomic_load(&table_);
 }
 
 DeviceManager::Snapshot DeviceManager::snapshot() const {
-    std::lock_guard<std::mutex> lock(mtx_);
+    auto t = table();
     Snapshot list;
-    list.reserve(devices_.size());
-    for (const auto& kv : devices_) {
-        list.push_back(kv.second);
+    list.reserve(t->records.size());
+    for (const auto& kv : t->records) {
+        list.push_back(kv.second->info);
     }
     return list;
 }
 
+DeviceManager::ChangeSet DeviceManager::changesSince(std::uint64_t seq) const {
+    std::lock_guard<std::mutex> fl(feedMtx_);
+    auto t = std::atomic_load(&table_);
+    ChangeSet out;
+    out.seq = t->version;
+    const std::uint64_t head = t->version;
+    const std::uint64_t oldest = std::max(feedBase_, head > kFeedCapacity ? head - kFeedCapacity : 0);
+    if (seq < oldest || seq > head) {
+        out.resync = true;
+        out.table = std::move(t);
+        return out;
+    }
+    out.changes.reserve(static_cast<std::size_t>(head - seq));
+    for (std::uint64_t s = seq + 1; s <= head; ++s) {
+        out.changes.push_back(feed_[s % kFeedCapacity]);
+    }
+    return out;
+}
+
+std::vector<DeviceManager::RecordPtr> DeviceManager::query(const Query& q) const {
+    return table()->query(q);
+}
+
 std::optional<std::chrono::system_clock::time_point> DeviceManager::onlineSince(const std::string& uid) const {
-    std::lock_guard<std::mutex> lock(mtx_);
-    auto it = onlineSince_.find(uid);
-    if (it == onlineSince_.end()) return std::nullopt;
-    return it->second;
+    auto t = table();
+    auto it = t->records.find(uid);
+    if (it == t->records.end()) return std::nullopt;
+    return it->second->onlineSince;
 }
 
-int DeviceManager::subscribe(Subscriber cb) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    subscribers_.push_back(std::move(cb));
-    // Return token as index+1 (0 reserved as invalid)
-    return static_cast<int>(subscribers_.size());
+int DeviceManager::subscribe(Subscriber cb, SubscribeOptions opts) {
+    return bus_.subscribe(std::move(cb), std::move(opts));
 }
 
 void DeviceManager::unsubscribe(int token) {
-    if (token <= 0) return;
-    std::lock_guard<std::mutex> lock(mtx_);
-    const size_t idx = static_cast<size_t>(token - 1);
-    if (idx < subscribers_.size()) {
-        subscribers_[idx] = nullptr; // mark as removed
-    }
+    bus_.unsubscribe(token);
+}
+
+std::optional<DeviceManager::SubscriberStats> DeviceManager::subscriberStats(int token) const {
+    return bus_.stats(token);
 }
 
 void DeviceManager::addOrUpdateDevice(const DeviceInfo& info) {
     // Not used in new flow; kept for compatibility
     std::lock_guard<std::mutex> lock(mtx_);
-    devices_[info.uid] = info;
+    devices_[info.uid].info = info;
+    dirty_.insert(info.uid);
+    publishLocked();
 }
 
 void DeviceManager::removeDevice(const std::string& uid) {
     std::lock_guard<std::mutex> lock(mtx_);
     devices_.erase(uid);
+    dirty_.insert(uid);
+    publishLocked();
+}
+
+void DeviceManager::publishLocked() {
+    if (dirty_.empty()) return;
+    auto cur = std::atomic_load(&table_);
+    auto next = std::make_shared<Table>(*cur); // O(1): copies trie roots
+    std::uint64_t seq = cur->version;
+    std::vector<Change> changes;
+    changes.reserve(dirty_.size());
+    for (const auto& uid : dirty_) {
+        auto oldIt = cur->records.find(uid);
+        const DeviceInfo* from = oldIt != cur->records.end() ? &oldIt->second->info : nullptr;
+        auto it = devices_.find(uid);
+        const DeviceInfo* to = it != devices_.end() ? &it->second.info : nullptr;
+
+        indexMove(next->byType, uid, from ? &from->type : nullptr, to ? &to->type : nullptr);
+        indexMove(next->byOnline, uid, from ? &from->online : nullptr, to ? &to->online : nullptr);
+        indexMove(next->byManufacturer, uid, from ? &from->manufacturer : nullptr, to ? &to->manufacturer : nullptr);
+        indexMove(next->byModel, uid, from ? &from->model : nullptr, to ? &to->model : nullptr);
+        indexMove(next->byOsVersion, uid, from ? &from->osVersion : nullptr, to ? &to->osVersion : nullptr);
+        const std::uint32_t fromUsb = from ? usbId(from->vid, from->pid) : 0;
+        const std::uint32_t toUsb = to ? usbId(to->vid, to->pid) : 0;
+        indexMove(next->byUsbId, uid, from ? &fromUsb : nullptr, to ? &toUsb : nullptr);
+
+        RecordPtr rec;
+        if (to) {
+            rec = std::make_shared<const Record>(it->second);
+            next->records.insert({uid, rec});
+        } else {
+            next->records.erase(uid);
+        }
+        changes.push_back(Change{++seq, uid, std::move(rec)});
+    }
+    dirty_.clear();
+    next->version = seq;
+    std::lock_guard<std::mutex> fl(feedMtx_);
+    for (auto& c : changes) feed_[c.seq % kFeedCapacity] = std::move(c);
+    std::atomic_store(&table_, TablePtr(std::move(next)));
 }
 
-void DeviceManager::mergeInfo(DeviceInfo& dst, const DeviceInfo& src) {
-    if (dst.type == Type::Unknown && src.type != Type::Unknown) dst.type = src.type;
+std::uint32_t DeviceManager::mergeInfo(DeviceInfo& dst, const DeviceInfo& src) {
+    std::uint32_t changed = 0;
+    auto setStr = [&changed](std::string& d, const std::string& v, std::uint32_t bit) {
+        if (!v.empty() && d != v) { d = v; changed |= bit; }
+    };
+    if (dst.type == Type::Unknown && src.type != Type::Unknown) { dst.type = src.type; changed |= DeviceField::Type; }
     if (!src.uid.empty()) dst.uid = src.uid;
-    if (!src.displayName.empty()) dst.displayName = src.displayName;
-    dst.online = src.online;
-    if (!src.transport.empty()) dst.transport = src.transport;
-    if (!src.model.empty()) dst.model = src.model;
-    if (!src.adbState.empty()) dst.adbState = src.adbState;
-    if (!src.manufacturer.empty()) dst.manufacturer = src.manufacturer;
-    if (!src.osVersion.empty()) dst.osVersion = src.osVersion;
-    if (!src.abi.empty()) dst.abi = src.abi;
-    if (!src.productType.empty()) dst.productType = src.productType;
-    if (!src.deviceName.empty()) dst.deviceName = src.deviceName;
-    if (src.vid) dst.vid = src.vid;
-    if (src.pid) dst.pid = src.pid;
-    if (!src.usbPath.empty()) dst.usbPath = src.usbPath;
+    setStr(dst.displayName, src.displayName, DeviceField::DisplayName);
+    if (dst.online != src.online) { dst.online = src.online; changed |= DeviceField::Online; }
+    setStr(dst.transport, src.transport, DeviceField::Transport);
+    setStr(dst.model, src.model, DeviceField::Model);
+    setStr(dst.adbState, src.adbState, DeviceField::AdbState);
+    setStr(dst.manufacturer, src.manufacturer, DeviceField::Manufacturer);
+    setStr(dst.osVersion, src.osVersion, DeviceField::OsVersion);
+    setStr(dst.abi, src.abi, DeviceField::Abi);
+    setStr(dst.productType, src.productType, DeviceField::ProductType);
+    setStr(dst.deviceName, src.deviceName, DeviceField::DeviceName);
+    if (src.vid && dst.vid != src.vid) { dst.vid = src.vid; changed |= DeviceField::Vid; }
+    if (src.pid && dst.pid != src.pid) { dst.pid = src.pid; changed |= DeviceField::Pid; }
+    setStr(dst.usbPath, src.usbPath, DeviceField::UsbPath);
+    if (src.usbSpeedMbps && dst.usbSpeedMbps != src.usbSpeedMbps) {
+        dst.usbSpeedMbps = src.usbSpeedMbps;
+        changed |= DeviceField::UsbSpeed;
+    }
+    return changed;
 }
 
 void DeviceManager::onEvent(const DeviceEvent& evt) {
+    const auto t = std::chrono::steady_clock::now();
+    recordIngest(evt, t);
     {
-        std::lock_guard<std::mutex> lock(mtx_);
-        queue_.push(evt);
+        std::lock_guard<std::mutex> lock(queueMtx_);
+        if (incoming_.empty()) incoming_.push_back(Chunk{t, {}});
+        incoming_.back().events.push_back(evt);
+        Metrics::global().queueDepth.set(static_cast<std::int64_t>(++queuedEvents_));
     }
     cv_.notify_one();
 }
 
-void DeviceManager::workerLoop() {
-    for (;;) {
-        std::unique_lock<std::mutex> lk(mtx_);
-        // Compute next deadline to wait for
-        auto nextDeadline = std::chrono::steady_clock::time_point::max();
-        for (const auto& kv : pendings_) {
-            if (kv.second.deadline < nextDeadline) nextDeadline = kv.second.deadline;
-        }
+void DeviceManager::onEvents(std::vector<DeviceEvent>&& evts) {
+    if (evts.empty()) return;
+    const auto t = std::chrono::steady_clock::now();
+    for (const auto& e : evts) recordIngest(e, t);
+    {
+        // The whole diff is queued as one chunk: O(1) under the lock.
+        std::lock_guard<std::mutex> lock(queueMtx_);
+        queuedEvents_ += evts.size();
+        Metrics::global().queueDepth.set(static_cast<std::int64_t>(queuedEvents_));
+        incoming_.push_back(Chunk{t, std::move(evts)});
+    }
+    cv_.notify_one();
+    evts.clear();
+}
 
-        if (!running_ && queue_.empty() && pendings_.empty()) {
+void DeviceManager::recordIngest(const DeviceEvent& evt, std::chrono::steady_clock::time_point t) {
+    auto& m = Metrics::global();
+    m.eventsIn.add();
+    if (evt.observed != std::chrono::steady_clock::time_point{}) {
+        m.stage(Metrics::Stage::Ingest).record(t - evt.observed);
+    }
+}
+
+void DeviceManager::applyLocked(const DeviceEvent& evt, std::chrono::steady_clock::time_point now) {
+    const std::string& uid = evt.info.uid;
+    switch (evt.kind) {
+        case DeviceEvent::Kind::Attach: {
+            const auto hold = reportPresenceLocked(uid, true, now);
+            auto dit = devices_.find(uid);
+            auto pit = pendings_.find(uid);
+            const bool announced = dit != devices_.end() && dit->second.onlineSince.has_value();
+            if (announced && (pit == pendings_.end() || pit->second.kind != DeviceEvent::Kind::Attach)) {
+                // Subscribers already know this device (restored from the
+                // journal, or back before its Detach went out): confirm it
+                // and report only what changed.
+                if (pit != pendings_.end() && pit->second.kind == DeviceEvent::Kind::Detach) {
+                    if (!pit->second.reconcile) suppressFlapLocked(uid);
+                    timers_.cancel(uid);
+                    pendings_.erase(pit);
+                    // Subscribers never saw it go offline.
+                    dit->second.info.online = true;
+                    dirty_.insert(uid);
+                }
+                DeviceEvent upd{DeviceEvent::Kind::InfoUpdated, evt.info};
+                upd.info.online = true;
+                applyLocked(upd, now);
+                break;
+            }
+            auto& entry = devices_[uid].info;
+            mergeInfo(entry, evt.info);
+            entry.online = true;
+            dirty_.insert(uid);
+            // schedule debounced attach
+            pendings_[uid] = Debounced{DeviceEvent::Kind::Attach, entry, DeviceField::All, false, now};
+            timers_.schedule(uid, now + hold);
             break;
         }
-
-        if (queue_.empty() && running_) {
-            if (nextDeadline == std::chrono::steady_clock::time_point::max()) {
-                cv_.wait(lk);
+        case DeviceEvent::Kind::InfoUpdated: {
+            auto& entry = devices_[uid].info;
+            const std::uint32_t changed = mergeInfo(entry, evt.info);
+            if (changed == 0) break; // no-op update: suppress entirely
+            dirty_.insert(uid);
+            auto pit = pendings_.find(uid);
+            if (pit != pendings_.end()) {
+                // Fold into whatever is already pending for this uid; a
+                // pending Attach/Detach supersedes the update.
+                pit->second.changed |= changed;
+                if (pit->second.kind != DeviceEvent::Kind::Detach) pit->second.info = entry;
             } else {
-                cv_.wait_until(lk, nextDeadline);
+                pendings_[uid] = Debounced{DeviceEvent::Kind::InfoUpdated, entry, changed, false, now};
+                // deadline is not pushed back by later updates, bounding the delay
+                timers_.schedule(uid, now + kCoalesceMs);
             }
+            break;
         }
+        case DeviceEvent::Kind::Detach: {
+            const auto hold = reportPresenceLocked(uid, false, now);
+            auto it = devices_.find(uid);
+            auto pit = pendings_.find(uid);
+            if (it != devices_.end() && !it->second.onlineSince && pit != pendings_.end() &&
+                pit->second.kind == DeviceEvent::Kind::Attach) {
+                // Gone again before its Attach went out: nobody heard of it.
+                suppressFlapLocked(uid);
+                timers_.cancel(uid);
+                pendings_.erase(pit);
+                devices_.erase(it);
+                dirty_.insert(uid);
+                break;
+            }
+            if (it != devices_.end()) {
+                it->second.info.online = false;
+                dirty_.insert(uid);
+                pendings_[uid] = Debounced{DeviceEvent::Kind::Detach, it->second.info, DeviceField::All, false, now};
+            } else {
+                // still create a pending detach with minimal info
+                Debounced d{DeviceEvent::Kind::Detach, evt.info, DeviceField::All, false, now};
+                d.info.online = false;
+                pendings_[uid] = std::move(d);
+            }
+            timers_.schedule(uid, now + hold);
+            break;
+        }
+    }
+}
 
-        // Pop all queued events
-        while (!queue_.empty()) {
-            DeviceEvent evt = queue_.front();
-            queue_.pop();
-            const std::string uid = evt.info.uid;
-            auto now = std::chrono::steady_clock::now();
-
-            switch (evt.kind) {
-                case DeviceEvent::Kind::Attach: {
-                    auto& entry = devices_[uid];
-                    mergeInfo(entry, evt.info);
-                    entry.online = true;
-                    // schedule debounced attach
-                    Debounced d{DeviceEvent::Kind::Attach, entry, now + kDebounceMs};
-                    pendings_[uid] = d;
-                    break;
-                }
-                case DeviceEvent::Kind::InfoUpdated: {
-                    auto& entry = devices_[uid];
-                    mergeInfo(entry, evt.info);
-                    // immediate notify
-                    std::vector<Subscriber> subs = subscribers_;
-                    DeviceEvent out{DeviceEvent::Kind::InfoUpdated, entry};
-                    lk.unlock();
-                    for (auto& s : subs) if (s) s(out);
-                    lk.lock();
-                    break;
-                }
-                case DeviceEvent::Kind::Detach: {
-                    auto it = devices_.find(uid);
-                    if (it != devices_.end()) {
-                        it->second.online = false;
-                        Debounced d{DeviceEvent::Kind::Detach, it->second, now + kDebounceMs};
-                        pendings_[uid] = d;
-                    } else {
-                        // still create a pending detach with minimal info
-                        Debounced d{DeviceEvent::Kind::Detach, evt.info, now + kDebounceMs};
-                        d.info.online = false;
-                        pendings_[uid] = d;
-                    }
-                    break;
-                }
+std::chrono::milliseconds DeviceManager::reportPresenceLocked(const std::string& uid, bool online,
+                                                              std::chrono::steady_clock::time_point now) {
+    std::lock_guard<std::mutex> fl(flapMtx_);
+    return flaps_.report(uid, online, now);
+}
+
+void DeviceManager::suppressFlapLocked(const std::string& uid) {
+    {
+        std::lock_guard<std::mutex> fl(flapMtx_);
+        flaps_.suppressed(uid);
+    }
+    Metrics::global().flapSuppressed.add();
+}
+
+std::optional<DeviceManager::FlapState> DeviceManager::flapState(const std::string& uid) const {
+    const auto now = clock_.now();
+    std::lock_guard<std::mutex> fl(flapMtx_);
+    return flaps_.state(uid, now);
+}
+
+std::vector<std::pair<std::string, DeviceManager::FlapState>> DeviceManager::flappingDevices() const {
+    const auto now = clock_.now();
+    std::lock_guard<std::mutex> fl(flapMtx_);
+    return flaps_.flapping(now);
+}
+
+void DeviceManager::restoreLocked(const EventJournal::Entry& e) {
+    const std::string& uid = e.evt.info.uid;
+    if (uid.empty()) return;
+    if (e.state || e.evt.kind == DeviceEvent::Kind::Attach) {
+        auto& rec = devices_[uid];
+        mergeInfo(rec.info, e.evt.info);
+        if (e.onlineSince) rec.onlineSince = e.onlineSince;
+        else if (!e.state && !rec.onlineSince) rec.onlineSince = e.ts;
+    } else if (e.evt.kind == DeviceEvent::Kind::Detach) {
+        devices_.erase(uid);
+    } else {
+        auto it = devices_.find(uid);
+        if (it != devices_.end()) mergeInfo(it->second.info, e.evt.info);
+    }
+    dirty_.insert(uid);
+}
+
+std::vector<EventJournal::Entry> DeviceManager::checkpoint() const {
+    PersistentMap<std::string, RecordPtr> delivered;
+    {
+        std::lock_guard<std::mutex> dl(deliveredMtx_);
+        delivered = delivered_; // O(1): copies the trie root
+    }
+    const auto now = clock_.wallNow();
+    std::vector<EventJournal::Entry> out;
+    out.reserve(delivered.size());
+    for (const auto& kv : delivered) {
+        EventJournal::Entry e;
+        e.state = true;
+        e.ts = now;
+        e.onlineSince = kv.second->onlineSince;
+        e.evt.info = kv.second->info;
+        out.push_back(std::move(e));
+    }
+    return out;
+}
+
+void DeviceManager::noteDeliveredLocked(const DeviceEvent& evt) {
+    if (!trackDelivered_) return;
+    const std::string& uid = evt.info.uid;
+    std::lock_guard<std::mutex> dl(deliveredMtx_);
+    if (evt.kind == DeviceEvent::Kind::Detach) {
+        delivered_.erase(uid);
+        return;
+    }
+    Record rec;
+    rec.info = evt.info;
+    auto it = devices_.find(uid);
+    if (it != devices_.end()) rec.onlineSince = it->second.onlineSince;
+    delivered_.insert({uid, std::make_shared<const Record>(std::move(rec))});
+}
+
+bool DeviceManager::openJournal(const std::string& dir) {
+    EventJournal::Options opts;
+    opts.dir = dir;
+    return openJournal(opts);
+}
+
+bool DeviceManager::openJournal(const EventJournal::Options& opts) {
+    const std::string& dir = opts.dir;
+    const auto t0 = std::chrono::steady_clock::now();
+    std::size_t records = 0;
+    std::size_t restored = 0;
+    {
+        std::scoped_lock lk(queueMtx_, mtx_);
+        if (journal_) return true;
+        records = EventJournal::restore(dir, [this](const EventJournal::Entry& e) { restoreLocked(e); });
+        // Everything restored is provisional until a provider reports it again.
+        const auto now = clock_.now();
+        const auto deadline = now + kRestoreGrace;
+        for (const auto& kv : devices_) {
+            Debounced d{DeviceEvent::Kind::Detach, kv.second.info, DeviceField::All, true, now};
+            d.info.online = false;
+            pendings_[kv.first] = std::move(d);
+            timers_.schedule(kv.first, deadline);
+        }
+        restored = devices_.size();
+        publishLocked();
+        // Restored devices were announced by the run that journaled them.
+        {
+            std::lock_guard<std::mutex> dl(deliveredMtx_);
+            delivered_ = table()->records;
+        }
+        trackDelivered_ = true;
+    }
+    cv_.notify_one();
+    const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0);
+    spdlog::info("[journal] restored {} device(s) from {} record(s) in {} ms", restored, records, ms.count());
+
+    auto journal = std::make_unique<EventJournal>(opts);
+    if (!journal->open([this]() { return checkpoint(); })) return false;
+    std::lock_guard<std::mutex> lk(mtx_);
+    journal_ = std::move(journal);
+    return true;
+}
+
+std::size_t DeviceManager::replayJournal(const std::string& dir, const ReplayOptions& opts) {
+    std::vector<EventJournal::Entry> entries;
+    EventJournal::replay(dir, [&](const EventJournal::Entry& e) {
+        if (e.state || e.ts < opts.from || e.ts > opts.to) return;
+        entries.push_back(e);
+    });
+
+    std::optional<std::chrono::system_clock::time_point> prev;
+    for (const auto& e : entries) {
+        if (opts.speed > 0 && prev && e.ts > *prev) {
+            const std::chrono::duration<double> gap = e.ts - *prev;
+            std::this_thread::sleep_for(gap / opts.speed);
+        }
+        prev = e.ts;
+        DeviceEvent evt = e.evt;
+        evt.delivered = e.ts;
+        std::lock_guard<std::mutex> pl(publishMtx_);
+        bus_.publish(evt);
+    }
+    return entries.size();
+}
+
+void DeviceManager::workerLoop() {
+    auto& metrics = Metrics::global();
+    std::vector<Chunk> chunks;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> qlk(queueMtx_);
+            // Next deadline is the heap top: O(1)
+            const auto nextDeadline = timers_.nextDeadline();
+
+            if (!running_ && incoming_.empty() && pendings_.empty()) {
+                break;
             }
+
+            if (incoming_.empty()) {
+                clock_.waitUntil(cv_, qlk, nextDeadline);
+            }
+            // Take everything queued in one swap.
+            chunks.swap(incoming_);
+            queuedEvents_ = 0;
+            metrics.queueDepth.set(0);
+        }
+
+        const auto taken = std::chrono::steady_clock::now();
+        for (const auto& chunk : chunks) {
+            metrics.stage(Metrics::Stage::Queue).record(taken - chunk.queued);
         }
 
+        std::unique_lock<std::mutex> lk(mtx_);
+        const auto now = clock_.now();
+        for (const auto& chunk : chunks) {
+            for (const auto& evt : chunk.events) applyLocked(evt, now);
+        }
+        chunks.clear();
+
         // Fire any expired debounced events
         std::vector<DeviceEvent> toSend;
-        auto nowtp = std::chrono::steady_clock::now();
-        for (auto it = pendings_.begin(); it != pendings_.end(); ) {
-            if (it->second.deadline <= nowtp) {
-                const std::string uid = it->first;
-                Debounced d = it->second;
-                if (d.kind == DeviceEvent::Kind::Detach) {
-                    // remove device entry
-                    devices_.erase(uid);
-                    onlineSince_.erase(uid);
-                } else {
-                    // ensure device is online
-                    devices_[uid].online = true;
-                    // set onlineSince if not set
-                    if (onlineSince_.find(uid) == onlineSince_.end()) {
-                        onlineSince_[uid] = std::chrono::system_clock::now();
-                    }
-                }
-                toSend.push_back(DeviceEvent{d.kind, d.info});
-                it = pendings_.erase(it);
+        auto nowtp = clock_.now();
+        const auto wall = clock_.wallNow();
+        std::string uid;
+        while (timers_.popExpired(nowtp, uid)) {
+            auto it = pendings_.find(uid);
+            if (it == pendings_.end()) continue;
+            Debounced d = std::move(it->second);
+            pendings_.erase(it);
+            metrics.stage(Metrics::Stage::Debounce).record(nowtp - d.since);
+            if (d.kind == DeviceEvent::Kind::Detach) {
+                // remove device entry (onlineSince goes with it)
+                devices_.erase(uid);
+            } else if (d.kind == DeviceEvent::Kind::InfoUpdated) {
+                // nothing to apply; the table already holds the merged info
             } else {
-                ++it;
+                // ensure device is online
+                auto& rec = devices_[uid];
+                rec.info.online = true;
+                // set onlineSince if not set
+                if (!rec.onlineSince.has_value()) {
+                    rec.onlineSince = wall;
+                }
             }
+            dirty_.insert(uid);
+            toSend.push_back(DeviceEvent{d.kind, std::move(d.info), d.changed});
+            toSend.back().delivered = wall;
+        }
+
+        metrics.pending.set(static_cast<std::int64_t>(pendings_.size()));
+        {
+            std::lock_guard<std::mutex> fl(flapMtx_);
+            metrics.flapping.set(static_cast<std::int64_t>(flaps_.flappingCount(nowtp)));
+        }
+
+        // Make this round's changes visible to readers before notifying.
+        publishLocked();
+
+        for (const auto& e : toSend) noteDeliveredLocked(e);
+        if (journal_) {
+            for (const auto& e : toSend) journal_->append(e, wall);
         }
 
         if (!toSend.empty()) {
-            std::vector<Subscriber> subs = subscribers_;
+            // Outside mtx_: a Block subscriber may hold up the writer.
             lk.unlock();
-            for (auto& e : toSend) {
-                for (auto& s : subs) if (s) s(e);
+            {
+                std::lock_guard<std::mutex> pl(publishMtx_);
+                for (const auto& e : toSend) bus_.publish(e);
             }
+            metrics.eventsOut.add(toSend.size());
             lk.lock();
         }
     }
@@ -3,31 +3,125 @@
 #include <functional>
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <mutex>
-#include <queue>
+#include <memory>
+#include <thread>
 #include <condition_variable>
 #include <chrono>
+#include <cstdint>
 #include <optional>
 
+#include "core/Clock.h"
 #include "core/DeviceModel.h"
+#include "core/EventBus.h"
+#include "core/EventJournal.h"
+#include "core/FlapDamper.h"
+#include "core/PersistentMap.h"
+#include "core/TimerHeap.h"
 
 class DeviceManager {
 public:
     using Snapshot = std::vector<DeviceInfo>;
     using Subscriber = std::function<void(const DeviceEvent&)>;
+    // Each subscription reads the event bus on its own thread with its own
+    // overflow policy and filter.
+    using Overflow = EventBus::Overflow;
+    using SubscribeOptions = EventBus::Options;
+    using SubscriberStats = EventBus::Stats;
+    using FlapState = FlapDamper::State;
 
-    DeviceManager();
+    // One device in the published table; onlineSince travels with the info.
+    struct Record {
+        DeviceInfo info;
+        std::optional<std::chrono::system_clock::time_point> onlineSince;
+    };
+    using RecordPtr = std::shared_ptr<const Record>;
+
+    // Filter for Table::query(); unset fields match anything.
+    struct Query {
+        std::optional<Type> type;
+        std::optional<bool> online;
+        std::optional<std::string> manufacturer;
+        std::optional<std::string> model;
+        std::optional<std::string> osVersion;
+        std::optional<std::uint16_t> vid;   // 0 = no USB info yet
+        std::optional<std::uint16_t> pid;
+    };
+
+    // Immutable, versioned device table. The worker builds a new one on change
+    // and swaps it in atomically. Records and indexes are persistent tries, so
+    // the new version shares everything but the paths to the changed uids:
+    // publishing costs O(changed * log n), not O(fleet).
+    struct Table {
+        std::uint64_t version{0};   // seq of the last mutation included
+        PersistentMap<std::string, RecordPtr> records; // uid -> record
+
+        // Secondary indexes: key -> uids. A device moving between buckets
+        // path-copies both buckets and the index, nothing else.
+        using Bucket = PersistentSet<std::string>;
+        template <class K>
+        using Index = PersistentMap<K, Bucket>;
+        Index<Type> byType;
+        Index<bool> byOnline;
+        Index<std::string> byManufacturer;
+        Index<std::string> byModel;
+        Index<std::string> byOsVersion;
+        Index<std::uint32_t> byUsbId;     // (vid << 16) | pid
+
+        // Records matching q; cost is bounded by the smallest matching bucket.
+        std::vector<RecordPtr> query(const Query& q) const;
+    };
+    using TablePtr = std::shared_ptr<const Table>;
+
+    // One applied mutation: the record after the change, or null once removed.
+    struct Change {
+        std::uint64_t seq{0};
+        std::string uid;
+        RecordPtr record;
+    };
+    struct ChangeSet {
+        std::uint64_t seq{0};        // pass this to the next changesSince() call
+        bool resync{false};          // deltas unavailable; reload from table
+        TablePtr table;              // full state at seq (set when resync)
+        std::vector<Change> changes; // ascending seq; a uid may repeat
+    };
+
+    // Debounce/coalesce deadlines and onlineSince follow clock.
+    explicit DeviceManager(Clock& clock = Clock::real());
     ~DeviceManager();
 
+    // Time source shared with providers and notifiers attached to this manager.
+    Clock& clock() const { return clock_; }
+
+    // Current device table; a single atomic pointer load, never takes mtx_.
+    TablePtr table() const;
     // Return a copy of the current device list.
     Snapshot snapshot() const;
+    // Mutations after seq from a bounded ring of recent deltas, or a resync
+    // marker when seq is older than the ring (or from another process run:
+    // sequence numbers start from the startup time in microseconds).
+    ChangeSet changesSince(std::uint64_t seq) const;
+    // Shorthand for table()->query(q).
+    std::vector<RecordPtr> query(const Query& q) const;
     // Return onlineSince timestamp if device is currently known online.
     std::optional<std::chrono::system_clock::time_point> onlineSince(const std::string& uid) const;
 
-    // Subscribe to device events (thread-safe). Returns token index.
-    int subscribe(Subscriber cb);
+    // Flap damping: a device that keeps changing presence gets an exponentially
+    // longer debounce hold-down, decaying back once it is stable. Empty for
+    // uids that have not been seen recently.
+    std::optional<FlapState> flapState(const std::string& uid) const;
+    // Devices currently in hold-down, noisiest first.
+    std::vector<std::pair<std::string, FlapState>> flappingDevices() const;
+
+    // Subscribe to device events (thread-safe). Returns token (> 0), or 0 when
+    // EventBus::kMaxSubscribers are registered.
+    // Callbacks run on the subscription's own thread, never on the worker.
+    int subscribe(Subscriber cb, SubscribeOptions opts = {});
     void unsubscribe(int token);
+    // Queue/lag counters for a subscription; nullopt for unknown tokens.
+    std::optional<SubscriberStats> subscriberStats(int token) const;
 
     // The below helpers are stubs for future expansion.
     void addOrUpdateDevice(const DeviceInfo& info);
@@ -35,26 +129,103 @@ public:
 
     // Provider pushes an event into manager; manager updates its store and notifies subscribers.
     void onEvent(const DeviceEvent& evt);
+    // Batch form for providers that produce a whole diff at once: one lock
+    // acquisition and one worker wakeup for the lot. Events keep their order.
+    void onEvents(std::vector<DeviceEvent>&& evts);
+
+    // Rebuild the table (with onlineSince) from the journal in dir, then journal
+    // every delivered event there. Restored devices that no provider reports
+    // again within a grace period are detached; re-reported ones produce no
+    // Attach. Call before providers start. Returns false if dir is unusable.
+    bool openJournal(const std::string& dir);
+    // Same, with segment size and commit timing from opts (opts.dir is the dir).
+    bool openJournal(const EventJournal::Options& opts);
+
+    struct ReplayOptions {
+        std::chrono::system_clock::time_point from{std::chrono::system_clock::time_point::min()};
+        std::chrono::system_clock::time_point to{std::chrono::system_clock::time_point::max()};
+        double speed{0.0}; // multiple of real time; 0 = no pacing
+    };
+    // Offline debugging: deliver journaled events within [from, to] to the
+    // current subscribers. The live table is untouched. Returns events delivered.
+    std::size_t replayJournal(const std::string& dir, const ReplayOptions& opts);
 
 private:
     void workerLoop();
-    static void mergeInfo(DeviceInfo& dst, const DeviceInfo& src);
+    // Apply one provider event to devices_/pendings_ (worker thread, mtx_ held).
+    void applyLocked(const DeviceEvent& evt, std::chrono::steady_clock::time_point now);
+    void publishLocked();
+    // Feed the flap damper a provider-reported presence; returns the hold-down.
+    std::chrono::milliseconds reportPresenceLocked(const std::string& uid, bool online,
+                                                   std::chrono::steady_clock::time_point now);
+    // A presence change cancelled a pending event before subscribers saw it.
+    void suppressFlapLocked(const std::string& uid);
+    // Apply one journal entry directly (no debounce) while restoring.
+    void restoreLocked(const EventJournal::Entry& e);
+    // Announced state (delivered_) as journal checkpoint entries.
+    std::vector<EventJournal::Entry> checkpoint() const;
+    // Fold an event just handed to subscribers into delivered_ (mtx_ held).
+    void noteDeliveredLocked(const DeviceEvent& evt);
+    // Merge non-empty fields of src into dst; returns DeviceField bits that changed.
+    static std::uint32_t mergeInfo(DeviceInfo& dst, const DeviceInfo& src);
+    // Counts an incoming event and its provider-side latency.
+    static void recordIngest(const DeviceEvent& evt, std::chrono::steady_clock::time_point t);
+
+    Clock& clock_;
 
     mutable std::mutex mtx_;
-    std::unordered_map<std::string, DeviceInfo> devices_; // uid -> info
-    std::vector<Subscriber> subscribers_;                 // simple subscriber list
-    std::unordered_map<std::string, std::chrono::system_clock::time_point> onlineSince_; // uid -> since
+    std::unordered_map<std::string, Record> devices_;     // uid -> working record (worker side)
+    std::unordered_set<std::string> dirty_;               // uids changed since last publish
+    std::unique_ptr<EventJournal> journal_;               // optional, see openJournal()
+    // What subscribers have been told, as the journal sees it. Checkpoints
+    // are built from this rather than the table, which also holds devices
+    // whose Attach is still debounced. Kept from openJournal() on; the
+    // worker writes it under mtx_ + deliveredMtx_, checkpoint() takes only
+    // deliveredMtx_ (it runs on the journal's committer thread).
+    mutable std::mutex deliveredMtx_;
+    PersistentMap<std::string, RecordPtr> delivered_;
+    bool trackDelivered_{false};
 
-    // Event queue + worker
-    std::queue<DeviceEvent> queue_;
+    // Published table; accessed only via std::atomic_load/atomic_store.
+    TablePtr table_;
+
+    // Change feed ring, indexed by seq % capacity. publishLocked fills it and
+    // stores table_ under feedMtx_ so changesSince sees both consistently.
+    mutable std::mutex feedMtx_;
+    std::vector<Change> feed_;
+    std::uint64_t feedBase_{0};                           // seq of the empty initial table
+
+    // Event queue + worker. Ingestion only takes queueMtx_, so providers never
+    // wait for the worker's merge/debounce work under mtx_.
+    std::mutex queueMtx_;
+    struct Chunk {
+        std::chrono::steady_clock::time_point queued;     // arrival of the first event
+        std::vector<DeviceEvent> events;
+    };
+    std::vector<Chunk> incoming_;                         // ordered chunks, swapped out whole by the worker
+    std::size_t queuedEvents_{0};
     std::condition_variable cv_;
     std::thread worker_;
     bool running_{true};
 
+    // Delivery to subscribers. The bus takes a single writer: the worker, or
+    // replayJournal() when it runs; publishMtx_ keeps them apart.
+    EventBus bus_;
+    std::mutex publishMtx_;
+
+    // Worker state below: used by the worker under mtx_; other threads touch it
+    // only with both queueMtx_ and mtx_ held (openJournal).
+
     struct Debounced {
         DeviceEvent::Kind kind;
-        DeviceInfo info; // latest info snapshot used for final event
-        std::chrono::steady_clock::time_point deadline;
+        DeviceInfo info;            // latest info snapshot used for final event
+        std::uint32_t changed{0};   // accumulated DeviceField bits
+        bool reconcile{false};      // Detach of a journal-restored device not yet re-reported
+        Clock::TimePoint since{};   // when the hold started
     };
-    std::unordered_map<std::string, Debounced> pendings_; // uid -> pending attach/detach
+    std::unordered_map<std::string, Debounced> pendings_; // uid -> pending attach/detach/coalesced update
+    TimerHeap timers_;                                    // uid -> debounce deadline
+    // Written by the worker under mtx_ too; readers only take flapMtx_.
+    mutable std::mutex flapMtx_;
+    FlapDamper flaps_;
 };
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <string>
 
 // Device platform/type
@@ -19,6 +21,7 @@ struct DeviceInfo {
     // Android extras (optional for other platforms)
     std::string model;           // e.g., "Pixel 7"
     std::string adbState;        // e.g., "device", "offline", "unauthorized"
+    std::uint32_t usbSpeedMbps{0}; // negotiated USB speed (adb proto tracker only)
 
     // Enrichment fields from getprop (Android)
     std::string manufacturer;    // ro.product.manufacturer
@@ -35,8 +38,36 @@ struct DeviceInfo {
     std::string usbPath;        // device interface path / symlink
 };
 
+// Bit flags naming DeviceInfo fields; used as change masks on events.
+namespace DeviceField {
+constexpr std::uint32_t Type         = 1u << 0;
+constexpr std::uint32_t DisplayName  = 1u << 1;
+constexpr std::uint32_t Online       = 1u << 2;
+constexpr std::uint32_t Transport    = 1u << 3;
+constexpr std::uint32_t Model        = 1u << 4;
+constexpr std::uint32_t AdbState     = 1u << 5;
+constexpr std::uint32_t Manufacturer = 1u << 6;
+constexpr std::uint32_t OsVersion    = 1u << 7;
+constexpr std::uint32_t Abi          = 1u << 8;
+constexpr std::uint32_t ProductType  = 1u << 9;
+constexpr std::uint32_t DeviceName   = 1u << 10;
+constexpr std::uint32_t Vid          = 1u << 11;
+constexpr std::uint32_t Pid          = 1u << 12;
+constexpr std::uint32_t UsbPath      = 1u << 13;
+constexpr std::uint32_t UsbSpeed     = 1u << 14;
+constexpr std::uint32_t All          = (1u << 15) - 1;
+} // namespace DeviceField
+
 struct DeviceEvent {
     enum class Kind { Attach, Detach, InfoUpdated };
     Kind kind{Kind::InfoUpdated};
     DeviceInfo info; // current info snapshot for the device related to the event
+    // DeviceField bits that changed. Set by DeviceManager on outgoing events
+    // (All for Attach/Detach); ignored on events pushed by providers.
+    std::uint32_t changed{0};
+    // When the provider parsed the event (optional, for latency metrics).
+    std::chrono::steady_clock::time_point observed{};
+    // Wall time DeviceManager delivered it (clock().wallNow()); on replay,
+    // the time it was journaled.
+    std::chrono::system_clock::time_point delivered{};
 };
@@ -1,28 +1,535 @@
 #include "core/EventBus.h"
 
-int EventBus::subscribe(Callback cb) {
-    std::lock_guard<std::mutex> lock(mtx_);
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+#include "core/Metrics.h"
+
+namespace {
+constexpr std::uint64_t kNoGate = std::numeric_limits<std::uint64_t>::max();
+// Yields before falling back to a condition variable.
+constexpr int kSpins = 64;
+
+std::size_t roundUpPow2(std::size_t n) {
+    std::size_t c = 2;
+    while (c < n) c <<= 1;
+    return c;
+}
+} // namespace
+
+// Immutable interest index, rebuilt on (un)subscribe. The writer matches each
+// event once against it; subscribers with a uid set are indexed by uid, so
+// events for other devices never reach their filter.
+struct EventBus::Interest {
+    static constexpr std::size_t kKinds = 3;
+    struct Route {
+        std::uint64_t bit;
+        EventFilter filter;
+    };
+    std::vector<Route> routes;
+    std::array<std::vector<std::size_t>, kKinds> anyUid;                                 // kind -> routes
+    std::array<std::unordered_map<std::string, std::vector<std::size_t>>, kKinds> byUid; // kind -> uid -> routes
+
+    // Registry bits of the subscribers whose filter accepts evt.
+    std::uint64_t match(const DeviceEvent& evt) const {
+        const auto k = static_cast<std::size_t>(evt.kind);
+        std::uint64_t out = 0;
+        auto check = [&](std::size_t r) {
+            if (routes[r].filter.matches(evt.kind, evt.info, evt.changed)) out |= routes[r].bit;
+        };
+        for (std::size_t r : anyUid[k]) check(r);
+        if (byUid[k].empty()) return out;
+        auto it = byUid[k].find(evt.info.uid);
+        if (it == byUid[k].end()) return out;
+        for (std::size_t r : it->second) check(r);
+        return out;
+    }
+};
+
+struct EventBus::Core {
+    // An event body. Readers pin it while they copy it out; the writer only
+    // refills bodies that no slot points at and nobody has pinned.
+    struct Stored {
+        std::atomic<std::uint32_t> pins{0};
+        DeviceEvent evt;
+    };
+    // Slot header, read seqlock-style: a reader loads seq, the fields and
+    // then seq again, and treats any change as being lapped. The writer sets
+    // seq to kNoGate before touching the fields.
+    struct Slot {
+        std::atomic<std::uint64_t> seq{kNoGate};
+        std::atomic<std::uint64_t> interest{0}; // registry bits of the subscribers that want it
+        std::atomic<std::chrono::steady_clock::rep> published{0};
+        std::atomic<Stored*> stored{nullptr};
+    };
+
+    // Where one subscriber sleeps; only the writer's interest mask wakes it.
+    struct Park {
+        std::mutex mtx;
+        std::condition_variable cv;
+    };
+
+    explicit Core(std::size_t capacity)
+        : size(roundUpPow2(capacity)), mask(size - 1), sweepMask(size / 2 - 1), slots(new Slot[size]),
+          interest(new Interest()) {
+        for (auto& g : gates) g.store(kNoGate);
+        for (auto& u : used) u.store(false);
+        storage.reserve(size + 1);
+        for (std::size_t i = 0; i < size; ++i) {
+            storage.push_back(std::make_unique<Stored>());
+            slots[i].stored.store(storage.back().get());
+        }
+        storage.push_back(std::make_unique<Stored>());
+        spare.push_back(storage.back().get());
+    }
+    ~Core() { delete interest.load(); }
+
+    const std::size_t size;
+    const std::size_t mask;
+    const std::size_t sweepMask; // every half ring, idle subscribers skip ahead
+    std::unique_ptr<Slot[]> slots;
+
+    // Event bodies, writer only: one per slot plus spares. A spare is only
+    // refilled once unpinned; the pool grows by at most one per reader.
+    std::vector<std::unique_ptr<Stored>> storage;
+    std::deque<Stored*> spare;
+
+    // Current interest index. The writer announces the one it is matching
+    // against in interestInUse (a single hazard pointer); replaced indexes
+    // wait in retired until it has moved on. retired is guarded by the
+    // bus's ctlMtx_.
+    std::atomic<const Interest*> interest;
+    std::atomic<const Interest*> interestInUse{nullptr};
+    std::vector<std::unique_ptr<const Interest>> retired;
+
+    alignas(64) std::atomic<std::uint64_t> cursor{0}; // seqs below this are readable
+
+    // Registry, one entry per subscriber: the next seq a Block subscriber still
+    // needs (kNoGate for lossy or free entries). All the writer ever reads.
+    std::array<std::atomic<std::uint64_t>, kMaxSubscribers> gates;
+    std::array<std::atomic<bool>, kMaxSubscribers> used;
+    std::atomic<std::size_t> high{0}; // entries at or above this are unused
+
+    // Wait strategy once spinning gives up.
+    std::array<Park, kMaxSubscribers> parks;
+    std::atomic<std::uint64_t> parked{0}; // registry bits of sleeping subscribers
+    std::mutex waitMtx;                   // writer side
+    std::condition_variable writable;
+    std::atomic<bool> writerWaiting{false};
+
+    std::uint64_t minGate() const {
+        std::uint64_t m = kNoGate;
+        const std::size_t n = high.load();
+        for (std::size_t i = 0; i < n; ++i) m = std::min(m, gates[i].load());
+        return m;
+    }
+
+    // Block until every gating subscriber has moved past seq need - 1.
+    void waitWritable(std::uint64_t need) {
+        if (minGate() >= need) return;
+        for (int i = 0; i < kSpins; ++i) {
+            std::this_thread::yield();
+            if (minGate() >= need) return;
+        }
+        std::unique_lock<std::mutex> lk(waitMtx);
+        writerWaiting.store(true);
+        writable.wait(lk, [&]() { return minGate() >= need; });
+        writerWaiting.store(false);
+    }
+
+    // Wake the sleeping subscribers among bits.
+    void wakeReaders(std::uint64_t bits) {
+        bits &= parked.load();
+        for (std::size_t i = 0; bits != 0; ++i, bits >>= 1) {
+            if ((bits & 1) == 0) continue;
+            std::lock_guard<std::mutex> lk(parks[i].mtx);
+            parks[i].cv.notify_all();
+        }
+    }
+
+    void wakeWriter() {
+        if (!writerWaiting.load()) return;
+        std::lock_guard<std::mutex> lk(waitMtx);
+        writable.notify_all();
+    }
+
+    int claim() {
+        for (std::size_t i = 0; i < kMaxSubscribers; ++i) {
+            bool expected = false;
+            if (!used[i].compare_exchange_strong(expected, true)) continue;
+            std::size_t h = high.load();
+            while (h < i + 1 && !high.compare_exchange_weak(h, i + 1)) {}
+            return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    void release(int idx) {
+        gates[idx].store(kNoGate);
+        used[idx].store(false);
+        wakeWriter();
+    }
+
+    // Writer: an unpinned body to fill, growing the pool if every spare is
+    // still being copied from.
+    Stored* takeSpare() {
+        for (auto it = spare.begin(); it != spare.end(); ++it) {
+            if ((*it)->pins.load() != 0) continue;
+            Stored* s = *it;
+            spare.erase(it);
+            return s;
+        }
+        storage.push_back(std::make_unique<Stored>());
+        return storage.back().get();
+    }
+
+    // Writer: the current index, protected from reclamation until
+    // interestInUse is cleared.
+    const Interest* acquireInterest() {
+        const Interest* in = interest.load();
+        for (;;) {
+            interestInUse.store(in);
+            const Interest* again = interest.load();
+            if (again == in) return in;
+            in = again;
+        }
+    }
+
+    // Swap in a new index and free the old ones the writer is not using
+    // (ctlMtx_ held).
+    void replaceInterest(std::unique_ptr<const Interest> next) {
+        retired.emplace_back(interest.exchange(next.release()));
+        const Interest* inUse = interestInUse.load();
+        retired.erase(std::remove_if(retired.begin(), retired.end(),
+                                     [inUse](const std::unique_ptr<const Interest>& r) { return r.get() != inUse; }),
+                      retired.end());
+    }
+};
+
+class EventBus::Consumer : public std::enable_shared_from_this<Consumer> {
+public:
+    Consumer(std::shared_ptr<Core> core, int idx, std::uint64_t start, Callback cb, Options opts)
+        : core_(std::move(core)), idx_(idx), bit_(std::uint64_t{1} << idx), gating_(opts.overflow == Overflow::Block),
+          cb_(std::move(cb)), opts_(std::move(opts)), pos_(start) {}
+
+    ~Consumer() {
+        if (thread_.joinable()) thread_.detach();
+    }
+
+    void start() {
+        thread_ = std::thread([self = shared_from_this()]() { self->run(); });
+    }
+
+    std::uint64_t bit() const { return bit_; }
+    // Before start() only.
+    void seek(std::uint64_t seq) {
+        pos_.store(seq);
+        trustFrom_ = seq + 1;
+    }
+    const EventFilter& filter() const { return opts_.filter; }
+
+    // drain=true delivers everything published before the call first.
+    void stop(bool drain) {
+        stopAt_.store(drain ? core_->cursor.load() : 0);
+        {
+            std::lock_guard<std::mutex> lk(core_->parks[idx_].mtx);
+            core_->parks[idx_].cv.notify_all();
+        }
+        if (!thread_.joinable()) return;
+        if (std::this_thread::get_id() == thread_.get_id()) {
+            thread_.detach();
+        } else {
+            thread_.join();
+        }
+    }
+
+    Stats stats() const {
+        Stats s;
+        s.enqueued = enqueued_.load();
+        s.delivered = delivered_.load();
+        s.dropped = dropped_.load();
+        s.coalesced = coalesced_.load();
+        const std::uint64_t cur = core_->cursor.load();
+        const std::uint64_t pos = pos_.load();
+        s.queued = static_cast<std::size_t>(cur > pos ? cur - pos : 0);
+        s.maxQueued = static_cast<std::size_t>(maxQueued_.load());
+        return s;
+    }
+
+private:
+    enum class Read { Ok, Filtered, Lapped };
+
+    // Never waits for the writer, and the writer never waits for us: a slot
+    // rewritten meanwhile reads as lapped.
+    Read readSlot(std::uint64_t seq, DeviceEvent& out) {
+        auto& slot = core_->slots[seq & core_->mask];
+        if (slot.seq.load() != seq) return Read::Lapped;
+        Core::Stored* stored = slot.stored.load();
+        const std::uint64_t interest = slot.interest.load();
+        const auto published = slot.published.load();
+        // Pin the body, then confirm the slot still holds seq: from here on
+        // the writer will not refill it.
+        stored->pins.fetch_add(1);
+        if (slot.seq.load() != seq) {
+            stored->pins.fetch_sub(1);
+            return Read::Lapped;
+        }
+        // The writer may have matched the start slot against an index from
+        // before we subscribed, where our bit still meant its previous
+        // holder: decide that one by our own filter.
+        const DeviceEvent& evt = stored->evt;
+        const bool wanted = seq < trustFrom_ ? opts_.filter.matches(evt.kind, evt.info, evt.changed)
+                                             : (interest & bit_) != 0;
+        if (wanted) out = evt; // reuses out's string capacity
+        stored->pins.fetch_sub(1);
+        if (!wanted) return Read::Filtered;
+        const std::chrono::steady_clock::time_point at{std::chrono::steady_clock::duration(published)};
+        Metrics::global().stage(Metrics::Stage::Dispatch).record(std::chrono::steady_clock::now() - at);
+        return Read::Ok;
+    }
+
+    // The writer lapped us: jump to the oldest slot it cannot be rewriting now.
+    void skipLapped(std::uint64_t& next) {
+        const std::uint64_t cur = core_->cursor.load();
+        const std::uint64_t oldest = cur > core_->size ? cur - core_->size + 1 : 0;
+        const std::uint64_t to = std::max(next + 1, oldest);
+        dropped_ += to - next;
+        Metrics::global().busDropped.add(to - next);
+        next = to;
+    }
+
+    void advance(std::uint64_t next) {
+        pos_.store(next);
+        if (gating_) {
+            core_->gates[idx_].store(next);
+            core_->wakeWriter();
+        }
+    }
+
+    void waitReadable(std::uint64_t next) {
+        auto ready = [&]() { return core_->cursor.load() > next || stopAt_.load() <= next; };
+        for (int i = 0; i < kSpins; ++i) {
+            if (ready()) return;
+            std::this_thread::yield();
+        }
+        // The writer stores the cursor before reading parked, and we set our
+        // bit before checking the cursor: one of us sees the other.
+        auto& park = core_->parks[idx_];
+        std::unique_lock<std::mutex> lk(park.mtx);
+        core_->parked.fetch_or(bit_);
+        park.cv.wait(lk, ready);
+        core_->parked.fetch_and(~bit_);
+    }
+
+    void deliver(const DeviceEvent& evt) {
+        cb_(evt);
+        ++delivered_;
+    }
+
+    // Read everything up to end and deliver one merged event per uid, at the
+    // position of its last event: the latest info, every changed bit, and the
+    // last presence kind (a later Attach/Detach overrides, InfoUpdated keeps it).
+    void catchUpCoalesced(std::uint64_t& next, std::uint64_t end) {
+        std::size_t n = 0;
+        while (next < end) {
+            if (n == window_.size()) window_.emplace_back();
+            const Read r = readSlot(next, window_[n]);
+            if (r == Read::Lapped) {
+                skipLapped(next);
+                continue;
+            }
+            ++next;
+            if (r == Read::Ok) ++n;
+        }
+        advance(next);
+        enqueued_ += n;
+
+        keep_.assign(n, 1);
+        last_.clear();
+        for (std::size_t i = 0; i < n; ++i) {
+            DeviceEvent& cur = window_[i];
+            auto [it, fresh] = last_.try_emplace(cur.info.uid, i);
+            if (fresh) continue;
+            const DeviceEvent& prev = window_[it->second];
+            if (cur.kind == DeviceEvent::Kind::InfoUpdated) cur.kind = prev.kind;
+            cur.changed |= prev.changed;
+            keep_[it->second] = 0;
+            it->second = i;
+        }
+        for (std::size_t i = 0; i < n; ++i) {
+            if (keep_[i]) {
+                deliver(window_[i]);
+            } else {
+                ++coalesced_;
+                Metrics::global().busCoalesced.add();
+            }
+        }
+    }
+
+    void run() {
+        std::uint64_t next = pos_.load();
+        for (;;) {
+            if (next >= stopAt_.load()) break;
+            const std::uint64_t avail = core_->cursor.load();
+            if (next >= avail) {
+                waitReadable(next);
+                continue;
+            }
+            const std::uint64_t lag = avail - next;
+            if (lag > maxQueued_.load()) maxQueued_.store(lag);
+
+            if (opts_.overflow == Overflow::CoalescePerUid && lag > core_->size / 2) {
+                catchUpCoalesced(next, std::min(avail, stopAt_.load()));
+                continue;
+            }
+            const Read r = readSlot(next, current_);
+            if (r == Read::Lapped) {
+                skipLapped(next);
+                advance(next);
+                continue;
+            }
+            advance(++next);
+            if (r == Read::Ok) {
+                ++enqueued_;
+                deliver(current_);
+            }
+        }
+        core_->release(idx_);
+    }
+
+    std::shared_ptr<Core> core_;
+    const int idx_;
+    const std::uint64_t bit_;  // our registry bit in slot interest masks
+    const bool gating_;
+    Callback cb_;
+    Options opts_;
+
+    std::atomic<std::uint64_t> pos_;              // next seq to read
+    std::uint64_t trustFrom_{0};                  // slot interest masks are ours from this seq on
+    std::atomic<std::uint64_t> stopAt_{kNoGate};  // exit once pos_ reaches this
+
+    std::atomic<std::uint64_t> enqueued_{0};
+    std::atomic<std::uint64_t> delivered_{0};
+    std::atomic<std::uint64_t> dropped_{0};
+    std::atomic<std::uint64_t> coalesced_{0};
+    std::atomic<std::uint64_t> maxQueued_{0};
+
+    // Consumer-thread scratch, reused across events.
+    DeviceEvent current_;
+    std::vector<DeviceEvent> window_;
+    std::vector<char> keep_;
+    std::unordered_map<std::string, std::size_t> last_; // uid -> window index of its merged event
+
+    std::thread thread_;
+};
+
+EventBus::EventBus(std::size_t capacity)
+    : core_(std::make_shared<Core>(capacity)) {}
+
+EventBus::~EventBus() {
+    std::unordered_map<int, std::shared_ptr<Consumer>> consumers;
+    {
+        std::lock_guard<std::mutex> lk(ctlMtx_);
+        consumers.swap(consumers_);
+    }
+    for (auto& kv : consumers) kv.second->stop(true);
+}
+
+int EventBus::subscribe(Callback cb, Options opts) {
+    const int idx = core_->claim();
+    if (idx < 0) {
+        spdlog::warn("[bus] subscriber limit ({}) reached", kMaxSubscribers);
+        return 0;
+    }
+    const bool gating = opts.overflow == Overflow::Block;
+    std::lock_guard<std::mutex> lk(ctlMtx_);
+    // Publish our interest before choosing the start seq: an event that
+    // starts publishing after this call returns is matched against it. The
+    // one a concurrent publish() may have matched against the old index is
+    // the start seq itself; the consumer re-checks that one (see readSlot).
     const int token = nextToken_++;
-    subscribers_.emplace(token, std::move(cb));
+    auto consumer = std::make_shared<Consumer>(core_, idx, kNoGate, std::move(cb), std::move(opts));
+    consumers_.emplace(token, consumer);
+    rebuildInterestLocked();
+    const std::uint64_t start = core_->cursor.load();
+    consumer->seek(start);
+    if (gating) core_->gates[idx].store(start);
+    consumer->start();
     return token;
 }
 
 void EventBus::unsubscribe(int token) {
-    std::lock_guard<std::mutex> lock(mtx_);
-    subscribers_.erase(token);
-}
-
-void EventBus::publish(const DeviceEvent& evt) {
-    // Copy callbacks under lock, then invoke without lock to avoid re-entrancy issues.
-    std::unordered_map<int, Callback> subsCopy;
+    std::shared_ptr<Consumer> consumer;
     {
-        std::lock_guard<std::mutex> lock(mtx_);
-        subsCopy = subscribers_;
+        std::lock_guard<std::mutex> lk(ctlMtx_);
+        auto it = consumers_.find(token);
+        if (it == consumers_.end()) return;
+        consumer = std::move(it->second);
+        consumers_.erase(it);
+        rebuildInterestLocked();
     }
-    for (auto& kv : subsCopy) {
-        if (kv.second) {
-            kv.second(evt);
+    consumer->stop(false);
+}
+
+void EventBus::rebuildInterestLocked() {
+    auto in = std::make_unique<Interest>();
+    in->routes.reserve(consumers_.size());
+    for (const auto& kv : consumers_) {
+        const std::size_t r = in->routes.size();
+        const EventFilter& f = kv.second->filter();
+        in->routes.push_back(Interest::Route{kv.second->bit(), f});
+        for (std::size_t k = 0; k < Interest::kKinds; ++k) {
+            if ((f.kinds & EventFilter::kindBit(static_cast<DeviceEvent::Kind>(k))) == 0) continue;
+            if (f.uids.empty()) {
+                in->anyUid[k].push_back(r);
+            } else {
+                for (const auto& uid : f.uids) in->byUid[k][uid].push_back(r);
+            }
         }
     }
+    core_->replaceInterest(std::move(in));
+}
+
+std::optional<EventBus::Stats> EventBus::stats(int token) const {
+    std::shared_ptr<Consumer> consumer;
+    {
+        std::lock_guard<std::mutex> lk(ctlMtx_);
+        auto it = consumers_.find(token);
+        if (it == consumers_.end()) return std::nullopt;
+        consumer = it->second;
+    }
+    return consumer->stats();
 }
 
+void EventBus::publish(const DeviceEvent& evt) {
+    Core& c = *core_;
+    const std::uint64_t seq = c.cursor.load(std::memory_order_relaxed);
+    // Slot seq - size is being reused: every Block subscriber must be past it.
+    if (seq >= c.size) c.waitWritable(seq - c.size + 1);
+    const std::uint64_t interest = c.acquireInterest()->match(evt);
+    c.interestInUse.store(nullptr);
+
+    // Fill a free body first, then swap it into the slot; readers of the old
+    // seq see kNoGate and count themselves lapped.
+    Core::Stored* fresh = c.takeSpare();
+    fresh->evt = evt;
+    auto& slot = c.slots[seq & c.mask];
+    slot.seq.store(kNoGate);
+    Core::Stored* old = slot.stored.exchange(fresh);
+    slot.interest.store(interest);
+    slot.published.store(std::chrono::steady_clock::now().time_since_epoch().count());
+    slot.seq.store(seq);
+    c.spare.push_back(old);
+    c.cursor.store(seq + 1);
+    // Only subscribers that want the event are woken. Every half ring the
+    // rest are too, so they skip past what they ignored before it is
+    // overwritten (and before a Block subscriber stalls the writer).
+    c.wakeReaders((seq & c.sweepMask) == 0 ? ~std::uint64_t{0} : interest);
+}
@@ -1,29 +1,88 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <functional>
+#include <memory>
 #include <mutex>
+#include <optional>
 #include <unordered_map>
 
 #include "core/DeviceModel.h"
+#include "core/EventFilter.h"
 
-// A minimal, threadsafe event bus for DeviceEvent.
-// API is present; behavior is intentionally simple.
+// Broadcast ring for DeviceEvent in the style of a disruptor: one writer
+// fills preallocated slots, every subscriber reads them at its own cursor on
+// its own thread. publish() does not allocate once event strings have grown
+// to size, takes no lock shared with subscribe/unsubscribe, and never waits
+// for a lossy subscriber: it scans a fixed array of atomic consumer cursors,
+// reads the interest index through an atomic pointer (old indexes are freed
+// only once the writer is past them), and readers validate slots
+// seqlock-style instead of locking them. Only Block subscribers hold the
+// writer back, by design. Each event is matched against the filters once;
+// the slot carries a mask of the subscribers that want it and only those are
+// woken; the others skip the slot without looking at the event.
 class EventBus {
 public:
     using Callback = std::function<void(const DeviceEvent&)>;
 
-    // Subscribe and receive a numeric token that can be used to unsubscribe.
-    int subscribe(Callback cb);
+    static constexpr std::size_t kMaxSubscribers = 64;
 
-    // Unsubscribe by token; no-op if not found.
+    enum class Overflow {
+        Block,          // writer waits for this subscriber (lossless, applies backpressure)
+        DropOldest,     // a lapped subscriber skips to the oldest event still in the ring
+        CoalescePerUid  // like DropOldest, but a subscriber more than half a ring behind
+                        // catches up with one merged event per uid (latest info,
+                        // all changed bits, last Attach/Detach kind)
+    };
+
+    struct Options {
+        Overflow overflow{Overflow::Block};
+        EventFilter filter;       // matched by the writer; rejected events are never copied out
+    };
+
+    struct Stats {
+        std::uint64_t enqueued{0};   // events that passed the filter
+        std::uint64_t delivered{0};
+        std::uint64_t dropped{0};    // lost to lapping
+        std::uint64_t coalesced{0};
+        std::size_t queued{0};       // current lag in ring slots
+        std::size_t maxQueued{0};    // high-water mark
+    };
+
+    // capacity is rounded up to a power of two.
+    explicit EventBus(std::size_t capacity = 1024);
+    // Drains and stops all subscribers.
+    ~EventBus();
+
+    EventBus(const EventBus&) = delete;
+    EventBus& operator=(const EventBus&) = delete;
+
+    // Returns a token (> 0), or 0 when kMaxSubscribers are already registered.
+    // The subscriber sees events published after this call.
+    int subscribe(Callback cb, Options opts);
+    // Stops delivery; safe to call from inside the subscriber's own callback.
     void unsubscribe(int token);
+    std::optional<Stats> stats(int token) const;
 
-    // Publish an event to all current subscribers.
+    // Single writer: callers must serialize publish() among themselves.
     void publish(const DeviceEvent& evt);
 
 private:
-    std::mutex mtx_;
+    struct Core;
+    struct Interest;
+    class Consumer;
+
+    // Swap in an interest index built from consumers_ (ctlMtx_ held).
+    void rebuildInterestLocked();
+
+    std::shared_ptr<Core> core_;
+
+    // Subscription bookkeeping only; publish() never touches it.
+    mutable std::mutex ctlMtx_;
     int nextToken_{1};
-    std::unordered_map<int, Callback> subscribers_;
+    std::unordered_map<int, std::shared_ptr<Consumer>> consumers_;
 };
-
@@ -0,0 +1,10 @@
+#include "core/EventFilter.h"
+
+bool EventFilter::matches(DeviceEvent::Kind kind, const DeviceInfo& info, std::uint32_t changed) const {
+    if ((kinds & kindBit(kind)) == 0) return false;
+    if (type && info.type != *type) return false;
+    if (kind == DeviceEvent::Kind::InfoUpdated && (changed & changedMask) == 0) return false;
+    if (!uidPrefix.empty() && info.uid.compare(0, uidPrefix.size(), uidPrefix) != 0) return false;
+    if (!uids.empty() && uids.count(info.uid) == 0) return false;
+    return true;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_set>
+
+#include "core/DeviceModel.h"
+
+// Subscription-time event filter. EventBus evaluates it once per event on the
+// publishing thread and only wakes subscribers that accept it; the default
+// filter accepts everything.
+struct EventFilter {
+    static constexpr std::uint8_t kindBit(DeviceEvent::Kind k) {
+        return static_cast<std::uint8_t>(1u << static_cast<unsigned>(k));
+    }
+    static constexpr std::uint8_t kAllKinds = 0x7;
+
+    std::uint8_t kinds{kAllKinds};                   // kindBit() mask
+    std::optional<Type> type;
+    std::unordered_set<std::string> uids;            // empty = any uid
+    std::string uidPrefix;                           // empty = any uid
+    std::uint32_t changedMask{DeviceField::All};     // InfoUpdated needs a changed bit in here
+
+    bool matches(DeviceEvent::Kind kind, const DeviceInfo& info, std::uint32_t changed) const;
+};
@@ -0,0 +1,476 @@
+#include "core/EventJournal.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr char kMagic[8] = {'D', 'W', 'J', 'R', 'N', 'L', '0', '2'};
+constexpr std::size_t kHeaderBytes = sizeof(kMagic) + 4; // magic | u32 checkpoint records
+constexpr const char* kSegmentPrefix = "dw-";
+constexpr const char* kSegmentExt = ".dwj";
+constexpr std::uint8_t kStateKind = 3; // after DeviceEvent::Kind values
+constexpr std::uint8_t kFlagOnline = 1u << 0;
+constexpr std::uint8_t kFlagHasSince = 1u << 1;
+constexpr std::uint32_t kMaxFrame = 1u << 20;
+
+// CRC-32 (IEEE 802.3), table-driven.
+std::uint32_t crc32(const std::uint8_t* data, std::size_t n) {
+    static const auto table = []() {
+        std::array<std::uint32_t, 256> t{};
+        for (std::uint32_t i = 0; i < 256; ++i) {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; ++k) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            t[i] = c;
+        }
+        return t;
+    }();
+    std::uint32_t c = 0xFFFFFFFFu;
+    for (std::size_t i = 0; i < n; ++i) c = table[(c ^ data[i]) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFu;
+}
+
+void putU8(std::string& out, std::uint8_t v) { out.push_back(static_cast<char>(v)); }
+
+void putLE(std::string& out, std::uint64_t v, int bytes) {
+    for (int i = 0; i < bytes; ++i) out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+}
+
+void putVarint(std::string& out, std::uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+void putStr(std::string& out, const std::string& s) {
+    putVarint(out, s.size());
+    out.append(s);
+}
+
+std::int64_t toMicros(std::chrono::system_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(tp.time_since_epoch()).count();
+}
+
+std::chrono::system_clock::time_point fromMicros(std::int64_t us) {
+    return std::chrono::system_clock::time_point(
+        std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds(us)));
+}
+
+// Bounds-checked little-endian reader over a mapped frame.
+struct Reader {
+    const std::uint8_t* p;
+    const std::uint8_t* end;
+    bool ok{true};
+
+    std::uint64_t le(int bytes) {
+        if (end - p < bytes) { ok = false; return 0; }
+        std::uint64_t v = 0;
+        for (int i = 0; i < bytes; ++i) v |= static_cast<std::uint64_t>(p[i]) << (8 * i);
+        p += bytes;
+        return v;
+    }
+    std::uint64_t varint() {
+        std::uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) break;
+            const std::uint8_t b = *p++;
+            v |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+    void str(std::string& s) {
+        const std::uint64_t n = varint();
+        if (!ok || static_cast<std::uint64_t>(end - p) < n) { ok = false; return; }
+        s.assign(reinterpret_cast<const char*>(p), static_cast<std::size_t>(n));
+        p += n;
+    }
+};
+
+bool decode(const std::uint8_t* data, std::size_t n, EventJournal::Entry& e) {
+    Reader r{data, data + n};
+    const auto kind = static_cast<std::uint8_t>(r.le(1));
+    const auto flags = static_cast<std::uint8_t>(r.le(1));
+    const auto type = static_cast<std::uint8_t>(r.le(1));
+    if (kind > kStateKind || type > static_cast<std::uint8_t>(Type::Unknown)) return false;
+    e.state = (kind == kStateKind);
+    e.evt.kind = e.state ? DeviceEvent::Kind::Attach : static_cast<DeviceEvent::Kind>(kind);
+    e.ts = fromMicros(static_cast<std::int64_t>(r.le(8)));
+    e.onlineSince.reset();
+    if (flags & kFlagHasSince) e.onlineSince = fromMicros(static_cast<std::int64_t>(r.le(8)));
+    e.evt.changed = static_cast<std::uint32_t>(r.le(4));
+
+    DeviceInfo& d = e.evt.info;
+    d.type = static_cast<Type>(type);
+    d.online = (flags & kFlagOnline) != 0;
+    d.vid = static_cast<std::uint16_t>(r.le(2));
+    d.pid = static_cast<std::uint16_t>(r.le(2));
+    for (std::string* s : {&d.uid, &d.displayName, &d.transport, &d.model, &d.adbState,
+                           &d.manufacturer, &d.osVersion, &d.abi, &d.productType,
+                           &d.deviceName, &d.usbPath}) {
+        r.str(*s);
+    }
+    // Trailing fields added after the first format; absent in older entries.
+    d.usbSpeedMbps = 0;
+    if (r.ok && r.p < r.end) d.usbSpeedMbps = static_cast<std::uint32_t>(r.varint());
+    return r.ok;
+}
+
+// Decodes the frame at p into e. Returns the next frame, or nullptr if the
+// frame is torn or corrupt.
+const std::uint8_t* nextFrame(const std::uint8_t* p, const std::uint8_t* end, EventJournal::Entry& e) {
+    Reader hdr{p, end};
+    const auto len = static_cast<std::uint32_t>(hdr.le(4));
+    const auto crc = static_cast<std::uint32_t>(hdr.le(4));
+    if (!hdr.ok || len > kMaxFrame || static_cast<std::size_t>(end - hdr.p) < len ||
+        crc32(hdr.p, len) != crc || !decode(hdr.p, len, e)) {
+        return nullptr;
+    }
+    return hdr.p + len;
+}
+
+void syncFile(std::FILE* f) {
+    std::fflush(f);
+#ifdef _WIN32
+    _commit(_fileno(f));
+#else
+    ::fsync(fileno(f));
+#endif
+}
+
+// Read-only memory map of a whole file.
+class MappedFile {
+public:
+    explicit MappedFile(const fs::path& path) {
+#ifdef _WIN32
+        file_ = CreateFileW(path.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                            nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) return;
+        LARGE_INTEGER sz{};
+        if (!GetFileSizeEx(file_, &sz) || sz.QuadPart == 0) return;
+        mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping_) return;
+        data_ = static_cast<const std::uint8_t*>(MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0));
+        if (data_) size_ = static_cast<std::size_t>(sz.QuadPart);
+#else
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) return;
+        struct stat st{};
+        if (::fstat(fd_, &st) != 0 || st.st_size == 0) return;
+        void* p = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd_, 0);
+        if (p == MAP_FAILED) return;
+        data_ = static_cast<const std::uint8_t*>(p);
+        size_ = static_cast<std::size_t>(st.st_size);
+#endif
+    }
+
+    ~MappedFile() {
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+#else
+        if (data_) ::munmap(const_cast<std::uint8_t*>(data_), size_);
+        if (fd_ >= 0) ::close(fd_);
+#endif
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    const std::uint8_t* data() const { return data_; }
+    std::size_t size() const { return size_; }
+
+private:
+    const std::uint8_t* data_{nullptr};
+    std::size_t size_{0};
+#ifdef _WIN32
+    HANDLE file_{INVALID_HANDLE_VALUE};
+    HANDLE mapping_{nullptr};
+#else
+    int fd_{-1};
+#endif
+};
+
+// Segments in dir sorted by sequence number.
+std::vector<std::pair<std::uint64_t, fs::path>> listSegments(const std::string& dir) {
+    std::vector<std::pair<std::uint64_t, fs::path>> out;
+    std::error_code ec;
+    for (const auto& de : fs::directory_iterator(dir, ec)) {
+        const std::string name = de.path().filename().string();
+        const std::string prefix = kSegmentPrefix;
+        const std::string ext = kSegmentExt;
+        if (name.size() <= prefix.size() + ext.size()) continue;
+        if (name.compare(0, prefix.size(), prefix) != 0) continue;
+        if (name.compare(name.size() - ext.size(), ext.size(), ext) != 0) continue;
+        const std::string num = name.substr(prefix.size(), name.size() - prefix.size() - ext.size());
+        const auto isDigit = [](unsigned char ch) { return std::isdigit(ch) != 0; };
+        if (num.empty() || !std::all_of(num.begin(), num.end(), isDigit)) continue;
+        out.emplace_back(std::stoull(num), de.path());
+    }
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+bool validHeader(const MappedFile& map) {
+    return map.data() && map.size() >= kHeaderBytes && std::memcmp(map.data(), kMagic, sizeof(kMagic)) == 0;
+}
+
+// True if every checkpoint record the header announces made it to disk. A
+// crash or write error while the header was written leaves it short.
+bool checkpointComplete(const MappedFile& map) {
+    if (!validHeader(map)) return false;
+    Reader r{map.data() + sizeof(kMagic), map.data() + map.size()};
+    std::uint64_t left = r.le(4);
+    const std::uint8_t* p = r.p;
+    const std::uint8_t* end = map.data() + map.size();
+    EventJournal::Entry e;
+    for (; left > 0; --left) {
+        p = nextFrame(p, end, e);
+        if (!p || !e.state) return false;
+    }
+    return true;
+}
+} // namespace
+
+EventJournal::EventJournal(Options opts)
+    : opts_(std::move(opts)) {}
+
+EventJournal::~EventJournal() {
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        running_ = false;
+    }
+    cv_.notify_all();
+    if (committer_.joinable()) committer_.join();
+    std::lock_guard<std::mutex> flk(fileMtx_);
+    if (file_) {
+        syncFile(file_);
+        std::fclose(file_);
+        file_ = nullptr;
+    }
+}
+
+bool EventJournal::open(CheckpointFn checkpoint) {
+    std::error_code ec;
+    fs::create_directories(opts_.dir, ec);
+    if (ec) {
+        spdlog::warn("[journal] cannot create {}: {}", opts_.dir, ec.message());
+        return false;
+    }
+    checkpoint_ = std::move(checkpoint);
+    {
+        std::lock_guard<std::mutex> flk(fileMtx_);
+        auto segs = listSegments(opts_.dir);
+        segmentSeq_ = segs.empty() ? 0 : segs.back().first;
+        if (!openSegmentLocked()) return false;
+    }
+    pruneSegments();
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        running_ = true;
+    }
+    committer_ = std::thread([this]() { commitLoop(); });
+    return true;
+}
+
+void EventJournal::encode(const Entry& e, std::string& out) {
+    std::string payload;
+    payload.reserve(128);
+    const DeviceInfo& d = e.evt.info;
+    std::uint8_t flags = 0;
+    if (d.online) flags |= kFlagOnline;
+    if (e.onlineSince) flags |= kFlagHasSince;
+    putU8(payload, e.state ? kStateKind : static_cast<std::uint8_t>(e.evt.kind));
+    putU8(payload, flags);
+    putU8(payload, static_cast<std::uint8_t>(d.type));
+    putLE(payload, static_cast<std::uint64_t>(toMicros(e.ts)), 8);
+    if (e.onlineSince) putLE(payload, static_cast<std::uint64_t>(toMicros(*e.onlineSince)), 8);
+    putLE(payload, e.evt.changed, 4);
+    putLE(payload, d.vid, 2);
+    putLE(payload, d.pid, 2);
+    for (const std::string* s : {&d.uid, &d.displayName, &d.transport, &d.model, &d.adbState,
+                                 &d.manufacturer, &d.osVersion, &d.abi, &d.productType,
+                                 &d.deviceName, &d.usbPath}) {
+        putStr(payload, *s);
+    }
+    putVarint(payload, d.usbSpeedMbps);
+
+    putLE(out, payload.size(), 4);
+    putLE(out, crc32(reinterpret_cast<const std::uint8_t*>(payload.data()), payload.size()), 4);
+    out.append(payload);
+}
+
+void EventJournal::append(const DeviceEvent& evt, std::chrono::system_clock::time_point ts) {
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        if (!running_) return;
+        Entry e;
+        e.ts = ts;
+        e.evt = evt;
+        encode(e, buffer_);
+        wake = buffer_.size() >= opts_.groupBytes;
+    }
+    if (wake) cv_.notify_one();
+}
+
+void EventJournal::flush() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    commitLocked(lk);
+}
+
+void EventJournal::commitLoop() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    while (running_) {
+        cv_.wait_for(lk, opts_.commitInterval,
+                     [this]() { return !running_ || buffer_.size() >= opts_.groupBytes; });
+        commitLocked(lk);
+    }
+    commitLocked(lk);
+}
+
+void EventJournal::commitLocked(std::unique_lock<std::mutex>& lk) {
+    if (buffer_.empty()) return;
+    // Take fileMtx_ first (lock order fileMtx_ -> mtx_) so concurrent commits
+    // cannot reorder groups on disk.
+    lk.unlock();
+    std::lock_guard<std::mutex> flk(fileMtx_);
+    lk.lock();
+    std::string group;
+    group.swap(buffer_);
+    lk.unlock();
+
+    bool rotated = false;
+    bool failed = false;
+    if (file_ && !group.empty()) {
+        // A short write leaves a torn group: nothing may follow it in this
+        // segment. The next one starts from a checkpoint of the table, which
+        // already holds the lost group's changes.
+        const bool written = std::fwrite(group.data(), 1, group.size(), file_) == group.size() &&
+                             std::fflush(file_) == 0;
+        if (!written) spdlog::warn("[journal] write failed for segment {}; rotating", segmentSeq_);
+        syncFile(file_);
+        segmentSize_ += group.size();
+        if (!written || segmentSize_ >= opts_.segmentBytes) {
+            std::fclose(file_);
+            file_ = nullptr;
+            rotated = openSegmentLocked();
+            failed = !rotated;
+        }
+    }
+    if (rotated) pruneSegments();
+    lk.lock();
+    // No segment to write to: stop buffering appends
+    if (failed) running_ = false;
+}
+
+bool EventJournal::openSegmentLocked() {
+    ++segmentSeq_;
+    const fs::path path = fs::path(opts_.dir) / fmt::format("{}{:06}{}", kSegmentPrefix, segmentSeq_, kSegmentExt);
+    file_ = std::fopen(path.string().c_str(), "wb");
+    if (!file_) {
+        spdlog::warn("[journal] cannot open segment {}", path.string());
+        return false;
+    }
+    std::vector<Entry> state;
+    if (checkpoint_) state = checkpoint_();
+    std::string head(kMagic, sizeof(kMagic));
+    putLE(head, state.size(), 4);
+    for (const auto& e : state) encode(e, head);
+    if (std::fwrite(head.data(), 1, head.size(), file_) != head.size() || std::fflush(file_) != 0) {
+        spdlog::warn("[journal] cannot write segment {}; journal disabled", path.string());
+        std::fclose(file_);
+        file_ = nullptr;
+        std::error_code ec;
+        fs::remove(path, ec);
+        return false;
+    }
+    syncFile(file_);
+    segmentSize_ = head.size();
+    spdlog::info("[journal] segment {} opened", path.string());
+    return true;
+}
+
+void EventJournal::pruneSegments() {
+    auto segs = listSegments(opts_.dir);
+    if (segs.size() <= opts_.maxSegments) return;
+    const std::size_t excess = segs.size() - opts_.maxSegments;
+    for (std::size_t i = 0; i < excess; ++i) {
+        std::error_code ec;
+        fs::remove(segs[i].second, ec);
+    }
+}
+
+std::size_t EventJournal::replay(const std::string& dir, const std::function<void(const Entry&)>& fn) {
+    return replaySegments(listSegments(dir), 0, fn);
+}
+
+std::size_t EventJournal::restore(const std::string& dir, const std::function<void(const Entry&)>& fn) {
+    const auto segs = listSegments(dir);
+    // Each segment's checkpoint holds the whole table, so nothing before the
+    // newest complete one is needed.
+    std::size_t from = 0;
+    for (std::size_t i = segs.size(); i-- > 0;) {
+        if (checkpointComplete(MappedFile(segs[i].second))) {
+            from = i;
+            break;
+        }
+    }
+    return replaySegments(segs, from, fn);
+}
+
+std::size_t EventJournal::replaySegments(const std::vector<std::pair<std::uint64_t, std::filesystem::path>>& segs,
+                                         std::size_t from, const std::function<void(const Entry&)>& fn) {
+    std::size_t count = 0;
+    Entry e;
+    for (std::size_t i = from; i < segs.size(); ++i) {
+        const auto& seg = segs[i];
+        MappedFile map(seg.second);
+        if (!validHeader(map)) {
+            spdlog::warn("[journal] skip unreadable segment {}", seg.second.string());
+            continue;
+        }
+        const std::uint8_t* p = map.data() + kHeaderBytes;
+        const std::uint8_t* end = map.data() + map.size();
+        while (end - p >= 8) {
+            const std::uint8_t* next = nextFrame(p, end, e);
+            if (!next) {
+                spdlog::warn("[journal] {} truncated/corrupt at offset {}; ignoring rest of segment",
+                             seg.second.filename().string(), static_cast<std::size_t>(p - map.data()));
+                break;
+            }
+            p = next;
+            fn(e);
+            ++count;
+        }
+    }
+    return count;
+}
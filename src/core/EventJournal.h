@@ -0,0 +1,97 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "core/DeviceModel.h"
+
+// Append-only binary journal of the events DeviceManager delivers.
+//
+// The journal is a directory of numbered segments (dw-000001.dwj, ...). Each
+// segment starts with an 8-byte magic and the u32 number of checkpoint
+// records, followed by frames:
+//   u32 payloadLen | u32 crc32(payload) | payload
+// All integers are little-endian; strings are varint-length prefixed.
+// Appends go to an in-memory buffer; a background thread writes and fsyncs
+// it in groups (every commitInterval or once groupBytes accumulate). A new
+// segment starts with a checkpoint of the whole table, so old segments can
+// be dropped without losing state.
+class EventJournal {
+public:
+    struct Options {
+        std::string dir;
+        std::size_t segmentBytes{8u << 20};                     // rotate after this size
+        std::size_t maxSegments{16};                            // oldest segments beyond this are deleted
+        std::chrono::milliseconds commitInterval{200};          // group-commit period
+        std::size_t groupBytes{64u << 10};                      // commit early once this much is buffered
+    };
+
+    struct Entry {
+        bool state{false}; // checkpoint record: table state at segment start, not an event
+        std::chrono::system_clock::time_point ts;
+        std::optional<std::chrono::system_clock::time_point> onlineSince;
+        DeviceEvent evt;
+    };
+
+    // Produces checkpoint entries (state=true) for a fresh segment.
+    using CheckpointFn = std::function<std::vector<Entry>()>;
+
+    explicit EventJournal(Options opts);
+    ~EventJournal();
+
+    EventJournal(const EventJournal&) = delete;
+    EventJournal& operator=(const EventJournal&) = delete;
+
+    // Create the directory if needed and start a new segment (beginning with a
+    // checkpoint). Returns false on I/O failure. If a later segment cannot be
+    // started, the journal logs a warning and stops recording.
+    bool open(CheckpointFn checkpoint);
+
+    // Buffer one delivered event; durable after the next group commit.
+    void append(const DeviceEvent& evt, std::chrono::system_clock::time_point ts);
+
+    // Write and fsync everything buffered so far.
+    void flush();
+
+    // Replay every segment in dir in order via read-only memory maps. A torn
+    // or corrupt frame ends that segment. Returns the number of entries seen.
+    static std::size_t replay(const std::string& dir, const std::function<void(const Entry&)>& fn);
+
+    // Like replay(), but start at the newest segment whose checkpoint is
+    // complete: enough to rebuild the table without reading older history.
+    static std::size_t restore(const std::string& dir, const std::function<void(const Entry&)>& fn);
+
+private:
+    void commitLoop();
+    void commitLocked(std::unique_lock<std::mutex>& lk);
+    bool openSegmentLocked();
+    void pruneSegments();
+
+    static void encode(const Entry& e, std::string& out);
+    static std::size_t replaySegments(const std::vector<std::pair<std::uint64_t, std::filesystem::path>>& segs,
+                                      std::size_t from, const std::function<void(const Entry&)>& fn);
+
+    Options opts_;
+    CheckpointFn checkpoint_;
+
+    std::mutex mtx_;                 // guards buffer_ / running_
+    std::condition_variable cv_;
+    std::string buffer_;             // framed records awaiting commit
+    bool running_{false};
+    std::thread committer_;
+
+    std::mutex fileMtx_;             // guards file_ / segment bookkeeping
+    std::FILE* file_{nullptr};
+    std::uint64_t segmentSeq_{0};
+    std::size_t segmentSize_{0};
+};
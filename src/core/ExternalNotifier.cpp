@@ -8,6 +8,7 @@
 #include <sstream>
 #include <system_error>
 
+#include "core/Metrics.h"
 #include "core/Utils.h"
 
 using asio::ip::tcp;
@@ -16,17 +17,23 @@ using nlohmann::json;
 ExternalNotifier::ExternalNotifier(DeviceManager& manager)
     : manager_(manager) {
     running_ = true;
-    httpNextAllowed_ = std::chrono::steady_clock::now();
+    httpNextAllowed_ = manager_.clock().now();
     tcpNextAllowed_ = httpNextAllowed_;
 
+    // Skip InfoUpdated events that change nothing in the JSON payload.
+    DeviceManager::SubscribeOptions opts;
+    opts.filter.changedMask = DeviceField::Type | DeviceField::Manufacturer | DeviceField::Model |
+                              DeviceField::OsVersion | DeviceField::Transport | DeviceField::Vid |
+                              DeviceField::Pid;
     subToken_ = manager_.subscribe([this](const DeviceEvent& evt) {
-        QueuedEvent q{evt, std::chrono::system_clock::now()};
+        QueuedEvent q{evt, manager_.clock().wallNow(), std::chrono::steady_clock::now()};
         {
             std::lock_guard<std::mutex> lk(mtx_);
             queue_.push(std::move(q));
+            Metrics::global().notifyBacklog.set(static_cast<std::int64_t>(queue_.size()));
         }
         cv_.notify_one();
-    });
+    }, opts);
 
     worker_ = std::thread([this]() { workerLoop(); });
 }
@@ -69,36 +76,68 @@ void ExternalNotifier::workerLoop() {
             }
             q = std::move(queue_.front());
             queue_.pop();
+            Metrics::global().notifyBacklog.set(static_cast<std::int64_t>(queue_.size()));
         }
         handle(q);
     }
 }
 
 void ExternalNotifier::handle(const QueuedEvent& q) {
-    const auto nowSteady = std::chrono::steady_clock::now();
+    auto& metrics = Metrics::global();
+    const auto nowSteady = manager_.clock().now();
     const std::string line = eventToJsonLine(q.evt, q.ts);
 
     Settings cfg = currentSettings();
 
-    if (!cfg.webhookUrl.empty() && nowSteady >= httpNextAllowed_) {
-        if (!sendHttpPost(cfg.webhookUrl, line)) {
+    if (!cfg.webhookUrl.empty()) {
+        if (nowSteady < httpNextAllowed_) {
+            metrics.notifySkipped.add();
+        } else if (!sendHttpPost(cfg.webhookUrl, line)) {
             spdlog::warn("[notify] webhook POST failed, backoff");
+            metrics.notifyFailed.add();
             httpNextAllowed_ = nowSteady + std::chrono::seconds(3);
         } else {
+            metrics.notifySent.add();
             httpNextAllowed_ = nowSteady;
         }
     }
 
-    if (!cfg.localTcpEndpoint.empty() && nowSteady >= tcpNextAllowed_) {
-        if (!sendTcpNdjson(cfg.localTcpEndpoint, line)) {
+    if (!cfg.localTcpEndpoint.empty()) {
+        if (nowSteady < tcpNextAllowed_) {
+            metrics.notifySkipped.add();
+        } else if (!sendTcpNdjson(cfg.localTcpEndpoint, line)) {
             spdlog::warn("[notify] local TCP push failed, backoff");
+            metrics.notifyFailed.add();
             tcpNextAllowed_ = nowSteady + std::chrono::seconds(3);
         } else {
+            metrics.notifySent.add();
             tcpNextAllowed_ = nowSteady;
         }
     }
+
+    metrics.stage(Metrics::Stage::Notify).record(std::chrono::steady_clock::now() - q.queued);
 }
 
+namespace {
+json changedFieldNames(std::uint32_t mask) {
+    static const std::pair<std::uint32_t, const char*> kNames[] = {
+        {DeviceField::Type, "type"}, {DeviceField::DisplayName, "displayName"},
+        {DeviceField::Online, "online"}, {DeviceField::Transport, "transport"},
+        {DeviceField::Model, "model"}, {DeviceField::AdbState, "adbState"},
+        {DeviceField::Manufacturer, "manufacturer"}, {DeviceField::OsVersion, "osVersion"},
+        {DeviceField::Abi, "abi"}, {DeviceField::ProductType, "productType"},
+        {DeviceField::DeviceName, "deviceName"}, {DeviceField::Vid, "vid"},
+        {DeviceField::Pid, "pid"}, {DeviceField::UsbPath, "usbPath"},
+        {DeviceField::UsbSpeed, "usbSpeedMbps"},
+    };
+    json arr = json::array();
+    for (const auto& kv : kNames) {
+        if (mask & kv.first) arr.push_back(kv.second);
+    }
+    return arr;
+}
+} // namespace
+
 std::string ExternalNotifier::eventToJsonLine(const DeviceEvent& evt,
                                               const std::chrono::system_clock::time_point& ts) {
     json o;
@@ -117,6 +156,9 @@ std::string ExternalNotifier::eventToJsonLine(const DeviceEvent& evt,
     dev["pid"] = d.pid;
 
     o["device"] = std::move(dev);
+    if (evt.kind == DeviceEvent::Kind::InfoUpdated) {
+        o["changed"] = changedFieldNames(evt.changed);
+    }
     return o.dump();
 }
 
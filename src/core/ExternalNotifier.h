@@ -31,6 +31,7 @@ private:
     struct QueuedEvent {
         DeviceEvent evt;
         std::chrono::system_clock::time_point ts;
+        std::chrono::steady_clock::time_point queued; // for the notify latency stage
     };
 
     void workerLoop();
@@ -59,8 +60,8 @@ private:
     mutable std::mutex settingsMtx_;
     Settings settings_{};
 
-    // Backoff control (steady_clock)
-    std::chrono::steady_clock::time_point httpNextAllowed_{};
-    std::chrono::steady_clock::time_point tcpNextAllowed_{};
+    // Backoff control (manager's clock)
+    Clock::TimePoint httpNextAllowed_{};
+    Clock::TimePoint tcpNextAllowed_{};
 };
 
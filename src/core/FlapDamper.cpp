@@ -0,0 +1,108 @@
+#include "core/FlapDamper.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+constexpr double kForgetBelow = 0.05;
+} // namespace
+
+double FlapDamper::decayed(const Entry& e, TimePoint now) const {
+    if (e.penalty <= 0 || now <= e.at) return e.penalty;
+    const double elapsed = std::chrono::duration<double>(now - e.at).count();
+    const double halfLife = std::chrono::duration<double>(opts_.halfLife).count();
+    return e.penalty * std::exp2(-elapsed / halfLife);
+}
+
+FlapDamper::TimePoint FlapDamper::decaysBelow(const Entry& e, double level) const {
+    if (e.penalty <= level) return e.at;
+    const double left = std::chrono::duration<double>(opts_.halfLife).count() * std::log2(e.penalty / level);
+    return e.at + std::chrono::ceil<TimePoint::duration>(std::chrono::duration<double>(left));
+}
+
+std::chrono::milliseconds FlapDamper::holdFor(double penalty) const {
+    if (penalty < opts_.threshold) return opts_.baseHold;
+    const int level = 1 + static_cast<int>((penalty - opts_.threshold) / opts_.penaltyPerLevel);
+    auto hold = opts_.baseHold;
+    for (int i = 0; i < level && hold < opts_.maxHold; ++i) hold *= 2;
+    return std::min(hold, opts_.maxHold);
+}
+
+FlapDamper::State FlapDamper::toState(const Entry& e, TimePoint now) const {
+    State s;
+    s.transitions = e.transitions;
+    s.suppressed = e.suppressed;
+    s.penalty = decayed(e, now);
+    s.flapping = s.penalty >= opts_.threshold;
+    s.holdDown = holdFor(s.penalty);
+    s.lastTransition = e.at;
+    return s;
+}
+
+std::chrono::milliseconds FlapDamper::report(const std::string& uid, bool online, TimePoint now) {
+    prune(now);
+    auto it = entries_.find(uid);
+    if (it == entries_.end()) {
+        // First sighting is not a flap.
+        Entry e;
+        e.online = online;
+        e.at = now;
+        it = entries_.emplace(uid, e).first;
+    } else if (it->second.online != online) {
+        Entry& e = it->second;
+        e.penalty = decayed(e, now) + 1.0;
+        e.at = now;
+        e.online = online;
+        ++e.transitions;
+        // Hold starts or extends until the penalty decays back below the threshold
+        if (e.penalty >= opts_.threshold) holds_.schedule(uid, decaysBelow(e, opts_.threshold));
+    } else {
+        return holdFor(decayed(it->second, now));
+    }
+    // An online device's next report is its detach, which must count as a
+    // transition: only offline entries are forgotten.
+    const Entry& e = it->second;
+    if (e.online) {
+        forget_.cancel(uid);
+    } else {
+        forget_.schedule(uid, decaysBelow(e, kForgetBelow));
+    }
+    return holdFor(decayed(e, now));
+}
+
+void FlapDamper::suppressed(const std::string& uid) {
+    auto it = entries_.find(uid);
+    if (it != entries_.end()) ++it->second.suppressed;
+}
+
+std::optional<FlapDamper::State> FlapDamper::state(const std::string& uid, TimePoint now) const {
+    auto it = entries_.find(uid);
+    if (it == entries_.end()) return std::nullopt;
+    return toState(it->second, now);
+}
+
+std::vector<std::pair<std::string, FlapDamper::State>> FlapDamper::flapping(TimePoint now) const {
+    std::vector<std::pair<std::string, State>> out;
+    for (const auto& kv : entries_) {
+        State s = toState(kv.second, now);
+        if (s.flapping) out.emplace_back(kv.first, s);
+    }
+    std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) { return a.second.penalty > b.second.penalty; });
+    return out;
+}
+
+std::size_t FlapDamper::flappingCount(TimePoint now) {
+    std::string uid;
+    while (holds_.popExpired(now, uid)) {}
+    return holds_.size();
+}
+
+void FlapDamper::prune(TimePoint now) {
+    // kForgetBelow < threshold, so any hold ended before the entry is due; a
+    // device back after that long is a first sighting again.
+    std::string uid;
+    while (forget_.popExpired(now, uid)) {
+        holds_.cancel(uid);
+        entries_.erase(uid);
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "core/TimerHeap.h"
+
+// Per-uid flap detection in the style of route flap damping. Every presence
+// change (online <-> offline) adds a penalty that decays with a half-life.
+// Once the penalty crosses a threshold the device counts as flapping and its
+// debounce hold-down doubles for every further level, up to a cap; a stable
+// device decays back to the base hold. Not synchronized.
+class FlapDamper {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    struct Options {
+        std::chrono::milliseconds baseHold{800};
+        std::chrono::milliseconds maxHold{60000};
+        std::chrono::seconds halfLife{60};
+        double threshold{4.0};      // two full attach/detach cycles in quick succession
+        double penaltyPerLevel{2.0}; // one more cycle doubles the hold again
+    };
+
+    struct State {
+        std::uint64_t transitions{0};   // presence changes seen
+        std::uint64_t suppressed{0};    // changes absorbed before subscribers saw them
+        double penalty{0};              // decayed to the time of the query
+        bool flapping{false};
+        std::chrono::milliseconds holdDown{0};
+        TimePoint lastTransition{};
+    };
+
+    FlapDamper() = default;
+    explicit FlapDamper(const Options& opts) : opts_(opts) {}
+
+    const Options& options() const { return opts_; }
+
+    // Record the provider-reported presence of uid. Only a change from the
+    // last reported presence counts as a transition. Returns the hold-down to
+    // apply to the resulting debounced event.
+    std::chrono::milliseconds report(const std::string& uid, bool online, TimePoint now);
+    // Count a transition that was absorbed by the hold-down.
+    void suppressed(const std::string& uid);
+
+    std::optional<State> state(const std::string& uid, TimePoint now) const;
+    // Uids currently flapping, highest penalty first.
+    std::vector<std::pair<std::string, State>> flapping(TimePoint now) const;
+    // Kept incrementally: O(1) plus the holds that ended since the last call.
+    std::size_t flappingCount(TimePoint now);
+
+private:
+    struct Entry {
+        double penalty{0};
+        TimePoint at{};          // when penalty was last updated
+        bool online{false};
+        std::uint64_t transitions{0};
+        std::uint64_t suppressed{0};
+    };
+
+    double decayed(const Entry& e, TimePoint now) const;
+    // When e's penalty decays to level.
+    TimePoint decaysBelow(const Entry& e, double level) const;
+    std::chrono::milliseconds holdFor(double penalty) const;
+    State toState(const Entry& e, TimePoint now) const;
+    // Forget offline uids whose penalty has decayed away.
+    void prune(TimePoint now);
+
+    Options opts_{};
+    std::unordered_map<std::string, Entry> entries_;
+    TimerHeap holds_;  // flapping uid -> when its penalty decays below threshold
+    TimerHeap forget_; // offline uid -> when its penalty decays below kForgetBelow
+};
@@ -0,0 +1,115 @@
+#include "core/Metrics.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <fmt/format.h>
+
+namespace {
+constexpr std::uint64_t kSub = std::uint64_t{1} << Histogram::kSubBits;
+constexpr std::uint64_t kMaxValue = (std::uint64_t{1} << Histogram::kMaxBits) - 1;
+
+unsigned log2Floor(std::uint64_t v) {
+    unsigned n = 0;
+    while (v >>= 1) ++n;
+    return n;
+}
+} // namespace
+
+std::size_t Histogram::bucketOf(std::uint64_t us) {
+    us = std::min(us, kMaxValue);
+    if (us < 2 * kSub) return static_cast<std::size_t>(us); // exact below 32 µs
+    const unsigned msb = log2Floor(us);
+    const unsigned shift = msb - kSubBits;
+    return static_cast<std::size_t>(((shift + 1) << kSubBits) + ((us >> shift) - kSub));
+}
+
+std::uint64_t Histogram::bucketUpper(std::size_t idx) {
+    if (idx < 2 * kSub) return idx;
+    const unsigned shift = static_cast<unsigned>(idx >> kSubBits) - 1;
+    const std::uint64_t sub = (idx & (kSub - 1)) + kSub;
+    return ((sub + 1) << shift) - 1;
+}
+
+void Histogram::record(std::chrono::steady_clock::duration d) {
+    const auto us = std::chrono::duration_cast<std::chrono::microseconds>(d).count();
+    recordMicros(us > 0 ? static_cast<std::uint64_t>(us) : 0);
+}
+
+void Histogram::recordMicros(std::uint64_t us) {
+    Shard& sh = shards_[MetricShard::index()];
+    sh.buckets[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    sh.sum.fetch_add(us, std::memory_order_relaxed);
+    std::uint64_t m = sh.max.load(std::memory_order_relaxed);
+    while (us > m && !sh.max.compare_exchange_weak(m, us, std::memory_order_relaxed)) {}
+}
+
+Histogram::Snapshot Histogram::snapshot() const {
+    Snapshot s;
+    for (const auto& sh : shards_) {
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            s.buckets[i] += sh.buckets[i].load(std::memory_order_relaxed);
+        }
+        s.sum += sh.sum.load(std::memory_order_relaxed);
+        s.max = std::max(s.max, sh.max.load(std::memory_order_relaxed));
+    }
+    // Buckets are the source of truth for count so percentiles stay consistent
+    // with a concurrent writer.
+    for (const auto b : s.buckets) s.count += b;
+    return s;
+}
+
+std::uint64_t Histogram::Snapshot::percentile(double p) const {
+    if (count == 0) return 0;
+    const auto rank = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(p * static_cast<double>(count))));
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+        seen += buckets[i];
+        if (seen >= rank) return std::min(bucketUpper(i), max);
+    }
+    return max;
+}
+
+std::uint64_t Histogram::Snapshot::countAtOrBelow(std::uint64_t us) const {
+    std::uint64_t n = 0;
+    for (std::size_t i = 0; i < kBuckets && bucketUpper(i) <= us; ++i) n += buckets[i];
+    return n;
+}
+
+Metrics& Metrics::global() {
+    static Metrics m;
+    return m;
+}
+
+const char* Metrics::stageName(Stage s) {
+    switch (s) {
+        case Stage::Ingest: return "ingest";
+        case Stage::Queue: return "queue";
+        case Stage::Debounce: return "debounce";
+        case Stage::Dispatch: return "dispatch";
+        case Stage::Notify: return "notify";
+    }
+    return "?";
+}
+
+std::string Metrics::summary() const {
+    auto ms = [](std::uint64_t us) { return static_cast<double>(us) / 1000.0; };
+    std::string out = fmt::format("{:<10} {:>10} {:>10} {:>10} {:>10} {:>10}\n",
+                                  "stage", "count", "p50 ms", "p99 ms", "p999 ms", "max ms");
+    for (std::size_t i = 0; i < kStages; ++i) {
+        const auto s = stages_[i].snapshot();
+        out += fmt::format("{:<10} {:>10} {:>10.3f} {:>10.3f} {:>10.3f} {:>10.3f}\n",
+                           stageName(static_cast<Stage>(i)), s.count, ms(s.percentile(0.50)),
+                           ms(s.percentile(0.99)), ms(s.percentile(0.999)), ms(s.max));
+    }
+    out += fmt::format("events in={} out={} bus dropped={} coalesced={} flap suppressed={}\n",
+                       eventsIn.value(), eventsOut.value(), busDropped.value(), busCoalesced.value(),
+                       flapSuppressed.value());
+    out += fmt::format("notify sent={} failed={} skipped={}\n",
+                       notifySent.value(), notifyFailed.value(), notifySkipped.value());
+    out += fmt::format("enrich cache hits={} misses={}\n", enrichCacheHits.value(), enrichCacheMisses.value());
+    out += fmt::format("queue depth={} pending={} flapping={} notify backlog={} enrich in flight={} queued={}\n",
+                       queueDepth.value(), pending.value(), flapping.value(), notifyBacklog.value(),
+                       enrichInFlight.value(), enrichQueued.value());
+    return out;
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Threads are spread round-robin over kShards cache lines so hot-path
+// updates from different threads rarely share a line. Readers sum the
+// shards, which only happens at scrape/summary time.
+struct MetricShard {
+    static constexpr std::size_t kShards = 8;
+
+    static std::size_t index() {
+        static std::atomic<std::size_t> next{0};
+        thread_local const std::size_t idx = next.fetch_add(1, std::memory_order_relaxed) % kShards;
+        return idx;
+    }
+};
+
+// Latency histogram with HDR-style log-linear buckets over microseconds:
+// 16 sub-buckets per power of two, so any reported value is within ~6% of
+// the true one. record() is a few relaxed atomic ops on the calling
+// thread's shard; readers take a snapshot without stopping writers.
+class Histogram {
+public:
+    static constexpr unsigned kSubBits = 4;
+    static constexpr unsigned kMaxBits = 40; // larger values clamp (~12 days)
+    static constexpr std::size_t kBuckets = (kMaxBits - kSubBits + 1) << kSubBits;
+
+    struct Snapshot {
+        std::uint64_t count{0};
+        std::uint64_t sum{0}; // microseconds
+        std::uint64_t max{0};
+        std::array<std::uint64_t, kBuckets> buckets{};
+
+        // Upper bound in microseconds of the bucket holding quantile p (0..1).
+        std::uint64_t percentile(double p) const;
+        // Observations <= us, counting a bucket only if it lies entirely below.
+        std::uint64_t countAtOrBelow(std::uint64_t us) const;
+    };
+
+    void record(std::chrono::steady_clock::duration d);
+    void recordMicros(std::uint64_t us);
+    Snapshot snapshot() const;
+
+    static std::size_t bucketOf(std::uint64_t us);
+    static std::uint64_t bucketUpper(std::size_t idx);
+
+private:
+    struct alignas(64) Shard {
+        std::array<std::atomic<std::uint64_t>, kBuckets> buckets{};
+        std::atomic<std::uint64_t> sum{0};
+        std::atomic<std::uint64_t> max{0};
+    };
+    std::array<Shard, MetricShard::kShards> shards_{};
+};
+
+class Counter {
+public:
+    void add(std::uint64_t n = 1) {
+        shards_[MetricShard::index()].v.fetch_add(n, std::memory_order_relaxed);
+    }
+    std::uint64_t value() const {
+        std::uint64_t sum = 0;
+        for (const auto& c : shards_) sum += c.v.load(std::memory_order_relaxed);
+        return sum;
+    }
+
+private:
+    struct alignas(64) Cell {
+        std::atomic<std::uint64_t> v{0};
+    };
+    std::array<Cell, MetricShard::kShards> shards_{};
+};
+
+// Last written value; gauges are set by the one component that owns them.
+class Gauge {
+public:
+    void set(std::int64_t v) { v_.store(v, std::memory_order_relaxed); }
+    std::int64_t value() const { return v_.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<std::int64_t> v_{0};
+};
+
+// Process-wide pipeline instrumentation, from the provider parsing a device
+// list to ExternalNotifier finishing a send. Components record into
+// Metrics::global() directly; nothing here takes a lock.
+// MetricsServer exports it in Prometheus format.
+class Metrics {
+public:
+    enum class Stage {
+        Ingest,   // provider parse -> DeviceManager::onEvent(s) queue entry
+        Queue,    // queue entry -> applied by the DeviceManager worker
+        Debounce, // held in a debounce/coalesce window
+        Dispatch, // EventBus publish -> read by a subscriber thread
+        Notify    // ExternalNotifier queue entry -> send completed
+    };
+    static constexpr std::size_t kStages = 5;
+
+    static Metrics& global();
+    static const char* stageName(Stage s);
+
+    Histogram& stage(Stage s) { return stages_[static_cast<std::size_t>(s)]; }
+    const Histogram& stage(Stage s) const { return stages_[static_cast<std::size_t>(s)]; }
+
+    Counter eventsIn;       // accepted by onEvent(s)
+    Counter eventsOut;      // published to subscribers
+    Counter busDropped;     // lost by lapped DropOldest/CoalescePerUid subscribers
+    Counter busCoalesced;   // superseded during a CoalescePerUid catch-up
+    Counter flapSuppressed; // presence changes absorbed by debounce/flap hold-down
+    Counter notifySent;
+    Counter notifyFailed;
+    Counter notifySkipped;  // not attempted while the output was backing off
+    Counter enrichCacheHits;   // ADB attaches served from the enrichment cache
+    Counter enrichCacheMisses; // ADB attaches that had to wait for getprop
+
+    Gauge queueDepth;       // events waiting for the DeviceManager worker
+    Gauge pending;          // uids with a pending debounced event
+    Gauge flapping;         // uids currently in flap hold-down
+    Gauge notifyBacklog;    // events queued in ExternalNotifier
+    Gauge enrichInFlight;   // ADB getprop sessions running
+    Gauge enrichQueued;     // ADB enrichments waiting for a slot or a retry
+
+    // Stage percentiles plus counters as a small text table.
+    std::string summary() const;
+
+private:
+    std::array<Histogram, kStages> stages_;
+};
@@ -0,0 +1,209 @@
+#include "core/MetricsServer.h"
+
+#include <array>
+#include <chrono>
+#include <istream>
+#include <system_error>
+
+#include <fmt/format.h>
+#include <spdlog/spdlog.h>
+
+#include "core/Metrics.h"
+
+using asio::ip::tcp;
+
+namespace {
+constexpr std::size_t kMaxRequest = 8192;
+
+// Exported histogram bounds (µs). Prometheus wants few, fixed buckets; they
+// are folded out of the finer HDR buckets at scrape time.
+constexpr std::array<std::uint64_t, 13> kBoundsUs = {
+    100, 500, 1000, 5000, 10000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000};
+
+const char* typeLabel(Type t) {
+    switch (t) {
+        case Type::Android: return "android";
+        case Type::iOS: return "ios";
+        default: return "unknown";
+    }
+}
+
+void header(fmt::memory_buffer& out, const char* name, const char* type, const char* help) {
+    fmt::format_to(std::back_inserter(out), "# HELP {} {}\n# TYPE {} {}\n", name, help, name, type);
+}
+
+void counter(fmt::memory_buffer& out, const char* name, const char* help, std::uint64_t v) {
+    header(out, name, "counter", help);
+    fmt::format_to(std::back_inserter(out), "{} {}\n", name, v);
+}
+
+void gauge(fmt::memory_buffer& out, const char* name, const char* help, std::int64_t v) {
+    header(out, name, "gauge", help);
+    fmt::format_to(std::back_inserter(out), "{} {}\n", name, v);
+}
+
+std::string response(const char* status, const char* contentType, const std::string& body) {
+    return fmt::format("HTTP/1.1 {}\r\nContent-Type: {}\r\nContent-Length: {}\r\nConnection: close\r\n\r\n{}",
+                       status, contentType, body.size(), body);
+}
+} // namespace
+
+MetricsServer::MetricsServer(DeviceManager& manager, std::chrono::milliseconds requestTimeout)
+    : manager_(manager), requestTimeout_(requestTimeout), acceptor_(io_) {}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+bool MetricsServer::start(const std::string& endpoint) {
+    if (thread_.joinable()) return true;
+    const auto pos = endpoint.rfind(':');
+    if (pos == std::string::npos) {
+        spdlog::warn("[metrics] invalid endpoint: {}", endpoint);
+        return false;
+    }
+    try {
+        tcp::resolver resolver(io_);
+        const auto results = resolver.resolve(endpoint.substr(0, pos), endpoint.substr(pos + 1));
+        const tcp::endpoint ep = *results.begin();
+        acceptor_.open(ep.protocol());
+        acceptor_.set_option(tcp::acceptor::reuse_address(true));
+        acceptor_.bind(ep);
+        acceptor_.listen();
+    } catch (const std::exception& ex) {
+        spdlog::warn("[metrics] cannot listen on {}: {}", endpoint, ex.what());
+        std::error_code ec;
+        acceptor_.close(ec);
+        return false;
+    }
+    accept();
+    // A previous stop() left io_ stopped; run() would return at once.
+    io_.restart();
+    thread_ = std::thread([this]() { io_.run(); });
+    spdlog::info("[metrics] serving http://{}:{}/metrics", endpoint.substr(0, pos), port());
+    return true;
+}
+
+void MetricsServer::stop() {
+    if (!thread_.joinable()) return;
+    io_.stop();
+    thread_.join();
+    std::error_code ec;
+    acceptor_.close(ec);
+}
+
+unsigned short MetricsServer::port() const {
+    std::error_code ec;
+    const auto ep = acceptor_.local_endpoint(ec);
+    return ec ? 0 : ep.port();
+}
+
+void MetricsServer::accept() {
+    auto sock = std::make_shared<tcp::socket>(io_);
+    acceptor_.async_accept(*sock, [this, sock](std::error_code ec) {
+        if (ec == asio::error::operation_aborted) return;
+        if (!ec) serve(sock);
+        accept();
+    });
+}
+
+void MetricsServer::serve(std::shared_ptr<tcp::socket> sock) {
+    auto buf = std::make_shared<asio::streambuf>(kMaxRequest);
+    auto deadline = std::make_shared<asio::steady_timer>(io_);
+    deadline->expires_after(requestTimeout_);
+    deadline->async_wait([sock](std::error_code ec) {
+        if (ec) return; // cancelled: answered in time
+        std::error_code ignored;
+        sock->close(ignored);
+    });
+    asio::async_read_until(*sock, *buf, "\r\n\r\n", [this, sock, buf, deadline](std::error_code ec, std::size_t) {
+        if (ec) {
+            // closed, timed out, or request larger than kMaxRequest
+            deadline->cancel();
+            return;
+        }
+        std::istream in(buf.get());
+        std::string method;
+        std::string target;
+        in >> method >> target;
+
+        auto resp = std::make_shared<std::string>();
+        if (method != "GET") {
+            *resp = response("405 Method Not Allowed", "text/plain", "GET only\n");
+        } else if (target == "/metrics" || target.rfind("/metrics?", 0) == 0) {
+            *resp = response("200 OK", "text/plain; version=0.0.4; charset=utf-8", render());
+        } else {
+            *resp = response("404 Not Found", "text/plain", "see /metrics\n");
+        }
+        // The deadline also covers the write: a client that stops reading
+        // is dropped like one that stops sending.
+        asio::async_write(*sock, asio::buffer(*resp), [sock, resp, deadline](std::error_code, std::size_t) {
+            deadline->cancel();
+            std::error_code ignored;
+            sock->shutdown(tcp::socket::shutdown_both, ignored);
+        });
+    });
+}
+
+std::string MetricsServer::render() const {
+    const auto& m = Metrics::global();
+    fmt::memory_buffer out;
+    auto it = std::back_inserter(out);
+
+    // Device counts from the published table (lock-free snapshot).
+    const auto table = manager_.table();
+    std::array<std::array<std::size_t, 2>, 3> devices{};
+    for (const auto& kv : table->records) {
+        const auto t = static_cast<std::size_t>(kv.second->info.type);
+        if (t < devices.size()) ++devices[t][kv.second->info.online ? 1 : 0];
+    }
+    header(out, "devicewatcher_devices", "gauge", "Devices in the table by type and state.");
+    for (std::size_t t = 0; t < devices.size(); ++t) {
+        const char* type = typeLabel(static_cast<Type>(t));
+        fmt::format_to(it, "devicewatcher_devices{{type=\"{}\",state=\"online\"}} {}\n", type, devices[t][1]);
+        fmt::format_to(it, "devicewatcher_devices{{type=\"{}\",state=\"offline\"}} {}\n", type, devices[t][0]);
+    }
+    gauge(out, "devicewatcher_table_version", "Change-feed sequence of the published table.",
+          static_cast<std::int64_t>(table->version));
+
+    counter(out, "devicewatcher_events_in_total", "Provider events accepted by DeviceManager.", m.eventsIn.value());
+    counter(out, "devicewatcher_events_out_total", "Events published to subscribers.", m.eventsOut.value());
+    counter(out, "devicewatcher_bus_dropped_total", "Events lost by lapped lossy subscribers.", m.busDropped.value());
+    counter(out, "devicewatcher_bus_coalesced_total", "Events superseded during per-uid coalescing.",
+            m.busCoalesced.value());
+    counter(out, "devicewatcher_flap_suppressed_total", "Presence changes absorbed by flap hold-down.",
+            m.flapSuppressed.value());
+    counter(out, "devicewatcher_notify_sent_total", "Webhook/TCP sends that succeeded.", m.notifySent.value());
+    counter(out, "devicewatcher_notify_failed_total", "Webhook/TCP sends that failed.", m.notifyFailed.value());
+    counter(out, "devicewatcher_notify_skipped_total", "Sends skipped while an output was backing off.",
+            m.notifySkipped.value());
+    counter(out, "devicewatcher_enrich_cache_hits_total", "ADB attaches populated from the enrichment cache.",
+            m.enrichCacheHits.value());
+    counter(out, "devicewatcher_enrich_cache_misses_total", "ADB attaches with no usable cache entry.",
+            m.enrichCacheMisses.value());
+
+    gauge(out, "devicewatcher_ingest_queue_depth", "Events waiting for the DeviceManager worker.", m.queueDepth.value());
+    gauge(out, "devicewatcher_debounce_pending", "Devices with a pending debounced event.", m.pending.value());
+    gauge(out, "devicewatcher_flapping_devices", "Devices currently in flap hold-down.", m.flapping.value());
+    gauge(out, "devicewatcher_enrich_in_flight", "ADB getprop sessions running.", m.enrichInFlight.value());
+    gauge(out, "devicewatcher_enrich_queued", "ADB enrichments waiting for a slot or a retry.",
+          m.enrichQueued.value());
+    gauge(out, "devicewatcher_notify_backlog", "Events queued in the external notifier.", m.notifyBacklog.value());
+
+    header(out, "devicewatcher_stage_latency_seconds", "histogram", "Latency per event pipeline stage.");
+    for (std::size_t i = 0; i < Metrics::kStages; ++i) {
+        const auto stage = static_cast<Metrics::Stage>(i);
+        const char* name = Metrics::stageName(stage);
+        const auto s = m.stage(stage).snapshot();
+        for (const auto us : kBoundsUs) {
+            fmt::format_to(it, "devicewatcher_stage_latency_seconds_bucket{{stage=\"{}\",le=\"{}\"}} {}\n",
+                           name, static_cast<double>(us) / 1e6, s.countAtOrBelow(us));
+        }
+        fmt::format_to(it, "devicewatcher_stage_latency_seconds_bucket{{stage=\"{}\",le=\"+Inf\"}} {}\n", name, s.count);
+        fmt::format_to(it, "devicewatcher_stage_latency_seconds_sum{{stage=\"{}\"}} {}\n",
+                       name, static_cast<double>(s.sum) / 1e6);
+        fmt::format_to(it, "devicewatcher_stage_latency_seconds_count{{stage=\"{}\"}} {}\n", name, s.count);
+    }
+    return fmt::to_string(out);
+}
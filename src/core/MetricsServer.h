@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <thread>
+
+#include <asio.hpp>
+
+#include "core/DeviceManager.h"
+
+// MetricsServer: Prometheus text exposition on GET /metrics. One io_context
+// thread serves all connections. A scrape reads the published device table
+// and the atomic counters in Metrics::global(); it never takes DeviceManager's
+// locks, so scraping costs the event pipeline nothing.
+class MetricsServer {
+public:
+    // A connection not answered within requestTimeout is closed, so a client
+    // that connects and never finishes its request cannot pin a socket.
+    explicit MetricsServer(DeviceManager& manager, std::chrono::milliseconds requestTimeout = std::chrono::seconds(5));
+    ~MetricsServer();
+
+    // endpoint: "host:port" (port 0 picks a free one). Returns false if it
+    // cannot listen there. May be called again after stop().
+    bool start(const std::string& endpoint);
+    void stop();
+    // Bound port once started, else 0.
+    unsigned short port() const;
+
+    // Body served for /metrics.
+    std::string render() const;
+
+private:
+    void accept();
+    void serve(std::shared_ptr<asio::ip::tcp::socket> sock);
+
+    DeviceManager& manager_;
+    const std::chrono::milliseconds requestTimeout_;
+    asio::io_context io_;
+    asio::ip::tcp::acceptor acceptor_;
+    std::thread thread_;
+};
@@ -0,0 +1,281 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// Persistent hash array mapped trie. A map value is a root pointer plus a
+// size: copying one is O(1), and insert/erase copy only the nodes on the
+// path to the key (at most 13 branches of up to 32 children), leaving every
+// other node shared with the previous version. Nodes are immutable once
+// built, so versions can be read from any thread while a new one is made.
+//
+// HashTrie is the common part; use PersistentMap or PersistentSet.
+template <class K, class Entry, class KeyOf, class Hash>
+class HashTrie {
+    static constexpr unsigned kBits = 5;
+    static constexpr std::size_t kHashBits = sizeof(std::size_t) * 8;
+    // Branch levels until the hash is used up, plus the leaf.
+    static constexpr std::size_t kMaxDepth = (kHashBits + kBits - 1) / kBits + 1;
+
+    struct Node;
+    using NodePtr = std::shared_ptr<const Node>;
+
+    // A branch maps hash chunks to children through bitmap; a leaf holds the
+    // entries sharing one full hash (more than one only on collision).
+    struct Node {
+        bool leaf{false};
+        std::size_t hash{0};          // leaf
+        std::vector<Entry> entries;   // leaf
+        std::uint32_t bitmap{0};      // branch
+        std::vector<NodePtr> children; // branch, in bit order
+    };
+
+public:
+    using key_type = K;
+    using value_type = Entry;
+
+    class const_iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = Entry;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const Entry*;
+        using reference = const Entry&;
+
+        const_iterator() = default;
+
+        reference operator*() const { return top().node->entries[top().pos]; }
+        pointer operator->() const { return &**this; }
+
+        const_iterator& operator++() {
+            if (++top().pos < top().node->entries.size()) return *this;
+            // Leaf done: move to the next child of the nearest branch that has one
+            while (--depth_ > 0) {
+                Frame& f = top();
+                if (++f.pos < f.node->children.size()) {
+                    descend(f.node->children[f.pos].get());
+                    return *this;
+                }
+            }
+            return *this;
+        }
+        const_iterator operator++(int) {
+            const_iterator old = *this;
+            ++*this;
+            return old;
+        }
+
+        friend bool operator==(const const_iterator& a, const const_iterator& b) {
+            if (a.depth_ == 0 || b.depth_ == 0) return a.depth_ == b.depth_;
+            return a.top().node == b.top().node && a.top().pos == b.top().pos;
+        }
+        friend bool operator!=(const const_iterator& a, const const_iterator& b) { return !(a == b); }
+
+    private:
+        friend class HashTrie;
+
+        struct Frame {
+            const Node* node;
+            std::size_t pos; // child index in a branch, entry index in a leaf
+        };
+
+        Frame& top() { return stack_[depth_ - 1]; }
+        const Frame& top() const { return stack_[depth_ - 1]; }
+        void push(const Node* n, std::size_t pos) { stack_[depth_++] = Frame{n, pos}; }
+        // Leftmost entry under n.
+        void descend(const Node* n) {
+            while (!n->leaf) {
+                push(n, 0);
+                n = n->children.front().get();
+            }
+            push(n, 0);
+        }
+
+        std::array<Frame, kMaxDepth> stack_{};
+        std::size_t depth_{0}; // 0 = end
+    };
+    using iterator = const_iterator;
+
+    std::size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    const_iterator begin() const {
+        const_iterator it;
+        if (root_) it.descend(root_.get());
+        return it;
+    }
+    const_iterator end() const { return {}; }
+
+    const_iterator find(const K& key) const {
+        const std::size_t h = Hash{}(key);
+        const_iterator it;
+        const Node* n = root_.get();
+        for (unsigned shift = 0; n; shift += kBits) {
+            if (n->leaf) {
+                if (n->hash != h) return end();
+                for (std::size_t i = 0; i < n->entries.size(); ++i) {
+                    if (KeyOf{}(n->entries[i]) == key) {
+                        it.push(n, i);
+                        return it;
+                    }
+                }
+                return end();
+            }
+            const std::uint32_t bit = bitFor(h, shift);
+            if ((n->bitmap & bit) == 0) return end();
+            const std::size_t pos = slot(n->bitmap, bit);
+            it.push(n, pos);
+            n = n->children[pos].get();
+        }
+        return end();
+    }
+    std::size_t count(const K& key) const { return find(key) == end() ? 0 : 1; }
+
+    // Adds e, or replaces the entry with the same key.
+    void insert(Entry e) {
+        const std::size_t h = Hash{}(KeyOf{}(e));
+        bool added = !root_;
+        root_ = root_ ? insertAt(root_, 0, h, std::move(e), added) : makeLeaf(h, std::move(e));
+        if (added) ++size_;
+    }
+
+    // Returns false if key was not present.
+    bool erase(const K& key) {
+        if (!root_) return false;
+        bool removed = false;
+        NodePtr next = eraseAt(root_, 0, Hash{}(key), key, removed);
+        if (!removed) return false;
+        root_ = std::move(next);
+        --size_;
+        return true;
+    }
+
+private:
+    static std::uint32_t bitFor(std::size_t h, unsigned shift) {
+        return std::uint32_t{1} << ((h >> shift) & ((1u << kBits) - 1));
+    }
+    // Index among the set bits below bit.
+    static std::size_t slot(std::uint32_t bitmap, std::uint32_t bit) {
+        std::uint32_t v = bitmap & (bit - 1);
+        std::size_t n = 0;
+        for (; v; v &= v - 1) ++n;
+        return n;
+    }
+
+    static NodePtr makeLeaf(std::size_t h, Entry e) {
+        auto n = std::make_shared<Node>();
+        n->leaf = true;
+        n->hash = h;
+        n->entries.push_back(std::move(e));
+        return n;
+    }
+
+    static NodePtr insertAt(const NodePtr& n, unsigned shift, std::size_t h, Entry e, bool& added) {
+        if (n->leaf) {
+            if (n->hash == h) {
+                auto copy = std::make_shared<Node>();
+                copy->leaf = true;
+                copy->hash = h;
+                copy->entries.reserve(n->entries.size() + 1);
+                bool replaced = false;
+                for (const auto& old : n->entries) {
+                    if (!replaced && KeyOf{}(old) == KeyOf{}(e)) {
+                        copy->entries.push_back(std::move(e));
+                        replaced = true;
+                    } else {
+                        copy->entries.push_back(old);
+                    }
+                }
+                if (!replaced) {
+                    copy->entries.push_back(std::move(e));
+                    added = true;
+                }
+                return copy;
+            }
+            // Different hash in this slot: split into a branch holding both
+            auto branch = std::make_shared<Node>();
+            branch->bitmap = bitFor(n->hash, shift);
+            branch->children.push_back(n);
+            return insertAt(branch, shift, h, std::move(e), added);
+        }
+
+        const std::uint32_t bit = bitFor(h, shift);
+        const std::size_t pos = slot(n->bitmap, bit);
+        auto copy = std::make_shared<Node>(*n);
+        if ((n->bitmap & bit) == 0) {
+            copy->bitmap |= bit;
+            copy->children.insert(copy->children.begin() + static_cast<std::ptrdiff_t>(pos), makeLeaf(h, std::move(e)));
+            added = true;
+        } else {
+            copy->children[pos] = insertAt(n->children[pos], shift + kBits, h, std::move(e), added);
+        }
+        return copy;
+    }
+
+    // Null when n ends up empty. A branch left with a single leaf collapses
+    // into it, so the trie stays no deeper than its hashes require.
+    static NodePtr eraseAt(const NodePtr& n, unsigned shift, std::size_t h, const K& key, bool& removed) {
+        if (n->leaf) {
+            if (n->hash != h) return n;
+            for (std::size_t i = 0; i < n->entries.size(); ++i) {
+                if (!(KeyOf{}(n->entries[i]) == key)) continue;
+                removed = true;
+                if (n->entries.size() == 1) return nullptr;
+                auto copy = std::make_shared<Node>();
+                copy->leaf = true;
+                copy->hash = h;
+                copy->entries.reserve(n->entries.size() - 1);
+                for (std::size_t j = 0; j < n->entries.size(); ++j) {
+                    if (j != i) copy->entries.push_back(n->entries[j]);
+                }
+                return copy;
+            }
+            return n;
+        }
+
+        const std::uint32_t bit = bitFor(h, shift);
+        if ((n->bitmap & bit) == 0) return n;
+        const std::size_t pos = slot(n->bitmap, bit);
+        NodePtr child = eraseAt(n->children[pos], shift + kBits, h, key, removed);
+        if (!removed) return n;
+        if (!child) {
+            if (n->children.size() == 1) return nullptr;
+            if (n->children.size() == 2 && n->children[1 - pos]->leaf) return n->children[1 - pos];
+            auto copy = std::make_shared<Node>(*n);
+            copy->bitmap &= ~bit;
+            copy->children.erase(copy->children.begin() + static_cast<std::ptrdiff_t>(pos));
+            return copy;
+        }
+        if (child->leaf && n->children.size() == 1) return child;
+        auto copy = std::make_shared<Node>(*n);
+        copy->children[pos] = std::move(child);
+        return copy;
+    }
+
+    NodePtr root_;
+    std::size_t size_{0};
+};
+
+namespace persistent_detail {
+struct FirstOf {
+    template <class P>
+    const auto& operator()(const P& p) const { return p.first; }
+};
+struct Self {
+    template <class T>
+    const T& operator()(const T& v) const { return v; }
+};
+} // namespace persistent_detail
+
+// Iterates as std::pair<const K, V>; insert({k, v}) adds or replaces.
+template <class K, class V, class Hash = std::hash<K>>
+using PersistentMap = HashTrie<K, std::pair<const K, V>, persistent_detail::FirstOf, Hash>;
+
+template <class K, class Hash = std::hash<K>>
+using PersistentSet = HashTrie<K, K, persistent_detail::Self, Hash>;
@@ -0,0 +1,84 @@
+#include "core/TimerHeap.h"
+
+#include <utility>
+
+void TimerHeap::schedule(const std::string& key, TimePoint deadline) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        const std::size_t i = it->second;
+        const TimePoint old = heap_[i].deadline;
+        heap_[i].deadline = deadline;
+        if (deadline < old) siftUp(i);
+        else siftDown(i);
+        return;
+    }
+    auto ins = index_.emplace(key, heap_.size());
+    heap_.push_back(Node{deadline, &*ins.first});
+    siftUp(heap_.size() - 1);
+}
+
+bool TimerHeap::cancel(const std::string& key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) return false;
+    removeAt(it->second);
+    return true;
+}
+
+TimerHeap::TimePoint TimerHeap::nextDeadline() const {
+    return heap_.empty() ? TimePoint::max() : heap_.front().deadline;
+}
+
+bool TimerHeap::popExpired(TimePoint now, std::string& keyOut) {
+    if (heap_.empty() || heap_.front().deadline > now) return false;
+    keyOut = heap_.front().entry->first;
+    removeAt(0);
+    return true;
+}
+
+void TimerHeap::clear() {
+    heap_.clear();
+    index_.clear();
+}
+
+void TimerHeap::siftUp(std::size_t i) {
+    while (i > 0) {
+        const std::size_t parent = (i - 1) / 2;
+        if (!(heap_[i].deadline < heap_[parent].deadline)) break;
+        swapNodes(i, parent);
+        i = parent;
+    }
+}
+
+void TimerHeap::siftDown(std::size_t i) {
+    const std::size_t n = heap_.size();
+    for (;;) {
+        const std::size_t l = 2 * i + 1;
+        const std::size_t r = l + 1;
+        std::size_t smallest = i;
+        if (l < n && heap_[l].deadline < heap_[smallest].deadline) smallest = l;
+        if (r < n && heap_[r].deadline < heap_[smallest].deadline) smallest = r;
+        if (smallest == i) break;
+        swapNodes(i, smallest);
+        i = smallest;
+    }
+}
+
+void TimerHeap::swapNodes(std::size_t a, std::size_t b) {
+    std::swap(heap_[a], heap_[b]);
+    heap_[a].entry->second = a;
+    heap_[b].entry->second = b;
+}
+
+void TimerHeap::removeAt(std::size_t i) {
+    index_.erase(index_.find(heap_[i].entry->first));
+    const std::size_t last = heap_.size() - 1;
+    if (i != last) {
+        heap_[i] = heap_[last];
+        heap_[i].entry->second = i;
+    }
+    heap_.pop_back();
+    if (i < heap_.size()) {
+        siftUp(i);
+        siftDown(i);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Indexed binary min-heap of deadlines keyed by string (e.g. device uid).
+// Each key holds at most one deadline; schedule() on an existing key moves it.
+// schedule/cancel/popExpired are O(log n), nextDeadline is O(1).
+class TimerHeap {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimePoint = Clock::time_point;
+
+    // Insert key or reschedule it to the new deadline.
+    void schedule(const std::string& key, TimePoint deadline);
+    // Remove key if scheduled; returns false if it was not.
+    bool cancel(const std::string& key);
+
+    bool contains(const std::string& key) const { return index_.count(key) != 0; }
+    bool empty() const { return heap_.empty(); }
+    std::size_t size() const { return heap_.size(); }
+
+    // Earliest deadline, or TimePoint::max() when empty.
+    TimePoint nextDeadline() const;
+    // Pop the earliest key if its deadline is <= now.
+    bool popExpired(TimePoint now, std::string& keyOut);
+
+    void clear();
+
+private:
+    using Index = std::unordered_map<std::string, std::size_t>;
+
+    // entry points into index_ (element pointers survive rehash), so moving a
+    // node updates its position without re-hashing the key.
+    struct Node {
+        TimePoint deadline;
+        Index::value_type* entry;
+    };
+
+    void siftUp(std::size_t i);
+    void siftDown(std::size_t i);
+    void swapNodes(std::size_t a, std::size_t b);
+    void removeAt(std::size_t i);
+
+    std::vector<Node> heap_;
+    Index index_; // key -> position in heap_
+};
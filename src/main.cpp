@@ -2,8 +2,10 @@
 
 #include <iostream>
 #include <string>
+#include <cerrno>
 #include <cstdlib>
 #include <chrono>
+#include <ctime>
 
 #include <fmt/core.h>
 #include <spdlog/spdlog.h>
@@ -18,6 +20,7 @@
 #include "ui/CliMenu.h"
 #include "core/DeviceManager.h"
 #include "core/ExternalNotifier.h"
+#include "core/MetricsServer.h"
 #include "providers/AndroidAdbProvider.h"
 #include "providers/IosUsbmuxProvider.h"
 #ifdef _WIN32
@@ -30,7 +33,99 @@
 #endif
 
 static void print_help(const char* argv0) {
-    std::cout << "Usage: " << argv0 << " [--help] [--version]\n";
+    std::cout << "Usage: " << argv0 << " [--help] [--version]\n"
+              << "       " << argv0 << " --replay <journal-dir> [--speed X] [--from EPOCH] [--to EPOCH]\n"
+              << "Set DW_JOURNAL_DIR to journal device events and restore them on restart.\n"
+              << "Set DW_METRICS_ADDR (e.g. 127.0.0.1:9464) to serve Prometheus metrics on /metrics.\n"
+              << "Set DW_ADB_ENRICH_CONCURRENCY to limit parallel ADB getprop sessions (default 4).\n"
+              << "Set DW_ADB_PROPS (comma-separated) to fetch extra Android properties on attach.\n"
+              << "Set DW_ADB_TRACK=text to skip the binary device tracker.\n"
+              << "Set DW_ADB_SERVERS=[label=]host:port,... to watch several ADB servers (uids become label/serial).\n"
+              << "Set DW_ADB_GRACE_MS to how long devices survive a lost ADB connection (default 10000, 0 = detach at once).\n"
+              << "Set DW_ADB_CACHE to a file to keep Android properties across restarts (revalidated in the background).\n";
+}
+
+// when: the time printed for the event.
+static void printEvent(const DeviceEvent& evt, std::chrono::system_clock::time_point when) {
+    std::string hhmmss = Utils::formatTimeHHMMSS(when);
+
+    auto kindToStr = [](DeviceEvent::Kind k) {
+        switch (k) {
+            case DeviceEvent::Kind::Attach: return "ATTACH";
+            case DeviceEvent::Kind::Detach: return "DETACH";
+            case DeviceEvent::Kind::InfoUpdated: return "INFO"; // shorter label
+        }
+        return "INFO";
+    };
+    auto typeToStr = [](Type t) {
+        switch (t) {
+            case Type::Android: return "ANDROID";
+            case Type::iOS: return "IOS";
+            default: return "UNKNOWN";
+        }
+    };
+
+    const auto& di = evt.info;
+    // Print enriched fields when available
+    fmt::print("[{}] {:<7} {} SN={} manufacturer={} model={} os={} abi={} state={}\n",
+               hhmmss, kindToStr(evt.kind), typeToStr(di.type), di.uid,
+               di.manufacturer, di.model, di.osVersion, di.abi, di.adbState);
+}
+
+// Whole string must be a non-negative number.
+static bool parseSpeed(const char* s, double& out) {
+    char* end = nullptr;
+    out = std::strtod(s, &end);
+    return end != s && *end == '\0' && out >= 0;
+}
+
+// Whole string must be an integer count of seconds since the epoch.
+static bool parseEpoch(const char* s, std::chrono::system_clock::time_point& out) {
+    char* end = nullptr;
+    errno = 0;
+    const long long v = std::strtoll(s, &end, 10);
+    if (end == s || *end != '\0' || errno == ERANGE) return false;
+    out = std::chrono::system_clock::from_time_t(static_cast<std::time_t>(v));
+    return true;
+}
+
+// --replay <dir> [--speed X] [--from EPOCH] [--to EPOCH]: print journaled events and exit.
+static int runReplay(int argc, char** argv) {
+    if (argc < 3) {
+        print_help(argv[0]);
+        return 1;
+    }
+    DeviceManager::ReplayOptions opts;
+    for (int i = 3; i < argc; ++i) {
+        const std::string opt = argv[i];
+        if (opt != "--speed" && opt != "--from" && opt != "--to") {
+            fmt::print(stderr, "unknown option {}\n", opt);
+            print_help(argv[0]);
+            return 1;
+        }
+        if (i + 1 >= argc) {
+            fmt::print(stderr, "{} needs a value\n", opt);
+            print_help(argv[0]);
+            return 1;
+        }
+        const char* val = argv[++i];
+        const bool ok = opt == "--speed" ? parseSpeed(val, opts.speed)
+                        : opt == "--from" ? parseEpoch(val, opts.from)
+                                          : parseEpoch(val, opts.to);
+        if (!ok) {
+            fmt::print(stderr, "bad value for {}: {}\n", opt, val);
+            print_help(argv[0]);
+            return 1;
+        }
+    }
+    DeviceManager manager;
+    DeviceManager::SubscribeOptions printerOpts;
+    printerOpts.overflow = DeviceManager::Overflow::Block; // replay must not lose lines
+    // Journaled time, not now: a replay of yesterday prints yesterday
+    manager.subscribe([](const DeviceEvent& evt) { printEvent(evt, evt.delivered); }, printerOpts);
+    const auto n = manager.replayJournal(argv[2], opts);
+    spdlog::info("[journal] replayed {} event(s)", n);
+    return 0;
 }
 
 int main(int argc, char** argv) {
@@ -57,43 +152,40 @@ int main(int argc, char** argv) {
             std::cout << "DeviceWatcher " << DEVICEWATCHER_VERSION << "\n";
             return 0;
         }
+        if (arg == "--replay") {
+            return runReplay(argc, argv);
+        }
     }
 
     fmt::print("DeviceWatcher started\n");
     spdlog::info("DeviceWatcher version {}", DEVICEWATCHER_VERSION);
 
     DeviceManager manager;
+    // Optional event journal: restores the device table across restarts.
+    if (const char* journalDir = std::getenv("DW_JOURNAL_DIR"); journalDir && *journalDir) {
+        if (!manager.openJournal(journalDir)) {
+            spdlog::warn("[journal] disabled; cannot use {}", journalDir);
+        }
+    }
     ExternalNotifier notifier(manager);
+    // Optional Prometheus exporter
+    MetricsServer metrics(manager);
+    if (const char* metricsAddr = std::getenv("DW_METRICS_ADDR"); metricsAddr && *metricsAddr) {
+        metrics.start(metricsAddr);
+    }
     // Real-time printing switch (default on)
     bool realtimePrint = true;
-    // Subscribe printer
+    // Subscribe printer (own delivery thread; a stalled console drops oldest lines
+    // instead of holding back the device table)
+    DeviceManager::SubscribeOptions printerOpts;
+    printerOpts.overflow = DeviceManager::Overflow::DropOldest;
+    // INFO lines only when a printed field changed
+    printerOpts.filter.changedMask = DeviceField::Type | DeviceField::Manufacturer | DeviceField::Model |
+                                     DeviceField::OsVersion | DeviceField::Abi | DeviceField::AdbState;
     manager.subscribe([&](const DeviceEvent& evt) {
         if (!realtimePrint) return; // process but don't print
-        const auto nowSys = std::chrono::system_clock::now();
-        std::string hhmmss = Utils::formatTimeHHMMSS(nowSys);
-
-        auto kindToStr = [](DeviceEvent::Kind k) {
-            switch (k) {
-                case DeviceEvent::Kind::Attach: return "ATTACH";
-                case DeviceEvent::Kind::Detach: return "DETACH";
-                case DeviceEvent::Kind::InfoUpdated: return "INFO"; // shorter label
-            }
-            return "INFO";
-        };
-        auto typeToStr = [](Type t) {
-            switch (t) {
-                case Type::Android: return "ANDROID";
-                case Type::iOS: return "IOS";
-                default: return "UNKNOWN";
-            }
-        };
-
-        const auto& di = evt.info;
-        // Print enriched fields when available
-        fmt::print("[{}] {:<7} {} SN={} manufacturer={} model={} os={} abi={} state={}\n",
-                   hhmmss, kindToStr(evt.kind), typeToStr(di.type), di.uid,
-                   di.manufacturer, di.model, di.osVersion, di.abi, di.adbState);
-    });
+        printEvent(evt, std::chrono::system_clock::now());
+    }, printerOpts);
 
     AndroidAdbProvider adb(manager);
     // Auto-start Android watcher; printing controlled via menu
@@ -104,6 +196,6 @@ int main(int argc, char** argv) {
     usb.start();
 #endif
     IosUsbmuxProvider ios(manager);
-    CliMenu menu(manager, realtimePrint, ios, notifier);
+    CliMenu menu(manager, realtimePrint, ios, adb, notifier);
     return menu.run();
 }
@@ -0,0 +1,149 @@
+#include "providers/AdbProtocol.h"
+
+#include <charconv>
+#include <iterator>
+
+namespace adb {
+namespace {
+bool isSpace(char ch) {
+    return static_cast<unsigned char>(ch) <= 32;
+}
+
+// Next whitespace-separated token; empty once text is exhausted.
+std::string_view nextToken(std::string_view& text) {
+    std::size_t i = 0;
+    while (i < text.size() && isSpace(text[i])) ++i;
+    std::size_t j = i;
+    while (j < text.size() && !isSpace(text[j])) ++j;
+    std::string_view tok = text.substr(i, j - i);
+    text.remove_prefix(j);
+    return tok;
+}
+
+bool takeValue(std::string_view tok, std::string_view key, std::string_view& out) {
+    if (tok.size() < key.size() || tok.compare(0, key.size(), key) != 0) return false;
+    out = tok.substr(key.size());
+    return true;
+}
+} // namespace
+
+bool parseHexLen4(std::string_view text, std::size_t& out) {
+    if (text.size() < 4) return false;
+    unsigned int v = 0;
+    const auto r = std::from_chars(text.data(), text.data() + 4, v, 16);
+    if (r.ec != std::errc() || r.ptr != text.data() + 4) return false;
+    out = v;
+    return true;
+}
+
+std::string_view trim(std::string_view s) {
+    while (!s.empty() && isSpace(s.front())) s.remove_prefix(1);
+    while (!s.empty() && isSpace(s.back())) s.remove_suffix(1);
+    return s;
+}
+
+bool parseTrackLine(std::string_view line, TrackLine& out) {
+    out = TrackLine{};
+    out.serial = nextToken(line);
+    if (out.serial.empty()) return false;
+    out.state = nextToken(line);
+    if (out.state.empty()) return false;
+    // remaining tokens are key:value pairs
+    for (auto tok = nextToken(line); !tok.empty(); tok = nextToken(line)) {
+        takeValue(tok, "product:", out.product) || takeValue(tok, "model:", out.model) ||
+            takeValue(tok, "device:", out.device) || takeValue(tok, "transport_id:", out.transportId) ||
+            takeValue(tok, "usb:", out.usb);
+    }
+    return true;
+}
+
+bool parseGetpropLine(std::string_view line, std::string_view& key, std::string_view& value) {
+    if (line.empty() || line.front() != '[') return false;
+    const auto rb1 = line.find(']');
+    if (rb1 == std::string_view::npos) return false;
+    const auto lb2 = line.find('[', rb1);
+    if (lb2 == std::string_view::npos) return false;
+    const auto rb2 = line.find(']', lb2);
+    if (rb2 == std::string_view::npos) return false;
+    key = trim(line.substr(1, rb1 - 1));
+    value = trim(line.substr(lb2 + 1, rb2 - lb2 - 1));
+    return true;
+}
+
+bool nextProtoField(std::string_view& msg, std::uint32_t& field, std::uint32_t& wireType, std::uint64_t& num,
+                    std::string_view& bytes) {
+    auto varint = [&msg](std::uint64_t& v) {
+        v = 0;
+        for (int shift = 0; shift < 64 && !msg.empty(); shift += 7) {
+            const auto b = static_cast<std::uint8_t>(msg.front());
+            msg.remove_prefix(1);
+            v |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return true;
+        }
+        return false;
+    };
+    auto fixed = [&msg, &num](std::size_t n) {
+        if (msg.size() < n) return false;
+        num = 0;
+        for (std::size_t i = 0; i < n; ++i) num |= static_cast<std::uint64_t>(static_cast<std::uint8_t>(msg[i])) << (8 * i);
+        msg.remove_prefix(n);
+        return true;
+    };
+
+    std::uint64_t key = 0;
+    if (!varint(key)) return false;
+    field = static_cast<std::uint32_t>(key >> 3);
+    wireType = static_cast<std::uint32_t>(key & 7);
+    if (field == 0) return false;
+    switch (wireType) {
+        case 0: return varint(num);
+        case 1: return fixed(8);
+        case 5: return fixed(4);
+        case 2: {
+            std::uint64_t n = 0;
+            if (!varint(n) || n > msg.size()) return false;
+            bytes = msg.substr(0, static_cast<std::size_t>(n));
+            msg.remove_prefix(static_cast<std::size_t>(n));
+            return true;
+        }
+        default: return false; // groups are not used by adb
+    }
+}
+
+bool parseProtoDevice(std::string_view msg, ProtoDevice& out) {
+    out = ProtoDevice{};
+    while (!msg.empty()) {
+        std::uint32_t field = 0, wireType = 0;
+        std::uint64_t num = 0;
+        std::string_view bytes;
+        if (!nextProtoField(msg, field, wireType, num, bytes)) return false;
+        const bool isVarint = (wireType == 0);
+        const bool isBytes = (wireType == 2);
+        switch (field) {
+            case 1: if (isBytes) out.serial = bytes; break;
+            case 2: if (isVarint) out.state = static_cast<int>(num); break;
+            case 3: if (isBytes) out.busAddress = bytes; break;
+            case 4: if (isBytes) out.product = bytes; break;
+            case 5: if (isBytes) out.model = bytes; break;
+            case 6: if (isBytes) out.device = bytes; break;
+            case 7: if (isVarint) out.connectionType = static_cast<ConnectionType>(num); break;
+            case 8: if (isVarint) out.negotiatedSpeed = static_cast<std::int64_t>(num); break;
+            case 9: if (isVarint) out.maxSpeed = static_cast<std::int64_t>(num); break;
+            case 10: if (isVarint) out.transportId = static_cast<std::int64_t>(num); break;
+            default: break; // newer servers may add fields
+        }
+    }
+    return !out.serial.empty();
+}
+
+std::string_view connectionStateName(int state) {
+    // Indexed by ConnectionState
+    static constexpr std::string_view kNames[] = {
+        "any", "connecting", "authorizing", "unauthorized", "no permissions", "detached", "offline",
+        "bootloader", "device", "host", "recovery", "sideload", "rescue"};
+    static_assert(std::size(kNames) == static_cast<std::size_t>(ConnectionState::Rescue) + 1);
+    if (state < 0 || state >= static_cast<int>(std::size(kNames))) return "unknown";
+    return kNames[state];
+}
+
+} // namespace adb
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+// Allocation-free parsers for the ADB smart-socket protocol. Every result is
+// a string_view into the caller's buffer and is valid only as long as it.
+namespace adb {
+
+// 4 hex digits, as used by length prefixes. False on anything else.
+bool parseHexLen4(std::string_view text, std::size_t& out);
+
+// Strips ASCII whitespace and control characters from both ends.
+std::string_view trim(std::string_view s);
+
+// Calls fn(line) for every non-empty line, without the '\n' / "\r\n".
+template <typename Fn>
+void forEachLine(std::string_view text, Fn&& fn) {
+    while (!text.empty()) {
+        const auto nl = text.find('\n');
+        std::string_view line = text.substr(0, nl);
+        text.remove_prefix(nl == std::string_view::npos ? text.size() : nl + 1);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (!line.empty()) fn(line);
+    }
+}
+
+// One host:track-devices-l line: "<serial> <state> [key:value ...]",
+// separated by tabs or spaces.
+struct TrackLine {
+    std::string_view serial;
+    std::string_view state;
+    std::string_view product;
+    std::string_view model;
+    std::string_view device;
+    std::string_view transportId;
+    std::string_view usb; // bus address, e.g. "1-1.2"
+};
+bool parseTrackLine(std::string_view line, TrackLine& out);
+
+// One getprop line: "[key]: [value]", both trimmed.
+bool parseGetpropLine(std::string_view line, std::string_view& key, std::string_view& value);
+
+// host:track-devices-proto-binary. Each block is a serialized Devices
+// message (adb_host.proto): repeated Device device = 1.
+enum class ConnectionType { Unknown = 0, Usb = 1, Socket = 2 };
+
+// adb's ConnectionState; values are the wire numbers.
+enum class ConnectionState {
+    Any = 0,
+    Connecting = 1,
+    Authorizing = 2,
+    Unauthorized = 3,
+    NoPermission = 4,
+    Detached = 5,
+    Offline = 6,
+    Bootloader = 7,
+    Device = 8,
+    Host = 9,
+    Recovery = 10,
+    Sideload = 11,
+    Rescue = 12,
+};
+
+struct ProtoDevice {
+    std::string_view serial;      // 1
+    int state{-1};                // 2, ConnectionState
+    std::string_view busAddress;  // 3
+    std::string_view product;     // 4
+    std::string_view model;       // 5
+    std::string_view device;      // 6
+    ConnectionType connectionType{ConnectionType::Unknown}; // 7
+    std::int64_t negotiatedSpeed{0}; // 8, Mbit/s
+    std::int64_t maxSpeed{0};        // 9, Mbit/s
+    std::int64_t transportId{0};     // 10
+};
+
+// Reads the next field of a protobuf message and advances msg. Varint and
+// fixed-width values land in num; length-delimited ones in bytes.
+bool nextProtoField(std::string_view& msg, std::uint32_t& field, std::uint32_t& wireType, std::uint64_t& num,
+                    std::string_view& bytes);
+
+// Calls fn(raw) with the encoded bytes of each Device in a Devices block.
+// False if the block is malformed (devices before the error were visited).
+template <typename Fn>
+bool forEachProtoDevice(std::string_view devices, Fn&& fn) {
+    while (!devices.empty()) {
+        std::uint32_t field = 0, wireType = 0;
+        std::uint64_t num = 0;
+        std::string_view bytes;
+        if (!nextProtoField(devices, field, wireType, num, bytes)) return false;
+        if (field == 1 && wireType == 2) fn(bytes);
+    }
+    return true;
+}
+
+bool parseProtoDevice(std::string_view msg, ProtoDevice& out);
+
+// ConnectionState as the text tracker spells it ("device", "offline", ...);
+// "unknown" for values this table does not know.
+std::string_view connectionStateName(int state);
+
+} // namespace adb
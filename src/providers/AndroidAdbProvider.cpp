@@ -1,39 +1,326 @@
 #include "providers/AndroidAdbProvider.h"
 
+#include <algorithm>
 #include <chrono>
 #include <array>
 #include <vector>
 #include <sstream>
 #include <stdexcept>
-#include <regex>
 #include <system_error>
 
 #include <fmt/core.h>
 #include <spdlog/spdlog.h>
 #include <cstdlib>
 
+#include "core/Metrics.h"
+#include "providers/AdbProtocol.h"
+
 using asio::ip::tcp;
 
+namespace {
+// Reconnect backoff: base * 2^attempt, capped, with the upper half jittered
+// so several watchers do not hammer a restarting server in lockstep.
+constexpr std::chrono::milliseconds kReconnectBase(250);
+constexpr std::chrono::milliseconds kReconnectMax(30000);
+// How long devices of a lost session are kept before they are detached.
+constexpr std::chrono::milliseconds kDefaultGrace(10000);
+// A getprop session that has not finished by then is abandoned.
+constexpr std::chrono::seconds kEnrichTimeout(10);
+constexpr std::size_t kMaxGetpropBytes = 262144;
+// Properties DeviceInfo is built from, plus the fingerprint the enrichment
+// cache is keyed by; DW_ADB_PROPS can add more.
+constexpr const char* kDefaultProps[] = {"ro.product.manufacturer", "ro.product.model", "ro.build.version.release",
+                                         "ro.product.cpu.abi", EnrichCache::kFingerprintKey};
+// Coalesces cache writes during an attach storm.
+constexpr std::chrono::seconds kCacheSaveDelay(5);
+
+// Error messages can carry localized text; keep log lines ASCII.
+std::string asciiMessage(std::string msg) {
+    for (char& ch : msg) {
+        if (static_cast<unsigned char>(ch) < 32 || static_cast<unsigned char>(ch) > 126) ch = '?';
+    }
+    return msg;
+}
+
+std::chrono::milliseconds graceWindow() {
+    if (const char* s = std::getenv("DW_ADB_GRACE_MS")) {
+        const long ms = std::atol(s);
+        if (ms >= 0) return std::chrono::milliseconds(ms);
+    }
+    return kDefaultGrace;
+}
+
+EnrichScheduler::Options enrichOptions() {
+    EnrichScheduler::Options opts;
+    if (const char* s = std::getenv("DW_ADB_ENRICH_CONCURRENCY")) {
+        const int n = std::atoi(s);
+        if (n > 0) opts.maxInFlight = static_cast<std::size_t>(n);
+    }
+    return opts;
+}
+
+// Keys end up in a shell command line, so only property-name characters pass.
+bool validPropKey(const std::string& key) {
+    if (key.empty()) return false;
+    for (char ch : key) {
+        const bool ok = (ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') ||
+                        ch == '.' || ch == '_' || ch == '-';
+        if (!ok) return false;
+    }
+    return true;
+}
+
+EnrichCache::Options cacheOptions() {
+    EnrichCache::Options opts;
+    if (const char* s = std::getenv("DW_ADB_CACHE")) opts.path = s;
+    return opts;
+}
+
+std::vector<std::string> enrichProps() {
+    std::vector<std::string> keys(std::begin(kDefaultProps), std::end(kDefaultProps));
+    if (const char* s = std::getenv("DW_ADB_PROPS")) {
+        std::istringstream iss(s);
+        std::string key;
+        while (std::getline(iss, key, ',')) {
+            if (key.empty()) continue;
+            if (!validPropKey(key)) {
+                spdlog::warn("[ADB] ignoring invalid property name in DW_ADB_PROPS: {}", key);
+            } else if (std::find(keys.begin(), keys.end(), key) == keys.end()) {
+                keys.push_back(key);
+            }
+        }
+    }
+    return keys;
+}
+
+// One shell round trip that prints only the wanted keys, in getprop's own
+// "[key]: [value]" format so the same parser handles both modes.
+std::string targetedGetprop(const std::vector<std::string>& keys) {
+    std::string cmd = "shell:for p in";
+    for (const auto& key : keys) cmd += " " + key;
+    cmd += "; do echo \"[$p]: [$(getprop $p)]\"; done";
+    return cmd;
+}
+
+// asyncRequest reports a FAIL reply (as opposed to an I/O error) this way.
+bool isFailReply(const std::string& failMsg) {
+    return failMsg.rfind("ADB FAIL", 0) == 0;
+}
+
+// "host:port" or "[v6]:port"; a missing port means the default.
+void splitHostPort(const std::string& s, std::string& host, std::string& port) {
+    const auto pos = s.rfind(':');
+    if (pos == std::string::npos || (s.find(']') != std::string::npos && pos < s.find(']'))) {
+        host = s;
+        return;
+    }
+    host = s.substr(0, pos);
+    port = s.substr(pos + 1);
+    if (host.size() > 2 && host.front() == '[' && host.back() == ']') host = host.substr(1, host.size() - 2);
+}
+
+bool isEof(const std::error_code& ec) {
+    return ec == asio::error::eof
+#ifdef _WIN32
+           // On Windows a peer close may surface as WSAECONNRESET
+           || ec.value() == 10054
+#endif
+        ;
+}
+} // namespace
+
+// host:transport + a targeted getprop on its own connection. If the device's
+// shell prints nothing usable, a second connection runs the full dump.
+class AndroidAdbProvider::EnrichSession : public std::enable_shared_from_this<EnrichSession> {
+public:
+    EnrichSession(AndroidAdbProvider& owner, const Endpoint& ep, std::string uid)
+        : owner_(owner), ep_(ep), uid_(std::move(uid)), serial_(uid_.substr(ep.uidPrefix.size())),
+          socket_(owner.io_), timer_(owner.io_) {}
+
+    void start() {
+        auto self = shared_from_this();
+        timer_.expires_after(kEnrichTimeout);
+        timer_.async_wait([self](std::error_code ec) {
+            if (ec) return;
+            spdlog::warn("[ADB] enrich timed out uid={}", self->uid_);
+            self->cancel();
+        });
+        connect();
+    }
+
+    void cancel() {
+        std::error_code ec;
+        socket_.close(ec);
+        timer_.cancel();
+    }
+
+private:
+    void connect() {
+        auto self = shared_from_this();
+        asio::async_connect(socket_, ep_.addrs, [self](std::error_code ec, const tcp::endpoint&) {
+            if (ec) return self->fail(ec, {});
+            spdlog::debug("[ADB] enrich connected for uid={}", self->uid_);
+            self->selectTransport();
+        });
+    }
+
+    void selectTransport() {
+        auto self = shared_from_this();
+        asyncRequest(socket_, fmt::format("host:transport:{}", serial_),
+                     [self](std::error_code ec, const std::string& failMsg) {
+            if (ec) return self->fail(ec, failMsg);
+            const std::string& cmd = self->full_ ? std::string("shell:getprop") : self->owner_.targetedCmd_;
+            asyncRequest(self->socket_, cmd, [self](std::error_code ec2, const std::string& failMsg2) {
+                if (ec2) return self->fail(ec2, failMsg2);
+                self->readSome();
+            });
+        });
+    }
+
+    void readSome() {
+        auto self = shared_from_this();
+        socket_.async_read_some(asio::buffer(buf_), [self](std::error_code ec, std::size_t n) {
+            self->out_.append(self->buf_.data(), n);
+            if (isEof(ec) || (!ec && self->out_.size() >= kMaxGetpropBytes)) return self->done();
+            if (ec) return self->fail(ec, {});
+            self->readSome();
+        });
+    }
+
+    void done() {
+        const auto parsedAt = std::chrono::steady_clock::now();
+        spdlog::debug("[ADB] enrich getprop bytes={} full={} for uid={}", out_.size(), full_, uid_);
+        const Props props = parseGetprop(out_, owner_.enrichProps_);
+        if (props.empty() && !full_) {
+            spdlog::debug("[ADB] targeted getprop printed nothing for uid={}; using full dump", uid_);
+            full_ = true;
+            out_.clear();
+            std::error_code ignored;
+            socket_.close(ignored);
+            return connect();
+        }
+        timer_.cancel();
+
+        DeviceInfo info;
+        info.type = Type::Android;
+        info.uid = uid_;
+        info.online = true;
+        info.adbState = "device";
+        applyProps(props, info);
+
+        DeviceEvent evt{ DeviceEvent::Kind::InfoUpdated, info };
+        evt.observed = parsedAt;
+        owner_.manager_.onEvent(evt);
+        owner_.cacheEnrichResult(serial_, props);
+        spdlog::info("[ADB] enrich result uid={} manufacturer={} model={} os={} abi={}",
+                     uid_, info.manufacturer, info.model, info.osVersion, info.abi);
+        for (const auto& kv : props) spdlog::debug("[ADB] enrich prop uid={} {}={}", uid_, kv.first, kv.second);
+        owner_.finishEnrich(uid_, true);
+    }
+
+    void fail(const std::error_code& ec, const std::string& failMsg) {
+        timer_.cancel();
+        if (ec != asio::error::operation_aborted) {
+            spdlog::warn("[ADB] enrich failed uid={} msg={}", uid_,
+                         asciiMessage(failMsg.empty() ? ec.message() : failMsg));
+        }
+        owner_.finishEnrich(uid_, false);
+    }
+
+    AndroidAdbProvider& owner_;
+    const Endpoint& ep_;
+    std::string uid_;
+    std::string serial_; // uid without the endpoint prefix
+    tcp::socket socket_;
+    asio::steady_timer timer_;
+    std::array<char, 4096> buf_{};
+    std::string out_;
+    bool full_{false};
+};
+
 AndroidAdbProvider::AndroidAdbProvider(DeviceManager& manager)
-    : manager_(manager) {
-    // Allow overriding ADB server via env
-    if (const char* s = std::getenv("ADB_SERVER_SOCKET")) {
-        std::string v = s;
-        // Expect tcp:HOST:PORT
-        const std::string prefix = "tcp:";
-        if (v.rfind(prefix, 0) == 0) {
-            std::string rest = v.substr(prefix.size());
-            auto pos = rest.rfind(':');
-            if (pos != std::string::npos) {
-                host_ = rest.substr(0, pos);
-                port_ = rest.substr(pos + 1);
+    : manager_(manager), graceWindow_(graceWindow()), rng_(std::random_device{}()),
+      enrichQueue_(enrichOptions()),
+      enrichTimer_(manager.clock(), [this]() {
+          asio::post(io_, [this]() {
+              if (running_) pumpEnrich();
+          });
+      }),
+      enrichProps_(enrichProps()), targetedCmd_(targetedGetprop(enrichProps_)),
+      enrichCache_(cacheOptions()), cacheTimer_(io_) {
+    if (const char* t = std::getenv("DW_ADB_TRACK"); t && std::string(t) == "text") preferProto_ = false;
+
+    auto add = [this](std::string label, std::string host, std::string port) {
+        if (label.empty()) label = host + ":" + port;
+        for (const auto& other : endpoints_) {
+            if (other->label == label) {
+                spdlog::warn("[ADB] ignoring duplicate server {}", label);
+                return;
             }
         }
+        auto ep = std::make_unique<Endpoint>(io_);
+        ep->label = std::move(label);
+        ep->host = std::move(host);
+        ep->port = std::move(port);
+        ep->protoTrack = preferProto_;
+        ep->stats.label = ep->label;
+        endpoints_.push_back(std::move(ep));
+    };
+
+    // DW_ADB_SERVERS: "[label=]host:port,..." for watching several servers
+    if (const char* s = std::getenv("DW_ADB_SERVERS")) {
+        std::istringstream iss(s);
+        std::string item;
+        while (std::getline(iss, item, ',')) {
+            if (item.empty()) continue;
+            std::string label;
+            const auto eq = item.find('=');
+            if (eq != std::string::npos) {
+                label = item.substr(0, eq);
+                item = item.substr(eq + 1);
+            }
+            std::string host, port = "5037";
+            splitHostPort(item, host, port);
+            if (host.empty() || port.empty() || label.find('/') != std::string::npos) {
+                spdlog::warn("[ADB] ignoring invalid entry in DW_ADB_SERVERS: {}", item);
+                continue;
+            }
+            add(std::move(label), std::move(host), std::move(port));
+        }
+    }
+    if (endpoints_.empty()) {
+        std::string host = "127.0.0.1";
+        std::string port = "5037";
+        // Allow overriding ADB server via env
+        if (const char* s = std::getenv("ADB_SERVER_SOCKET")) {
+            std::string v = s;
+            // Expect tcp:HOST:PORT
+            const std::string prefix = "tcp:";
+            if (v.rfind(prefix, 0) == 0) {
+                std::string rest = v.substr(prefix.size());
+                auto pos = rest.rfind(':');
+                if (pos != std::string::npos) {
+                    host = rest.substr(0, pos);
+                    port = rest.substr(pos + 1);
+                }
+            }
+        }
+        if (const char* h = std::getenv("ADB_SERVER_HOST")) host = h;
+        if (const char* h2 = std::getenv("ADB_HOST")) host = h2; // compatibility
+        if (const char* p = std::getenv("ADB_SERVER_PORT")) port = p;
+        add({}, std::move(host), std::move(port));
+    }
+    // A lone server keeps plain serials as uids, as before
+    if (endpoints_.size() > 1) {
+        for (auto& ep : endpoints_) ep->uidPrefix = ep->label + "/";
+    }
+    for (const auto& ep : endpoints_) {
+        spdlog::info("[ADB] using server {}:{}{}", ep->host, ep->port,
+                     ep->uidPrefix.empty() ? "" : fmt::format(" as {}", ep->label));
+    }
+    if (enrichCache_.enabled()) {
+        spdlog::info("[ADB] enrich cache {}: {} device(s)", enrichCache_.path(), enrichCache_.load());
     }
-    if (const char* h = std::getenv("ADB_SERVER_HOST")) host_ = h;
-    if (const char* h2 = std::getenv("ADB_HOST")) host_ = h2; // compatibility
-    if (const char* p = std::getenv("ADB_SERVER_PORT")) port_ = p;
-    spdlog::info("[ADB] using server {}:{}", host_, port_);
 }
 
 AndroidAdbProvider::~AndroidAdbProvider() {
@@ -46,7 +333,21 @@ void AndroidAdbProvider::start() {
         return; // already running
     }
     spdlog::info("[ADB] provider starting");
-    worker_ = std::thread([this]() { runLoop(); });
+    io_.restart();
+    work_.emplace(asio::make_work_guard(io_));
+    asio::post(io_, [this]() {
+        for (auto& ep : endpoints_) connect(*ep);
+    });
+    worker_ = std::thread([this]() {
+        for (;;) {
+            try {
+                io_.run();
+                break;
+            } catch (const std::exception& ex) {
+                spdlog::warn("[ADB] error: {}", asciiMessage(ex.what()));
+            }
+        }
+    });
 }
 
 void AndroidAdbProvider::stop() {
@@ -55,322 +356,473 @@ void AndroidAdbProvider::stop() {
         return; // not running
     }
     spdlog::info("[ADB] provider stopping");
-    // Close current socket to break any blocking reads
-    {
-        std::lock_guard<std::mutex> lk(sockMtx_);
-        if (currentSocket_) {
-            std::error_code ec;
-            currentSocket_->shutdown(tcp::socket::shutdown_both, ec);
-            currentSocket_->close(ec);
-        }
-    }
+    // Cancel everything on the io thread; run() returns once handlers drain.
+    asio::post(io_, [this]() { shutdown(); });
+    work_.reset();
     if (worker_.joinable()) worker_.join();
-    // Join any enrichment threads that are still running (best effort)
-    {
-        std::lock_guard<std::mutex> lk(enrichMtx_);
-        for (auto& t : enrichThreads_) {
-            if (t.joinable()) {
-                try { t.join(); } catch (...) {}
-            }
-        }
-        enrichThreads_.clear();
-        enriching_.clear();
+    // The io thread is gone; flush whatever the delayed save still held
+    cacheSavePending_ = false;
+    enrichCache_.save();
+    for (auto& ep : endpoints_) {
+        ep->known.clear();
+        ep->lineIndex.clear();
+        ep->protoTrack = preferProto_;
+        ep->reconnectAttempt = 0;
+        ep->stale = false;
+        updateStats(*ep, [](EndpointStats& st) {
+            st.connected = false;
+            st.devices = 0;
+        });
+    }
+    enriching_.clear();
+    enrichQueue_ = EnrichScheduler(enrichQueue_.options());
+    publishEnrichGauges();
+}
+
+void AndroidAdbProvider::shutdown() {
+    std::error_code ec;
+    enrichTimer_.cancel();
+    cacheTimer_.cancel();
+    for (auto& ep : endpoints_) {
+        ep->reconnectTimer.cancel();
+        ep->graceTimer.cancel();
+        ep->resolver.cancel();
+        ep->socket.shutdown(tcp::socket::shutdown_both, ec);
+        ep->socket.close(ec);
+    }
+    for (auto& kv : enriching_) {
+        if (auto session = kv.second.lock()) session->cancel();
     }
 }
 
-void AndroidAdbProvider::runLoop() {
-    std::unordered_map<std::string, DeviceInfo> known; // serial -> info
-    while (running_) {
-        try {
-            asio::io_context io;
-            auto sockPtr = std::make_shared<tcp::socket>(io);
-            {
-                std::lock_guard<std::mutex> lk(sockMtx_);
-                currentSocket_ = sockPtr;
+std::vector<AndroidAdbProvider::EndpointStats> AndroidAdbProvider::endpointStats() const {
+    std::lock_guard<std::mutex> lk(statsMtx_);
+    std::vector<EndpointStats> out;
+    out.reserve(endpoints_.size());
+    for (const auto& ep : endpoints_) out.push_back(ep->stats);
+    return out;
+}
+
+void AndroidAdbProvider::connect(Endpoint& ep) {
+    if (!running_) return;
+    spdlog::debug("[ADB] resolving {}:{}", ep.host, ep.port);
+    ep.resolver.async_resolve(ep.host, ep.port, [this, &ep](std::error_code ec, tcp::resolver::results_type results) {
+        if (!running_) return;
+        if (ec) {
+            updateStats(ep, [&](EndpointStats& st) {
+                ++st.connectFailures;
+                st.lastError = asciiMessage(ec.message());
+            });
+            return dropSession(ep, ec);
+        }
+        ep.addrs = std::move(results);
+        asio::async_connect(ep.socket, ep.addrs, [this, &ep](std::error_code ec2, const tcp::endpoint&) {
+            if (!running_) return;
+            if (ec2) {
+                // Connection failure is expected when ADB server is not running.
+                spdlog::warn("[ADB] connect failed to {}:{} ec={} msg={}", ep.host, ep.port, ec2.value(),
+                             asciiMessage(ec2.message()));
+                updateStats(ep, [&](EndpointStats& st) {
+                    ++st.connectFailures;
+                    st.lastError = asciiMessage(ec2.message());
+                });
+                return dropSession(ep, ec2, true);
             }
-            spdlog::debug("[ADB] resolving {}:{}", host_, port_);
-            // Connect
-            tcp::resolver resolver(io);
-            auto endpoints = resolver.resolve(host_, port_);
-            std::error_code ec;
-            asio::connect(*currentSocket_, endpoints, ec);
-            if (ec) {
-                // Connection failure is expected when ADB server is not running; log and detach known devices.
-                std::string msg = ec.message();
-                for (char& ch : msg) {
-                    if (static_cast<unsigned char>(ch) < 32 || static_cast<unsigned char>(ch) > 126) ch = '?';
+            spdlog::info("[ADB] connected to {}:{}", ep.host, ep.port);
+            const char* service = ep.protoTrack ? "host:track-devices-proto-binary" : "host:track-devices-l";
+            asyncRequest(ep.socket, service, [this, &ep, service](std::error_code ec3, const std::string& failMsg) {
+                if (!running_) return;
+                if (ec3 && ep.protoTrack && isFailReply(failMsg)) {
+                    // Older servers only know the text tracker; the FAIL ends this connection.
+                    spdlog::info("[ADB] {} has no track-devices-proto-binary ({}); using track-devices-l",
+                                 ep.label, asciiMessage(failMsg));
+                    ep.protoTrack = false;
+                    std::error_code ignored;
+                    ep.socket.close(ignored);
+                    return connect(ep);
                 }
-                spdlog::warn("[ADB] connect failed to {}:{} ec={} msg={}", host_, port_, ec.value(), msg);
-                if (!known.empty()) {
-                    spdlog::info("[ADB] connection failed; detaching {} known device(s)", known.size());
-                    for (auto& kv : known) {
-                        DeviceInfo info = kv.second;
-                        info.online = false;
-                        DeviceEvent evt{ DeviceEvent::Kind::Detach, info };
-                        manager_.onEvent(evt);
-                    }
-                    known.clear();
+                if (ec3) {
+                    spdlog::warn("[ADB] {} rejected by {}: {}", service, ep.label,
+                                 asciiMessage(failMsg.empty() ? ec3.message() : failMsg));
+                    updateStats(ep, [&](EndpointStats& st) {
+                        ++st.connectFailures;
+                        st.lastError = asciiMessage(failMsg.empty() ? ec3.message() : failMsg);
+                    });
+                    return dropSession(ep, ec3, true);
                 }
-            } else {
-                spdlog::info("[ADB] connected to {}:{}", host_, port_);
-
-                // Send request and process streaming updates
-                sendAdbRequest(*currentSocket_, "host:track-devices-l");
-                spdlog::info("[ADB] sent track-devices-l request and received OKAY");
-
-                // On successful connect, reset known to ensure correct ATTACH notifications
-                known.clear();
-
-                for (;;) {
-                if (!running_) break;
-                std::string block = readLenBlock(*currentSocket_);
-                spdlog::debug("[ADB] received block size={} bytes", block.size());
-                spdlog::debug("[ADB] block preview: {}", block.size() <= 200 ? block : (block.substr(0, 200) + "...") );
-                if (block.empty()) {
-                    // Some ADB builds may send empty heartbeat blocks; ignore.
-                    continue;
-                }
-                // block contains multiple lines separated by '\n'
-                std::unordered_map<std::string, DeviceInfo> fresh;
-
-                std::string line;
-                std::istringstream iss(block);
-                int parsedLines = 0;
-                while (std::getline(iss, line)) {
-                    if (!line.empty() && line.back() == '\r') line.pop_back();
-                    if (line.empty()) continue;
-
-                    // Robust parse: serial, state, extras (separator can be tab or spaces)
-                    std::string serial;
-                    std::string state;
-                    std::string product;
-                    std::string model;
-                    std::string device;
-                    std::string transportId;
-
-                    // Tokenize by whitespace, but preserve the first two tokens (serial, state)
-                    std::istringstream ws(line);
-                    if (!(ws >> serial)) {
-                        spdlog::debug("[ADB] skip line (no serial): {}", line);
-                        continue;
-                    }
-                    if (!(ws >> state)) {
-                        spdlog::debug("[ADB] skip line (no state): {}", line);
-                        continue;
-                    }
-                    // remaining tokens are key:value pairs
-                    std::string tok;
-                    while (ws >> tok) {
-                        if (tok.rfind("product:", 0) == 0) product = tok.substr(8);
-                        else if (tok.rfind("model:", 0) == 0) model = tok.substr(6);
-                        else if (tok.rfind("device:", 0) == 0) device = tok.substr(7);
-                        else if (tok.rfind("transport_id:", 0) == 0) transportId = tok.substr(13);
-                    }
+                spdlog::info("[ADB] sent {} request to {} and received OKAY", service, ep.label);
+                updateStats(ep, [&](EndpointStats& st) {
+                    ++st.connects;
+                    st.connected = true;
+                    st.protoTrack = ep.protoTrack;
+                });
+                ep.reconnectAttempt = 0;
+                // known survives a reconnect; the first block is diffed against it
+                readBlockHeader(ep);
+            });
+        });
+    });
+}
 
-                    DeviceInfo info;
-                    info.type = Type::Android;
-                    info.uid = serial;
-                    info.displayName = model.empty() ? serial : model + " (" + serial + ")";
-                    info.online = (state == "device");
-                    info.model = model;
-                    info.adbState = state;
-                    fresh[serial] = info;
-                    ++parsedLines;
-                    spdlog::debug("[ADB] line parsed: serial={} state={} model={} product={} device={} transport_id={}",
-                                  serial, state, model, product, device, transportId);
-                }
-                    spdlog::info("[ADB] parsed {} device line(s)", parsedLines);
-
-                    // Diff known vs fresh
-                    // Attach: in fresh, not in known
-                    int attachCount = 0, updateCount = 0, detachCount = 0;
-                    for (const auto& kv : fresh) {
-                        const auto& serial = kv.first;
-                        const auto& info = kv.second;
-                        auto it = known.find(serial);
-                        if (it == known.end()) {
-                            DeviceEvent evt{ DeviceEvent::Kind::Attach, info };
-                            manager_.onEvent(evt);
-                            ++attachCount;
-                            spdlog::info("[ADB] ATTACH serial={} model={} state={}", info.uid, info.model, info.adbState);
-                            // Enrich if device is online
-                            if (info.online) {
-                                scheduleEnrichIfNeeded(info, nullptr);
-                            }
-                        } else {
-                            const DeviceInfo& old = it->second;
-                            if (old.adbState != info.adbState || old.model != info.model || old.online != info.online) {
-                                DeviceEvent evt{ DeviceEvent::Kind::InfoUpdated, info };
-                                manager_.onEvent(evt);
-                                ++updateCount;
-                                spdlog::info("[ADB] INFOUPDATED serial={} model={} state={} (prev={})",
-                                             info.uid, info.model, info.adbState, old.adbState);
-                                if (!old.online && info.online) {
-                                    // transition to online
-                                    scheduleEnrichIfNeeded(info, &old);
-                                }
-                            }
-                        }
-                    }
-                    // Detach: in known, not in fresh
-                    for (const auto& kv : known) {
-                        const auto& serial = kv.first;
-                        if (fresh.find(serial) == fresh.end()) {
-                            DeviceInfo info = kv.second;
-                            info.online = false;
-                            DeviceEvent evt{ DeviceEvent::Kind::Detach, info };
-                            manager_.onEvent(evt);
-                            ++detachCount;
-                            spdlog::info("[ADB] DETACH serial={} model={} state={}", info.uid, info.model, info.adbState);
-                        }
-                    }
-                    spdlog::info("[ADB] diff result: attach={} update={} detach={}", attachCount, updateCount, detachCount);
+void AndroidAdbProvider::readBlockHeader(Endpoint& ep) {
+    asio::async_read(ep.socket, asio::buffer(ep.lenBuf), [this, &ep](std::error_code ec, std::size_t) {
+        if (!running_) return;
+        if (ec) return dropSession(ep, ec);
+        std::size_t n = 0;
+        if (!adb::parseHexLen4(std::string_view(ep.lenBuf.data(), ep.lenBuf.size()), n)) {
+            spdlog::warn("[ADB] invalid length header from {}", ep.label);
+            return dropSession(ep, std::make_error_code(std::errc::protocol_error));
+        }
+        if (n == 0) {
+            // "0000" (or an empty Devices message): nothing attached anymore
+            handleBlock(ep, {});
+            return readBlockHeader(ep);
+        }
+        readBlockBody(ep, n);
+    });
+}
 
-                    known.swap(fresh);
-                }
+void AndroidAdbProvider::readBlockBody(Endpoint& ep, std::size_t n) {
+    ep.block.resize(n);
+    asio::async_read(ep.socket, asio::buffer(&ep.block[0], n), [this, &ep](std::error_code ec, std::size_t) {
+        if (!running_) return;
+        if (ec) return dropSession(ep, ec);
+        if (!handleBlock(ep, ep.block)) {
+            spdlog::warn("[ADB] malformed device list block from {} ({} bytes)", ep.label, ep.block.size());
+            return dropSession(ep, std::make_error_code(std::errc::protocol_error), true);
+        }
+        readBlockHeader(ep);
+    });
+}
+
+bool AndroidAdbProvider::handleBlock(Endpoint& ep, std::string_view block) {
+    const auto parsedAt = std::chrono::steady_clock::now();
+    spdlog::debug("[ADB] received block from {} size={} bytes", ep.label, block.size());
+    if (!ep.protoTrack) {
+        spdlog::debug("[ADB] block preview: {}{}", block.substr(0, 200), block.size() <= 200 ? "" : "...");
+    }
+    // Blocks repeat the whole device list on every change, so most records
+    // (text lines or encoded Device messages) are byte-identical to last
+    // time. Those are looked up by hash, confirmed byte for byte (a collision
+    // must not pin one device's record on another) and skipped; only new or
+    // changed records are decoded and diffed.
+    const std::uint64_t gen = ++ep.blockGen;
+    std::size_t seen = 0;
+    int parsedLines = 0, totalLines = 0;
+    int attachCount = 0, updateCount = 0, detachCount = 0;
+    // Whole diff goes to the manager in one batch
+    std::vector<DeviceEvent> batch;
+    enrichPending_.clear();
+    // Drop uid's index entry unless a colliding record has taken it over.
+    auto unindex = [&ep](const std::string& uid, const Known& k) {
+        auto lit = ep.lineIndex.find(k.lineHash);
+        if (lit != ep.lineIndex.end() && lit->second == uid) ep.lineIndex.erase(lit);
+    };
+
+    auto visit = [&](std::string_view record) {
+        ++totalLines;
+        const std::size_t h = std::hash<std::string_view>{}(record);
+        auto lit = ep.lineIndex.find(h);
+        if (lit != ep.lineIndex.end()) {
+            auto kit = ep.known.find(lit->second);
+            if (kit != ep.known.end() && kit->second.line == record) {
+                if (kit->second.gen != gen) ++seen;
+                kit->second.gen = gen;
+                return;
             }
-        } catch (const std::system_error& se) {
-            // System-level error (e.g., read canceled on shutdown, network errors)
-            const int ev = se.code().value();
-            const bool is_abort = (se.code() == asio::error::operation_aborted)
-#ifdef _WIN32
-                                   || (ev == 10004) /* WSAEINTR/WSACancelBlockingCall */
-#endif
-                                   ;
-            if (!running_ || is_abort) {
-                spdlog::debug("[ADB] socket canceled (stopping) ec={}", ev);
-            } else {
-                // Avoid encoding issues by logging code and a short ASCII-only message
-                std::string msg = se.code().message();
-                for (char& ch : msg) {
-                    if (static_cast<unsigned char>(ch) < 32 || static_cast<unsigned char>(ch) > 126) ch = '?';
-                }
-                spdlog::warn("[ADB] error ec={} msg={} ", ev, msg);
-                // If connection dropped unexpectedly, mark all known as detached to keep higher layers consistent
-                if (!known.empty()) {
-                    spdlog::info("[ADB] connection dropped; detaching {} known device(s)", known.size());
-                    for (auto& kv : known) {
-                        DeviceInfo info = kv.second;
-                        info.online = false;
-                        DeviceEvent evt{ DeviceEvent::Kind::Detach, info };
-                        manager_.onEvent(evt);
+        }
+
+        DeviceInfo info;
+        info.type = Type::Android;
+        if (!(ep.protoTrack ? decodeProtoDevice(record, ep.uidPrefix, info)
+                            : decodeTrackLine(record, ep.uidPrefix, info))) {
+            return;
+        }
+        ++parsedLines;
+
+        auto [kit, inserted] = ep.known.try_emplace(info.uid);
+        Known& k = kit->second;
+        if (!inserted) unindex(kit->first, k);
+        ep.lineIndex[h] = kit->first;
+        k.line.assign(record);
+        k.lineHash = h;
+        if (k.gen != gen) ++seen;
+        k.gen = gen;
+
+        if (inserted) {
+            batch.push_back(DeviceEvent{ DeviceEvent::Kind::Attach, info });
+            ++attachCount;
+            spdlog::info("[ADB] ATTACH serial={} model={} state={}", info.uid, info.model, info.adbState);
+            // Enrich if device is online
+            if (info.online) {
+                auto prio = EnrichScheduler::Priority::Attach;
+                if (enrichCache_.enabled()) {
+                    const std::string serial = info.uid.substr(ep.uidPrefix.size());
+                    if (const Props* cached = enrichCache_.find(serial, manager_.clock().wallNow())) {
+                        // Seen before: show the cached build now, revalidate
+                        // once uncached attaches are served
+                        DeviceInfo enriched;
+                        enriched.type = Type::Android;
+                        enriched.uid = info.uid;
+                        enriched.online = true;
+                        enriched.adbState = "device";
+                        applyProps(*cached, enriched);
+                        batch.push_back(DeviceEvent{ DeviceEvent::Kind::InfoUpdated, std::move(enriched) });
+                        prio = EnrichScheduler::Priority::Refresh;
+                        Metrics::global().enrichCacheHits.add();
+                        spdlog::debug("[ADB] enrich cache hit uid={}", info.uid);
+                    } else {
+                        Metrics::global().enrichCacheMisses.add();
                     }
-                    known.clear();
                 }
+                enrichPending_.emplace_back(info.uid, prio);
             }
-        } catch (const std::exception& ex) {
-            // Generic error
-            std::string msg = ex.what();
-            for (char& ch : msg) {
-                if (static_cast<unsigned char>(ch) < 32 || static_cast<unsigned char>(ch) > 126) ch = '?';
+        } else {
+            const DeviceInfo& old = k.info;
+            if (old.adbState != info.adbState || old.model != info.model || old.online != info.online ||
+                old.transport != info.transport || old.usbPath != info.usbPath ||
+                old.usbSpeedMbps != info.usbSpeedMbps) {
+                batch.push_back(DeviceEvent{ DeviceEvent::Kind::InfoUpdated, info });
+                ++updateCount;
+                spdlog::info("[ADB] INFOUPDATED serial={} model={} state={} (prev={})",
+                             info.uid, info.model, info.adbState, old.adbState);
+                if (!old.online && info.online) {
+                    // transition to online
+                    enrichPending_.emplace_back(info.uid, EnrichScheduler::Priority::Refresh);
+                } else if (old.online && !info.online) {
+                    cancelEnrich(info.uid);
+                }
             }
-            spdlog::warn("[ADB] error: {}", msg);
         }
-
-        // Small sleep before reconnect
-        for (int i = 0; i < 10 && running_; ++i) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        k.info = std::move(info);
+    };
+    if (ep.protoTrack) {
+        if (!adb::forEachProtoDevice(block, visit)) return false;
+    } else {
+        adb::forEachLine(block, visit);
+    }
+    spdlog::info("[ADB] parsed {} changed of {} device line(s)", parsedLines, totalLines);
+
+    // Detach: known but absent from this block
+    if (seen != ep.known.size()) {
+        for (auto it = ep.known.begin(); it != ep.known.end();) {
+            if (it->second.gen == gen) {
+                ++it;
+                continue;
+            }
+            DeviceInfo info = std::move(it->second.info);
+            info.online = false;
+            spdlog::info("[ADB] DETACH serial={} model={} state={}", info.uid, info.model, info.adbState);
+            cancelEnrich(it->first);
+            unindex(it->first, it->second);
+            batch.push_back(DeviceEvent{ DeviceEvent::Kind::Detach, std::move(info) });
+            ++detachCount;
+            it = ep.known.erase(it);
         }
     }
+    if (!batch.empty()) {
+        for (auto& e : batch) e.observed = parsedAt;
+        manager_.onEvents(std::move(batch));
+    }
+    // Enrichment results must land after the attach they refine
+    for (const auto& e : enrichPending_) {
+        scheduleEnrichIfNeeded(e.first, e.second);
+    }
+    spdlog::info("[ADB] diff result: attach={} update={} detach={}", attachCount, updateCount, detachCount);
+    const bool reconciled = ep.stale;
+    if (reconciled) {
+        ep.stale = false;
+        ep.graceTimer.cancel();
+        spdlog::info("[ADB] {} reconciled after reconnect; {} device(s) kept", ep.label,
+                     ep.known.size() - static_cast<std::size_t>(attachCount));
+    }
+    updateStats(ep, [&](EndpointStats& st) {
+        ++st.blocks;
+        st.devices = ep.known.size();
+        if (reconciled) ++st.reconciled;
+    });
+    return true;
 }
 
-void AndroidAdbProvider::sendAdbRequest(asio::ip::tcp::socket& socket, const std::string& payload) {
-    // Send 4-hex length + payload
-    const std::string len = fmt::format("{:04x}", (unsigned)payload.size());
-    std::array<asio::const_buffer, 2> bufs = {asio::buffer(len), asio::buffer(payload)};
-    asio::write(socket, bufs);
+bool AndroidAdbProvider::decodeTrackLine(std::string_view line, const std::string& uidPrefix, DeviceInfo& info) {
+    // Robust parse: serial, state, extras (separator can be tab or spaces)
+    adb::TrackLine t;
+    if (!adb::parseTrackLine(line, t)) {
+        spdlog::debug("[ADB] skip line (no serial/state): {}", line);
+        return false;
+    }
+    spdlog::debug("[ADB] line parsed: serial={} state={} model={} product={} device={} transport_id={}",
+                  t.serial, t.state, t.model, t.product, t.device, t.transportId);
+    info.uid = uidPrefix;
+    info.uid.append(t.serial);
+    info.model.assign(t.model);
+    info.displayName = t.model.empty() ? info.uid : info.model + " (" + info.uid + ")";
+    info.online = (t.state == "device");
+    info.adbState.assign(t.state);
+    info.usbPath.assign(t.usb);
+    return true;
+}
 
-    // Response: 4 bytes OKAY/FAIL
-    std::string resp = readExact(socket, 4);
-    if (resp == "OKAY") {
-        return;
-    } else if (resp == "FAIL") {
-        std::string l4 = readExact(socket, 4);
-        std::size_t n = parseHexLen4(l4);
-        std::string msg = readExact(socket, n);
-        throw std::runtime_error("ADB FAIL: " + msg);
-    } else {
-        throw std::runtime_error("ADB invalid response: " + resp);
+bool AndroidAdbProvider::decodeProtoDevice(std::string_view msg, const std::string& uidPrefix, DeviceInfo& info) {
+    adb::ProtoDevice d;
+    if (!adb::parseProtoDevice(msg, d)) {
+        spdlog::debug("[ADB] skip device message without serial ({} bytes)", msg.size());
+        return false;
     }
+    const std::string_view state = adb::connectionStateName(d.state);
+    spdlog::debug("[ADB] device decoded: serial={} state={} model={} product={} device={} transport_id={} "
+                  "usb={} speed={}/{}Mbps",
+                  d.serial, state, d.model, d.product, d.device, d.transportId, d.busAddress,
+                  d.negotiatedSpeed, d.maxSpeed);
+    info.uid = uidPrefix;
+    info.uid.append(d.serial);
+    info.model.assign(d.model);
+    info.displayName = d.model.empty() ? info.uid : info.model + " (" + info.uid + ")";
+    info.online = (d.state == static_cast<int>(adb::ConnectionState::Device));
+    info.adbState.assign(state);
+    info.usbPath.assign(d.busAddress);
+    switch (d.connectionType) {
+        case adb::ConnectionType::Usb: info.transport = "USB"; break;
+        case adb::ConnectionType::Socket: info.transport = "TCP"; break;
+        default: break;
+    }
+    if (d.negotiatedSpeed > 0) info.usbSpeedMbps = static_cast<std::uint32_t>(d.negotiatedSpeed);
+    return true;
 }
 
-std::string AndroidAdbProvider::readExact(asio::ip::tcp::socket& socket, std::size_t n) {
-    std::string out;
-    out.resize(n);
-    asio::read(socket, asio::buffer(out.data(), n));
-    return out;
+void AndroidAdbProvider::dropSession(Endpoint& ep, const std::error_code& ec, bool logged) {
+    std::error_code ignored;
+    ep.socket.close(ignored);
+    // Whatever answers next may be a different server version.
+    ep.protoTrack = preferProto_;
+    if (!logged) {
+        // Avoid encoding issues by logging code and a short ASCII-only message
+        spdlog::warn("[ADB] {} error ec={} msg={} ", ep.label, ec.value(), asciiMessage(ec.message()));
+    }
+    updateStats(ep, [&](EndpointStats& st) {
+        if (st.connected) ++st.drops;
+        st.connected = false;
+        st.lastError = asciiMessage(ec.message());
+    });
+    // Keep what the server last reported: a reconnect within the grace
+    // window diffs the first fresh block against it, so a blip only
+    // produces events for devices that really changed meanwhile.
+    if (!ep.known.empty() && !ep.stale) {
+        ep.stale = true;
+        if (graceWindow_.count() == 0) {
+            expireGrace(ep);
+        } else {
+            spdlog::info("[ADB] connection to {} dropped; holding {} device(s) for {}ms", ep.label,
+                         ep.known.size(), graceWindow_.count());
+            ep.graceTimer.expires_after(graceWindow_);
+            ep.graceTimer.async_wait([this, &ep](std::error_code ec2) {
+                if (ec2 || !running_) return;
+                expireGrace(ep);
+            });
+        }
+    }
+    scheduleReconnect(ep);
 }
 
-std::size_t AndroidAdbProvider::parseHexLen4(const std::string& s) {
-    if (s.size() != 4) throw std::runtime_error("invalid length header size");
-    unsigned int v = 0;
-    std::stringstream ss;
-    ss << std::hex << s;
-    ss >> v;
-    return static_cast<std::size_t>(v);
+void AndroidAdbProvider::expireGrace(Endpoint& ep) {
+    if (!ep.stale) return;
+    ep.stale = false;
+    spdlog::info("[ADB] no device list from {} within grace window; detaching {} known device(s)", ep.label,
+                 ep.known.size());
+    std::vector<DeviceEvent> batch;
+    batch.reserve(ep.known.size());
+    for (auto& kv : ep.known) {
+        DeviceInfo info = kv.second.info;
+        info.online = false;
+        cancelEnrich(kv.first);
+        batch.push_back(DeviceEvent{ DeviceEvent::Kind::Detach, std::move(info) });
+    }
+    if (!batch.empty()) manager_.onEvents(std::move(batch));
+    ep.known.clear();
+    ep.lineIndex.clear();
+    updateStats(ep, [](EndpointStats& st) {
+        ++st.graceExpired;
+        st.devices = 0;
+    });
 }
 
-std::string AndroidAdbProvider::readLenBlock(asio::ip::tcp::socket& socket) {
-    std::string l4 = readExact(socket, 4);
-    std::size_t n = parseHexLen4(l4);
-    if (n == 0) return std::string();
-    return readExact(socket, n);
+void AndroidAdbProvider::scheduleReconnect(Endpoint& ep) {
+    if (!running_) return;
+    auto delay = kReconnectBase;
+    for (int i = 0; i < ep.reconnectAttempt && delay < kReconnectMax; ++i) delay *= 2;
+    delay = std::min(delay, kReconnectMax);
+    std::uniform_int_distribution<long long> jitter(delay.count() / 2, delay.count());
+    delay = std::chrono::milliseconds(jitter(rng_));
+    ++ep.reconnectAttempt;
+    spdlog::debug("[ADB] reconnecting to {} in {}ms (attempt {})", ep.label, delay.count(), ep.reconnectAttempt);
+    ep.reconnectTimer.expires_after(delay);
+    ep.reconnectTimer.async_wait([this, &ep](std::error_code ec) {
+        if (ec || !running_) return;
+        connect(ep);
+    });
 }
 
-std::string AndroidAdbProvider::readUntilEof(asio::ip::tcp::socket& socket, std::size_t maxBytes) {
-    std::string out;
-    out.reserve(8192);
-    std::array<char, 4096> buf{};
-    std::error_code ec;
-    while (out.size() < maxBytes) {
-        size_t n = socket.read_some(asio::buffer(buf.data(), buf.size()), ec);
-        if (ec) {
-            if (ec == asio::error::eof) break;
-            // On Windows when peer closes, may also get connection_reset; treat as EOF
-            if (
-#ifdef _WIN32
-                ec.value() == 10054 || // WSAECONNRESET
-#endif
-                false) {
+void AndroidAdbProvider::asyncRequest(tcp::socket& socket, const std::string& payload, Done done) {
+    struct State {
+        std::string out;
+        std::array<char, 4> status{};
+        std::array<char, 4> len{};
+        std::string msg;
+    };
+    auto st = std::make_shared<State>();
+    // Send 4-hex length + payload
+    st->out = fmt::format("{:04x}", (unsigned)payload.size()) + payload;
+    asio::async_write(socket, asio::buffer(st->out), [&socket, st, done](std::error_code ec, std::size_t) {
+        if (ec) return done(ec, {});
+        // Response: 4 bytes OKAY/FAIL
+        asio::async_read(socket, asio::buffer(st->status), [&socket, st, done](std::error_code ec2, std::size_t) {
+            if (ec2) return done(ec2, {});
+            const std::string status(st->status.data(), st->status.size());
+            if (status == "OKAY") return done({}, {});
+            if (status != "FAIL") {
+                return done(std::make_error_code(std::errc::protocol_error), "ADB invalid response: " + status);
+            }
+            asio::async_read(socket, asio::buffer(st->len), [&socket, st, done](std::error_code ec3, std::size_t) {
+                std::size_t n = 0;
+                if (ec3 || !adb::parseHexLen4(std::string_view(st->len.data(), st->len.size()), n)) {
+                    return done(ec3 ? ec3 : std::make_error_code(std::errc::protocol_error), "ADB FAIL");
+                }
+                st->msg.resize(n);
+                asio::async_read(socket, asio::buffer(&st->msg[0], n), [st, done](std::error_code ec4, std::size_t) {
+                    done(ec4 ? ec4 : std::make_error_code(std::errc::protocol_error), "ADB FAIL: " + st->msg);
+                });
+            });
+        });
+    });
+}
+
+AndroidAdbProvider::Props AndroidAdbProvider::parseGetprop(std::string_view text,
+                                                          const std::vector<std::string>& wanted) {
+    Props props;
+    // Lines: [key]: [value]; only wanted keys are copied out
+    adb::forEachLine(text, [&](std::string_view line) {
+        std::string_view key;
+        std::string_view value;
+        if (!adb::parseGetpropLine(line, key, value)) return;
+        for (const auto& w : wanted) {
+            if (w == key) {
+                props[w].assign(value);
                 break;
             }
-            throw std::system_error(ec);
         }
-        out.append(buf.data(), n);
-    }
-    return out;
+    });
+    return props;
 }
 
-void AndroidAdbProvider::parseGetprop(const std::string& text, DeviceInfo& infoOut) {
-    // Lines: [key]: [value]
-    std::istringstream iss(text);
-    std::string line;
-    auto trim = [](std::string s) {
-        size_t i=0,j=s.size();
-        while (i<j && (unsigned char)s[i]<=32) ++i;
-        while (j>i && (unsigned char)s[j-1]<=32) --j;
-        return s.substr(i, j-i);
+void AndroidAdbProvider::applyProps(const Props& props, DeviceInfo& infoOut) {
+    auto get = [&props](const char* key) {
+        auto it = props.find(key);
+        return it == props.end() ? std::string() : it->second;
     };
-    while (std::getline(iss, line)) {
-        if (!line.empty() && line.back()=='\r') line.pop_back();
-        if (line.empty()) continue;
-        // fast parse
-        if (line.front()=='[') {
-            auto rb1 = line.find(']');
-            auto lb2 = line.find('[', rb1 != std::string::npos ? rb1 : 0);
-            auto rb2 = line.find(']', lb2 != std::string::npos ? lb2 : 0);
-            if (rb1!=std::string::npos && lb2!=std::string::npos && rb2!=std::string::npos) {
-                std::string key = line.substr(1, rb1-1);
-                std::string val = line.substr(lb2+1, rb2-lb2-1);
-                key = trim(key);
-                val = trim(val);
-                if (key == "ro.product.manufacturer") infoOut.manufacturer = val;
-                else if (key == "ro.product.model") infoOut.model = val;
-                else if (key == "ro.build.version.release") infoOut.osVersion = val;
-                else if (key == "ro.product.cpu.abi") infoOut.abi = val;
-            }
-        }
-    }
+    infoOut.manufacturer = get("ro.product.manufacturer");
+    infoOut.model = get("ro.product.model");
+    infoOut.osVersion = get("ro.build.version.release");
+    infoOut.abi = get("ro.product.cpu.abi");
     // displayName enhancement
     if (!infoOut.model.empty()) {
         infoOut.displayName = infoOut.manufacturer.empty() ? infoOut.model : (infoOut.manufacturer + " " + infoOut.model);
@@ -378,68 +830,91 @@ void AndroidAdbProvider::parseGetprop(const std::string& text, DeviceInfo& infoO
     }
 }
 
-void AndroidAdbProvider::scheduleEnrichIfNeeded(const DeviceInfo& newInfo, const DeviceInfo* oldInfo) {
+void AndroidAdbProvider::scheduleEnrichIfNeeded(const std::string& uid, EnrichScheduler::Priority prio) {
     if (!running_) return;
-    const auto now = std::chrono::steady_clock::now();
-    const std::chrono::seconds throttle(30);
-    {
-        std::lock_guard<std::mutex> lk(enrichMtx_);
-        auto itlast = lastEnrich_.find(newInfo.uid);
-        if (itlast != lastEnrich_.end() && now - itlast->second < throttle) {
-            spdlog::debug("[ADB] enrich skip (throttle) serial={}", newInfo.uid);
-            return;
-        }
-        if (enriching_.count(newInfo.uid)) {
-            spdlog::debug("[ADB] enrich skip (in-progress) serial={}", newInfo.uid);
-            return;
+    if (!enrichQueue_.request(uid, prio, manager_.clock().now())) {
+        spdlog::debug("[ADB] enrich skip (throttle or in-progress) uid={}", uid);
+        return;
+    }
+    spdlog::info("[ADB] enrich scheduling for uid={} (device)", uid);
+    pumpEnrich();
+}
+
+void AndroidAdbProvider::pumpEnrich() {
+    const auto now = manager_.clock().now();
+    while (auto uid = enrichQueue_.next(now)) {
+        Endpoint* ep = ownerOf(*uid);
+        if (!ep) {
+            // Its server went away while the request waited
+            enrichQueue_.cancel(*uid);
+            enrichQueue_.finished(*uid, false, now);
+            continue;
         }
-        enriching_.insert(newInfo.uid);
+        auto session = std::make_shared<EnrichSession>(*this, *ep, *uid);
+        enriching_[*uid] = session;
+        session->start();
     }
+    publishEnrichGauges();
 
-    spdlog::info("[ADB] enrich scheduling for serial={} (device)", newInfo.uid);
-    enrichThreads_.emplace_back([this, serial = newInfo.uid]() { enrichWorker(serial); });
+    if (const auto due = enrichQueue_.nextDue()) {
+        enrichTimer_.expiresAt(*due);
+    } else {
+        enrichTimer_.cancel();
+    }
 }
 
-void AndroidAdbProvider::enrichWorker(std::string serial) {
-    // Short-lived connection to run host:transport:<serial> then shell:getprop
-    try {
-        asio::io_context io;
-        tcp::resolver resolver(io);
-        auto endpoints = resolver.resolve(host_, port_);
-        tcp::socket sock(io);
-        asio::connect(sock, endpoints);
-        spdlog::debug("[ADB] enrich connected for serial={}", serial);
+void AndroidAdbProvider::finishEnrich(const std::string& uid, bool ok) {
+    enriching_.erase(uid);
+    if (!running_) return;
+    if (const auto retryIn = enrichQueue_.finished(uid, ok, manager_.clock().now())) {
+        spdlog::info("[ADB] enrich retry uid={} in {}ms", uid, retryIn->count());
+    }
+    pumpEnrich();
+}
 
-        // Select transport
-        sendAdbRequest(sock, fmt::format("host:transport:{}", serial));
-        // Run shell:getprop
-        sendAdbRequest(sock, "shell:getprop");
-        std::string out = readUntilEof(sock);
-        spdlog::debug("[ADB] enrich getprop bytes={} for serial={}", out.size(), serial);
+void AndroidAdbProvider::cancelEnrich(const std::string& uid) {
+    enrichQueue_.cancel(uid);
+    auto it = enriching_.find(uid);
+    if (it != enriching_.end()) {
+        spdlog::debug("[ADB] enrich cancelled uid={}", uid);
+        if (auto session = it->second.lock()) session->cancel();
+    }
+    publishEnrichGauges();
+}
 
-        DeviceInfo info;
-        info.type = Type::Android;
-        info.uid = serial;
-        info.online = true;
-        info.adbState = "device";
-        parseGetprop(out, info);
+void AndroidAdbProvider::publishEnrichGauges() const {
+    auto& m = Metrics::global();
+    m.enrichInFlight.set(static_cast<std::int64_t>(enrichQueue_.inFlight()));
+    m.enrichQueued.set(static_cast<std::int64_t>(enrichQueue_.queued()));
+}
 
-        DeviceEvent evt{ DeviceEvent::Kind::InfoUpdated, info };
-        manager_.onEvent(evt);
-        spdlog::info("[ADB] enrich result serial={} manufacturer={} model={} os={} abi={}",
-                     serial, info.manufacturer, info.model, info.osVersion, info.abi);
-    } catch (const std::exception& ex) {
-        std::string msg = ex.what();
-        for (char& ch : msg) {
-            if (static_cast<unsigned char>(ch) < 32 || static_cast<unsigned char>(ch) > 126) ch = '?';
-        }
-        spdlog::warn("[ADB] enrich failed serial={} msg={}", serial, msg);
+AndroidAdbProvider::Endpoint* AndroidAdbProvider::ownerOf(const std::string& uid) {
+    for (auto& ep : endpoints_) {
+        if (ep->known.count(uid)) return ep.get();
     }
+    return nullptr;
+}
 
-    // mark done
-    {
-        std::lock_guard<std::mutex> lk(enrichMtx_);
-        enriching_.erase(serial);
-        lastEnrich_[serial] = std::chrono::steady_clock::now();
+void AndroidAdbProvider::cacheEnrichResult(const std::string& serial, const Props& props) {
+    if (!enrichCache_.enabled()) return;
+    const std::string before = enrichCache_.fingerprint(serial);
+    if (!enrichCache_.store(serial, props, manager_.clock().wallNow())) {
+        spdlog::debug("[ADB] enrich cache skip serial={} (no fingerprint)", serial);
+        return;
+    }
+    if (!before.empty() && before != props.at(EnrichCache::kFingerprintKey)) {
+        spdlog::info("[ADB] enrich cache serial={} has a new build; entry replaced", serial);
     }
+    saveCacheSoon();
+}
+
+void AndroidAdbProvider::saveCacheSoon() {
+    if (!enrichCache_.dirty() || cacheSavePending_) return;
+    cacheSavePending_ = true;
+    cacheTimer_.expires_after(kCacheSaveDelay);
+    cacheTimer_.async_wait([this](std::error_code ec) {
+        cacheSavePending_ = false;
+        if (ec) return;
+        enrichCache_.save();
+    });
 }
@@ -1,19 +1,54 @@
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <random>
 #include <string>
+#include <string_view>
+#include <system_error>
 #include <thread>
 #include <unordered_map>
-#include <unordered_set>
 #include <chrono>
 #include <vector>
 
 #include <asio.hpp>
 
+#include "core/Clock.h"
 #include "core/DeviceManager.h"
+#include "providers/EnrichCache.h"
+#include "providers/EnrichScheduler.h"
 
+// Watches one or more ADB servers over the smart-socket protocol. Everything
+// runs as async operations on one io_context thread: each server's device
+// tracking stream and reconnects, and the short getprop sessions used for
+// enrichment, however many devices are attached. All members below the
+// endpoint list are only touched on that thread.
+//
+// Servers come from DW_ADB_SERVERS ("[label=]host:port,..."), else from the
+// usual ADB_SERVER_SOCKET / ADB_SERVER_HOST / ADB_SERVER_PORT. With more than
+// one server, device uids are namespaced as "<label>/<serial>" so the same
+// serial on two servers stays two devices.
 class AndroidAdbProvider {
 public:
+    struct EndpointStats {
+        std::string label;
+        bool connected{false};
+        bool protoTrack{false};          // binary tracker in use
+        std::size_t devices{0};
+        std::uint64_t connects{0};       // track sessions established
+        std::uint64_t connectFailures{0};
+        std::uint64_t drops{0};          // established sessions lost
+        std::uint64_t blocks{0};         // device list blocks received
+        std::uint64_t reconciled{0};     // reconnects diffed against the last list
+        std::uint64_t graceExpired{0};   // outages that outlasted the grace window
+        std::string lastError;
+    };
+
     explicit AndroidAdbProvider(DeviceManager& manager);
     ~AndroidAdbProvider();
 
@@ -26,33 +61,121 @@ public:
 
     std::string name() const { return "AndroidAdbProvider"; }
 
+    // Per-server state; safe to call from any thread.
+    std::vector<EndpointStats> endpointStats() const;
+
 private:
-    void runLoop();
-    void trackDevices(asio::ip::tcp::socket& socket);
+    class EnrichSession;
+    using Done = std::function<void(std::error_code ec, const std::string& failMsg)>;
+    using Props = std::unordered_map<std::string, std::string>;
+
+    struct Known {
+        DeviceInfo info;            // last reported
+        std::string line;           // the record it came from, compared on a hash hit
+        std::size_t lineHash{0};    // its hash, the lineIndex key
+        std::uint64_t gen{0};       // last block that listed it
+    };
+
+    // One ADB server and its tracking session.
+    struct Endpoint {
+        explicit Endpoint(asio::io_context& io) : resolver(io), socket(io), reconnectTimer(io), graceTimer(io) {}
+
+        std::string label;
+        std::string host;
+        std::string port;
+        std::string uidPrefix;       // "" with a single server, else label + "/"
+        // host:track-devices-proto-binary unless DW_ADB_TRACK=text; a server
+        // that rejects it gets track-devices-l until the session drops or a
+        // connect fails (dropSession), then proto is tried again.
+        bool protoTrack{true};
+
+        asio::ip::tcp::resolver resolver;
+        asio::ip::tcp::resolver::results_type addrs;
+        asio::ip::tcp::socket socket;
+        asio::steady_timer reconnectTimer;
+        asio::steady_timer graceTimer;
+        int reconnectAttempt{0};     // since the last successful session
+        // known is from a lost session, waiting for the first fresh block
+        bool stale{false};
+        std::array<char, 4> lenBuf{};
+        std::string block;
+        // Kept across blocks; only changed records touch them.
+        std::unordered_map<std::string, Known> known;        // uid -> state
+        std::unordered_map<std::size_t, std::string> lineIndex; // record hash -> uid (last writer on collision)
+        std::uint64_t blockGen{0};
+
+        EndpointStats stats;         // guarded by statsMtx_
+    };
 
-    static void sendAdbRequest(asio::ip::tcp::socket& socket, const std::string& payload);
-    static std::string readExact(asio::ip::tcp::socket& socket, std::size_t n);
-    static std::string readLenBlock(asio::ip::tcp::socket& socket);
-    static std::size_t parseHexLen4(const std::string& s);
-    static std::string readUntilEof(asio::ip::tcp::socket& socket, std::size_t maxBytes = 262144);
-    static void parseGetprop(const std::string& text, DeviceInfo& infoOut);
+    // Track session: resolve -> connect -> track-devices request -> blocks
+    void connect(Endpoint& ep);
+    void readBlockHeader(Endpoint& ep);
+    void readBlockBody(Endpoint& ep, std::size_t n);
+    // False if the block cannot be decoded.
+    bool handleBlock(Endpoint& ep, std::string_view block);
+    // One text line / one encoded Device message into info. False to skip it.
+    static bool decodeTrackLine(std::string_view line, const std::string& uidPrefix, DeviceInfo& info);
+    static bool decodeProtoDevice(std::string_view msg, const std::string& uidPrefix, DeviceInfo& info);
+    // Session ended: keep what it reported for the grace window and retry
+    // with backoff. logged: the caller already warned about ec.
+    void dropSession(Endpoint& ep, const std::error_code& ec, bool logged = false);
+    void scheduleReconnect(Endpoint& ep);
+    // No fresh block within the grace window: detach what ep still holds.
+    void expireGrace(Endpoint& ep);
+    // Cancels every pending operation so io_.run() can return.
+    void shutdown();
+    template <typename F>
+    void updateStats(Endpoint& ep, F&& fn) {
+        std::lock_guard<std::mutex> lk(statsMtx_);
+        fn(ep.stats);
+    }
 
-    void scheduleEnrichIfNeeded(const DeviceInfo& newInfo, const DeviceInfo* oldInfo);
-    void enrichWorker(std::string serial);
+    // Writes a length-prefixed request and reads OKAY, or FAIL + message.
+    static void asyncRequest(asio::ip::tcp::socket& socket, const std::string& payload, Done done);
+    // Parses getprop "[key]: [value]" lines, keeping only wanted keys.
+    static Props parseGetprop(std::string_view text, const std::vector<std::string>& wanted);
+    static void applyProps(const Props& props, DeviceInfo& infoOut);
+
+    // Attach: first sighting, nothing to show yet. Refresh: back online, or
+    // shown from the cache; the old properties still stand.
+    void scheduleEnrichIfNeeded(const std::string& uid, EnrichScheduler::Priority prio);
+    // Start queued enrichments while slots are free; re-arm the retry timer.
+    void pumpEnrich();
+    void finishEnrich(const std::string& uid, bool ok);
+    // Device went away: drop its queued or running enrichment.
+    void cancelEnrich(const std::string& uid);
+    void publishEnrichGauges() const;
+    // Remember a successful getprop; written to disk shortly after.
+    void cacheEnrichResult(const std::string& serial, const Props& props);
+    void saveCacheSoon();
+    // Server currently reporting uid, or nullptr.
+    Endpoint* ownerOf(const std::string& uid);
 
     DeviceManager& manager_;
-    std::thread worker_;
     std::atomic<bool> running_{false};
-    std::mutex sockMtx_;
-    std::shared_ptr<asio::ip::tcp::socket> currentSocket_;
-
-    // ADB server endpoint (configurable via env)
-    std::string host_ = "127.0.0.1";
-    std::string port_ = "5037";
-
-    // Enrichment bookkeeping
-    std::mutex enrichMtx_;
-    std::unordered_set<std::string> enriching_;
-    std::unordered_map<std::string, std::chrono::steady_clock::time_point> lastEnrich_;
-    std::vector<std::thread> enrichThreads_;
+
+    asio::io_context io_;
+    std::optional<asio::executor_work_guard<asio::io_context::executor_type>> work_;
+    std::thread worker_;
+
+    // ADB servers (configurable via env); fixed after construction
+    std::vector<std::unique_ptr<Endpoint>> endpoints_;
+    bool preferProto_{true};
+    std::chrono::milliseconds graceWindow_;
+    std::minstd_rand rng_;            // reconnect jitter
+    mutable std::mutex statsMtx_;
+
+    std::vector<std::pair<std::string, EnrichScheduler::Priority>> enrichPending_;
+
+    // Enrichment bookkeeping. Throttle, retry backoff and cache ageing run on
+    // manager_.clock(); enrichTimer_ waits for due retries on that clock and
+    // posts pumpEnrich() back to io_. Socket timeouts stay on real time.
+    EnrichScheduler enrichQueue_;
+    ClockTimer enrichTimer_;
+    std::unordered_map<std::string, std::weak_ptr<EnrichSession>> enriching_; // uid -> session
+    std::vector<std::string> enrichProps_; // getprop keys to fetch
+    std::string targetedCmd_;
+    EnrichCache enrichCache_;               // DW_ADB_CACHE; keyed by bare serial
+    asio::steady_timer cacheTimer_;
+    bool cacheSavePending_{false};
 };
@@ -0,0 +1,171 @@
+#include "providers/EnrichCache.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <system_error>
+#include <vector>
+
+#include <spdlog/spdlog.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+constexpr char kMagic[8] = {'D', 'W', 'E', 'C', 'A', 'C', '0', '1'};
+// Sanity bound while reading; real entries are a few hundred bytes.
+constexpr std::uint64_t kMaxString = 1u << 16;
+
+void putVarint(std::string& out, std::uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+void putStr(std::string& out, const std::string& s) {
+    putVarint(out, s.size());
+    out.append(s);
+}
+
+struct Reader {
+    const char* p;
+    const char* end;
+    bool ok{true};
+
+    std::uint64_t varint() {
+        std::uint64_t v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            if (p >= end) break;
+            const auto b = static_cast<std::uint8_t>(*p++);
+            v |= static_cast<std::uint64_t>(b & 0x7F) << shift;
+            if (!(b & 0x80)) return v;
+        }
+        ok = false;
+        return 0;
+    }
+    std::string str() {
+        const std::uint64_t n = varint();
+        if (!ok || n > kMaxString || static_cast<std::uint64_t>(end - p) < n) {
+            ok = false;
+            return {};
+        }
+        std::string s(p, static_cast<std::size_t>(n));
+        p += n;
+        return s;
+    }
+};
+
+std::int64_t toSeconds(std::chrono::system_clock::time_point tp) {
+    return std::chrono::duration_cast<std::chrono::seconds>(tp.time_since_epoch()).count();
+}
+} // namespace
+
+EnrichCache::EnrichCache(Options opts) : opts_(std::move(opts)) {}
+
+std::size_t EnrichCache::load() {
+    entries_.clear();
+    dirty_ = false;
+    if (!enabled()) return 0;
+    std::ifstream in(opts_.path, std::ios::binary);
+    if (!in) return 0;
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (data.size() < sizeof(kMagic) || !std::equal(std::begin(kMagic), std::end(kMagic), data.begin())) {
+        spdlog::warn("[ADB] enrich cache {} has an unknown format; starting empty", opts_.path);
+        return 0;
+    }
+    Reader r{data.data() + sizeof(kMagic), data.data() + data.size()};
+    const std::uint64_t count = r.varint();
+    for (std::uint64_t i = 0; r.ok && i < count; ++i) {
+        std::string serial = r.str();
+        Entry e;
+        e.fingerprint = r.str();
+        e.lastUsed = static_cast<std::int64_t>(r.varint());
+        const std::uint64_t n = r.varint();
+        for (std::uint64_t k = 0; r.ok && k < n; ++k) {
+            std::string key = r.str();
+            std::string value = r.str();
+            if (r.ok) e.props.emplace(std::move(key), std::move(value));
+        }
+        if (!r.ok) {
+            spdlog::warn("[ADB] enrich cache {} is damaged after {} entries", opts_.path, entries_.size());
+            break;
+        }
+        entries_[std::move(serial)] = std::move(e);
+    }
+    evict();
+    return entries_.size();
+}
+
+bool EnrichCache::save() {
+    if (!enabled() || !dirty_) return true;
+    std::string out(kMagic, sizeof(kMagic));
+    putVarint(out, entries_.size());
+    for (const auto& kv : entries_) {
+        putStr(out, kv.first);
+        putStr(out, kv.second.fingerprint);
+        putVarint(out, static_cast<std::uint64_t>(std::max<std::int64_t>(0, kv.second.lastUsed)));
+        putVarint(out, kv.second.props.size());
+        for (const auto& p : kv.second.props) {
+            putStr(out, p.first);
+            putStr(out, p.second);
+        }
+    }
+
+    const std::string tmp = opts_.path + ".tmp";
+    {
+        std::ofstream f(tmp, std::ios::binary | std::ios::trunc);
+        if (!f.write(out.data(), static_cast<std::streamsize>(out.size()))) {
+            spdlog::warn("[ADB] cannot write enrich cache {}", tmp);
+            return false;
+        }
+    }
+    std::error_code ec;
+    fs::rename(tmp, opts_.path, ec);
+    if (ec) {
+        spdlog::warn("[ADB] cannot replace enrich cache {}: {}", opts_.path, ec.message());
+        return false;
+    }
+    dirty_ = false;
+    return true;
+}
+
+const EnrichCache::Props* EnrichCache::find(const std::string& serial, std::chrono::system_clock::time_point now) {
+    auto it = entries_.find(serial);
+    if (it == entries_.end()) return nullptr;
+    // Persisted with the next real change; not worth a write of its own
+    it->second.lastUsed = toSeconds(now);
+    return &it->second.props;
+}
+
+std::string EnrichCache::fingerprint(const std::string& serial) const {
+    auto it = entries_.find(serial);
+    return it == entries_.end() ? std::string() : it->second.fingerprint;
+}
+
+bool EnrichCache::store(const std::string& serial, const Props& props, std::chrono::system_clock::time_point now) {
+    if (!enabled()) return false;
+    auto fp = props.find(kFingerprintKey);
+    if (fp == props.end() || fp->second.empty()) return false;
+    Entry& e = entries_[serial];
+    e.lastUsed = toSeconds(now);
+    if (e.fingerprint != fp->second || e.props != props) {
+        e.fingerprint = fp->second;
+        e.props = props;
+        dirty_ = true;
+    }
+    evict();
+    return true;
+}
+
+void EnrichCache::evict() {
+    if (entries_.size() <= opts_.maxEntries) return;
+    std::vector<std::pair<std::int64_t, std::string>> byAge;
+    byAge.reserve(entries_.size());
+    for (const auto& kv : entries_) byAge.emplace_back(kv.second.lastUsed, kv.first);
+    const std::size_t drop = entries_.size() - opts_.maxEntries;
+    std::nth_element(byAge.begin(), byAge.begin() + static_cast<std::ptrdiff_t>(drop), byAge.end());
+    for (std::size_t i = 0; i < drop; ++i) entries_.erase(byAge[i].second);
+    dirty_ = true;
+}
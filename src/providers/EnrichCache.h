@@ -0,0 +1,66 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+// getprop results kept across restarts, so a device seen before shows its
+// properties as soon as it attaches and is only revalidated later.
+//
+// One entry per serial, valid for one ro.build.fingerprint: an OS update, or
+// another device reusing the serial, replaces it on the next enrichment.
+// Beyond maxEntries the least recently used entries are dropped.
+//
+// File: 8-byte magic, varint count, then per entry
+//   str serial | str fingerprint | varint lastUsed (unix s) | varint n | n x (str key | str value)
+// with strings varint-length prefixed. save() rewrites the whole file via a
+// temp file and rename, so a crash leaves the previous version. Not
+// synchronized; the ADB provider uses it from its io thread only.
+class EnrichCache {
+public:
+    using Props = std::unordered_map<std::string, std::string>;
+
+    struct Options {
+        std::string path;           // empty: disabled
+        std::size_t maxEntries{4096};
+    };
+
+    explicit EnrichCache(Options opts);
+
+    bool enabled() const { return !opts_.path.empty(); }
+    const std::string& path() const { return opts_.path; }
+
+    // Reads the file, replacing what is in memory. A missing file is an empty
+    // cache; a damaged one is ignored from the first bad entry on.
+    std::size_t load();
+    // Writes the cache if store() changed it since the last save. False on I/O failure.
+    bool save();
+
+    // Cached properties of serial, or nullptr. Marks the entry used.
+    const Props* find(const std::string& serial, std::chrono::system_clock::time_point now);
+    // Fingerprint of the cached entry; empty if none.
+    std::string fingerprint(const std::string& serial) const;
+    // Records fresh getprop results. Needs ro.build.fingerprint among props;
+    // returns false (and stores nothing) without it.
+    bool store(const std::string& serial, const Props& props, std::chrono::system_clock::time_point now);
+
+    bool dirty() const { return dirty_; }
+    std::size_t size() const { return entries_.size(); }
+
+    static constexpr const char* kFingerprintKey = "ro.build.fingerprint";
+
+private:
+    struct Entry {
+        std::string fingerprint;
+        std::int64_t lastUsed{0};
+        Props props;
+    };
+
+    void evict();
+
+    Options opts_;
+    std::unordered_map<std::string, Entry> entries_; // serial -> entry
+    bool dirty_{false};
+};
@@ -0,0 +1,150 @@
+#include "providers/EnrichScheduler.h"
+
+#include <algorithm>
+
+bool EnrichScheduler::request(const std::string& serial, Priority prio, TimePoint now) {
+    auto rit = running_.find(serial);
+    if (rit != running_.end()) {
+        if (!rit->second.cancelled) return false;
+        // The cancelled run is still unwinding; start over once it has.
+        Running& r = rit->second;
+        if (!r.again || prio < *r.again) r.again = prio;
+        return true;
+    }
+    auto wit = waiting_.find(serial);
+    if (wit != waiting_.end()) {
+        Waiting& w = wit->second;
+        if (prio < w.prio) {
+            if (!w.due) ready_.erase(readyKey(serial, w));
+            w.prio = prio;
+            if (!w.due) ready_.insert(readyKey(serial, w));
+        }
+        return false;
+    }
+    if (throttled(serial, now)) return false;
+    Waiting w;
+    w.prio = prio;
+    enqueue(serial, w);
+    return true;
+}
+
+std::optional<std::string> EnrichScheduler::next(TimePoint now) {
+    promoteDue(now);
+    if (ready_.empty() || running_.size() >= opts_.maxInFlight) return std::nullopt;
+    const auto first = ready_.begin();
+    std::string serial = first->second;
+    ready_.erase(first);
+    auto wit = waiting_.find(serial);
+    Running r;
+    r.prio = wit->second.prio;
+    r.attempts = wit->second.attempts;
+    waiting_.erase(wit);
+    running_.emplace(serial, r);
+    return serial;
+}
+
+std::optional<EnrichScheduler::TimePoint> EnrichScheduler::nextDue() const {
+    if (delayed_.empty()) return std::nullopt;
+    return delayed_.begin()->first;
+}
+
+std::optional<std::chrono::milliseconds> EnrichScheduler::finished(const std::string& serial, bool ok,
+                                                                    TimePoint now) {
+    auto rit = running_.find(serial);
+    if (rit == running_.end()) return std::nullopt;
+    const Running r = rit->second;
+    running_.erase(rit);
+
+    if (r.cancelled) {
+        if (r.again) {
+            Waiting w;
+            w.prio = *r.again;
+            enqueue(serial, w);
+        }
+        return std::nullopt;
+    }
+    if (ok) {
+        touch(serial, now);
+        return std::nullopt;
+    }
+    if (r.attempts + 1 >= opts_.maxAttempts) return std::nullopt;
+
+    Waiting w;
+    w.prio = r.prio;
+    w.attempts = r.attempts + 1;
+    auto backoff = opts_.retryBase;
+    for (int i = 1; i < w.attempts && backoff < opts_.retryMax; ++i) backoff *= 2;
+    backoff = std::min(backoff, opts_.retryMax);
+    w.due = now + backoff;
+    enqueue(serial, w);
+    return backoff;
+}
+
+void EnrichScheduler::cancel(const std::string& serial) {
+    remove(serial);
+    auto rit = running_.find(serial);
+    if (rit != running_.end()) {
+        rit->second.cancelled = true;
+        rit->second.again.reset();
+    }
+}
+
+bool EnrichScheduler::throttled(const std::string& serial, TimePoint now) {
+    expire(now);
+    auto it = lruIndex_.find(serial);
+    return it != lruIndex_.end() && now - it->second->second < opts_.throttle;
+}
+
+void EnrichScheduler::touch(const std::string& serial, TimePoint now) {
+    auto it = lruIndex_.find(serial);
+    if (it != lruIndex_.end()) lru_.erase(it->second);
+    lru_.emplace_front(serial, now);
+    lruIndex_[serial] = lru_.begin();
+    expire(now);
+}
+
+void EnrichScheduler::expire(TimePoint now) {
+    // Entries are in completion order, so the oldest sit at the back.
+    while (!lru_.empty() && (lru_.size() > opts_.maxTracked || now - lru_.back().second >= opts_.throttle)) {
+        lruIndex_.erase(lru_.back().first);
+        lru_.pop_back();
+    }
+}
+
+void EnrichScheduler::promoteDue(TimePoint now) {
+    while (!delayed_.empty() && delayed_.begin()->first <= now) {
+        const std::string serial = delayed_.begin()->second;
+        delayed_.erase(delayed_.begin());
+        Waiting& w = waiting_[serial];
+        w.due.reset();
+        ready_.insert(readyKey(serial, w));
+    }
+}
+
+void EnrichScheduler::enqueue(const std::string& serial, Waiting w) {
+    w.seq = ++seq_;
+    if (w.due) {
+        delayed_.emplace(*w.due, serial);
+    } else {
+        ready_.insert(readyKey(serial, w));
+    }
+    waiting_[serial] = w;
+}
+
+void EnrichScheduler::remove(const std::string& serial) {
+    auto wit = waiting_.find(serial);
+    if (wit == waiting_.end()) return;
+    const Waiting& w = wit->second;
+    if (w.due) {
+        auto range = delayed_.equal_range(*w.due);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == serial) {
+                delayed_.erase(it);
+                break;
+            }
+        }
+    } else {
+        ready_.erase(readyKey(serial, w));
+    }
+    waiting_.erase(wit);
+}
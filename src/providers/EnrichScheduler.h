@@ -0,0 +1,99 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <optional>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+// Admission and ordering for per-device enrichment (ADB getprop sessions).
+// At most maxInFlight run at once; waiting serials start in priority order
+// (newly attached before refreshes), FIFO within a priority. A failed run is
+// retried with exponential backoff up to maxAttempts. A successful run
+// throttles the serial for `throttle`; that state is kept in LRU order and
+// expires after the throttle or beyond maxTracked serials. Not synchronized.
+class EnrichScheduler {
+public:
+    using TimePoint = std::chrono::steady_clock::time_point;
+
+    enum class Priority { Attach = 0, Refresh = 1 };
+
+    struct Options {
+        std::size_t maxInFlight{4};
+        std::chrono::milliseconds throttle{30000};
+        int maxAttempts{4};
+        std::chrono::milliseconds retryBase{1000};
+        std::chrono::milliseconds retryMax{30000};
+        std::size_t maxTracked{1024};
+    };
+
+    EnrichScheduler() = default;
+    explicit EnrichScheduler(const Options& opts) : opts_(opts) {}
+
+    const Options& options() const { return opts_; }
+
+    // Ask for serial to be enriched. Returns false when it is throttled, in
+    // flight or already waiting (a waiting refresh is promoted to Attach).
+    bool request(const std::string& serial, Priority prio, TimePoint now);
+    // Next serial to start now, if any is due and a slot is free. It counts
+    // as in flight until finished().
+    std::optional<std::string> next(TimePoint now);
+    // When the earliest delayed retry becomes due.
+    std::optional<TimePoint> nextDue() const;
+    // Outcome of a run started by next(). On failure, returns the backoff
+    // before the retry, or nullopt when attempts are exhausted or the serial
+    // was cancelled meanwhile.
+    std::optional<std::chrono::milliseconds> finished(const std::string& serial, bool ok, TimePoint now);
+    // Drop a waiting serial (device detached). Throttle state is kept, so a
+    // quick re-attach is not enriched again. A run
+    // in flight is not retried; the caller cancels it and still reports
+    // finished(). A request() meanwhile is queued once that run finishes.
+    void cancel(const std::string& serial);
+
+    bool running(const std::string& serial) const { return running_.count(serial) != 0; }
+    std::size_t queued() const { return ready_.size() + delayed_.size(); }
+    std::size_t inFlight() const { return running_.size(); }
+    std::size_t tracked() const { return lru_.size(); }
+
+private:
+    struct Waiting {
+        Priority prio{Priority::Attach};
+        int attempts{0};             // failed runs so far
+        std::uint64_t seq{0};
+        std::optional<TimePoint> due; // set while delayed for a retry
+    };
+    struct Running {
+        Priority prio{Priority::Attach};
+        int attempts{0};
+        bool cancelled{false};
+        std::optional<Priority> again; // requested again after cancel
+    };
+    using ReadyKey = std::pair<std::pair<int, std::uint64_t>, std::string>; // (prio, seq), serial
+
+    static ReadyKey readyKey(const std::string& serial, const Waiting& w) {
+        return {{static_cast<int>(w.prio), w.seq}, serial};
+    }
+    bool throttled(const std::string& serial, TimePoint now);
+    void touch(const std::string& serial, TimePoint now);
+    void expire(TimePoint now);
+    // Move delayed retries that are due into the ready set.
+    void promoteDue(TimePoint now);
+    void enqueue(const std::string& serial, Waiting w);
+    void remove(const std::string& serial);
+
+    Options opts_{};
+    std::uint64_t seq_{0};
+    std::unordered_map<std::string, Waiting> waiting_;
+    std::set<ReadyKey> ready_;
+    std::multimap<TimePoint, std::string> delayed_;
+    std::unordered_map<std::string, Running> running_;
+
+    // Last successful run per serial, most recent first.
+    std::list<std::pair<std::string, TimePoint>> lru_;
+    std::unordered_map<std::string, std::list<std::pair<std::string, TimePoint>>::iterator> lruIndex_;
+};
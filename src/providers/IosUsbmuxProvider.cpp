@@ -3,6 +3,7 @@
 
 #include <chrono>
 #include <thread>
+#include <vector>
 #include <spdlog/spdlog.h>
 
 #if WITH_LIBIMOBILEDEVICE
@@ -41,14 +42,18 @@ void IosUsbmuxProvider::stop() {
     if (worker_.joinable()) worker_.join();
 }
 
-void IosUsbmuxProvider::emitAttachBasic(const std::string& udid) {
+DeviceInfo IosUsbmuxProvider::basicInfo(const std::string& udid) {
     DeviceInfo info;
     info.type = Type::iOS;
     info.uid = udid;
     info.transport = "USB";
     info.online = true;
     info.manufacturer = "Apple";
-    DeviceEvent evt{ DeviceEvent::Kind::Attach, info };
+    return info;
+}
+
+void IosUsbmuxProvider::emitAttachBasic(const std::string& udid) {
+    DeviceEvent evt{ DeviceEvent::Kind::Attach, basicInfo(udid) };
     manager_.onEvent(evt);
 }
 
@@ -150,13 +155,19 @@ void IosUsbmuxProvider::runLoop() {
     char** list = nullptr;
     int count = 0;
     if (idevice_get_device_list(&list, &count) == IDEVICE_E_SUCCESS && list) {
+        // Attach everything present in one batch, then enrich one by one
+        std::vector<std::string> udids;
+        std::vector<DeviceEvent> batch;
         for (int i = 0; i < count; ++i) {
             if (!list[i]) continue;
-            std::string udid = list[i];
-            emitAttachBasic(udid);
-            enrichInfo(udid);
+            udids.emplace_back(list[i]);
+            batch.push_back(DeviceEvent{ DeviceEvent::Kind::Attach, basicInfo(udids.back()) });
         }
         idevice_device_list_free(list);
+        manager_.onEvents(std::move(batch));
+        for (const auto& udid : udids) {
+            enrichInfo(udid);
+        }
     }
 
     while (running_.load()) {
@@ -23,6 +23,7 @@ public:
 
 private:
     void runLoop();
+    static DeviceInfo basicInfo(const std::string& udid);
     void emitAttachBasic(const std::string& udid);
     void emitDetach(const std::string& udid);
     void enrichInfo(const std::string& udid);
@@ -88,36 +88,38 @@ bool UsbProvider::parseVidPidFromPath(const std::wstring& path, uint16_t& vid, u
 
 std::string UsbProvider::pickBestUidForUsb(uint16_t vid, uint16_t pid) {
     (void)pid;
-    auto list = manager_.snapshot();
     // prefer devices that are online and missing USB info
-    std::vector<DeviceInfo> cands;
-    for (const auto& d : list) {
-        if (!d.online) continue;
-        if (d.vid != 0 || d.pid != 0) continue; // already enriched
+    DeviceManager::Query q;
+    q.online = true;
+    q.vid = 0;
+    q.pid = 0;
+    std::vector<DeviceManager::RecordPtr> cands;
+    for (auto& rec : manager_.query(q)) {
+        const auto& d = rec->info;
         // Simple vendor heuristic: Apple -> iOS, common Android vendors -> Android
         if (vid == 0x05AC && d.type != Type::iOS) continue; // Apple
         if (vid != 0x05AC && d.type == Type::iOS) continue;
-        cands.push_back(d);
+        cands.push_back(std::move(rec));
     }
-    if (cands.size() == 1) return cands.front().uid;
+    if (cands.size() == 1) return cands.front()->info.uid;
 
     // Use recency as tie-breaker
     using clk = std::chrono::system_clock;
     auto now = clk::now();
     std::string best;
     auto bestAge = std::chrono::seconds::max();
-    for (const auto& d : cands) {
-        auto since = manager_.onlineSince(d.uid);
+    for (const auto& rec : cands) {
+        const auto& since = rec->onlineSince;
         if (!since.has_value()) continue;
         auto age = std::chrono::duration_cast<std::chrono::seconds>(now - *since);
-        if (age < bestAge) { bestAge = age; best = d.uid; }
+        if (age < bestAge) { bestAge = age; best = rec->info.uid; }
     }
     // only accept if seen recently
     if (!best.empty() && bestAge <= std::chrono::seconds(8)) return best;
     return {};
 }
 
-void UsbProvider::handleEvent(const Event& e) {
+void UsbProvider::handleEvent(const Event& e, std::vector<DeviceEvent>& out) {
 #ifdef _WIN32
     if (e.kind == Event::Kind::Arrive || e.kind == Event::Kind::Refresh) {
         uint16_t vid = e.vid, pid = e.pid;
@@ -134,8 +136,7 @@ void UsbProvider::handleEvent(const Event& e) {
             info.vid = vid;
             info.pid = pid;
             info.usbPath = path;
-            DeviceEvent evt{ DeviceEvent::Kind::InfoUpdated, info };
-            manager_.onEvent(evt);
+            out.push_back(DeviceEvent{ DeviceEvent::Kind::InfoUpdated, std::move(info) });
             pathToUid_[e.symlinkW] = uid;
             spdlog::info("[USB] enriched uid={} vid=0x{:04x} pid=0x{:04x}", uid, (unsigned)vid, (unsigned)pid);
         } else {
@@ -150,6 +151,7 @@ void UsbProvider::handleEvent(const Event& e) {
     }
 #else
     (void)e;
+    (void)out;
 #endif
 }
 
@@ -179,6 +181,7 @@ void UsbProvider::workerLoop() {
             return ERROR_SUCCESS;
         }
         e.symlinkW = data->u.DeviceInterface.SymbolicLink;
+        e.at = std::chrono::steady_clock::now();
         {
             std::lock_guard<std::mutex> lk(self->mtx_);
             self->q_.push(std::move(e));
@@ -197,13 +200,20 @@ void UsbProvider::workerLoop() {
         if (q_.empty()) {
             cv_.wait_for(lk, std::chrono::milliseconds(500));
         }
+        std::vector<DeviceEvent> batch;
         while (!q_.empty()) {
             Event e = std::move(q_.front());
             q_.pop();
             lk.unlock();
-            handleEvent(e);
+            const std::size_t first = batch.size();
+            handleEvent(e, batch);
+            for (std::size_t i = first; i < batch.size(); ++i) batch[i].observed = e.at;
             lk.lock();
         }
+        if (!batch.empty()) {
+            lk.unlock();
+            manager_.onEvents(std::move(batch));
+        }
     }
 
     if (hNotify) {
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <string>
 #include <thread>
 #include <atomic>
@@ -7,6 +8,7 @@
 #include <condition_variable>
 #include <queue>
 #include <unordered_map>
+#include <vector>
 
 #include "core/DeviceManager.h"
 
@@ -28,10 +30,12 @@ private:
         std::wstring symlinkW; // raw device interface path
         uint16_t vid{0};
         uint16_t pid{0};
+        std::chrono::steady_clock::time_point at{}; // notification time, for latency metrics
     };
 
     void workerLoop();
-    void handleEvent(const Event& e);
+    // Appends resulting manager events to out (sent as one batch per drain)
+    void handleEvent(const Event& e, std::vector<DeviceEvent>& out);
     void enumeratePresent();
 
     static std::string utf8FromWide(const std::wstring& ws);
@@ -14,6 +14,7 @@
 #include "core/DeviceModel.h"
 #include "core/Serialize.h"
 #include "core/IosBackupService.h"
+#include "core/Metrics.h"
 
 using std::string;
 
@@ -38,19 +39,43 @@ void CliMenu::printMenu(bool realtimeOn) {
     std::cout << "[B] 测试 iOS 设备连接\n";
     std::cout << "[P] iOS 备份\n";
     std::cout << "[M] 管理 iOS 备份\n";
+    std::cout << "[S] 事件管道延迟统计\n";
     std::cout << "[9] 退出\n";
 }
 
+void CliMenu::showPipelineStats() {
+    std::cout << "\n=== 事件管道延迟统计 ===\n";
+    std::cout << Metrics::global().summary();
+    const auto servers = adb_.endpointStats();
+    fmt::print("\n{:<24} {:<6} {:<6} {:>7} {:>8} {:>8} {:>6} {:>7} {:>10} {:>7}  {}\n", "adb server", "state", "track",
+               "devices", "connects", "failures", "drops", "blocks", "reconciled", "expired", "last error");
+    for (const auto& ep : servers) {
+        fmt::print("{:<24} {:<6} {:<6} {:>7} {:>8} {:>8} {:>6} {:>7} {:>10} {:>7}  {}\n", ep.label,
+                   ep.connected ? "up" : "down", ep.protoTrack ? "proto" : "text", ep.devices, ep.connects,
+                   ep.connectFailures, ep.drops, ep.blocks, ep.reconciled, ep.graceExpired,
+                   ep.lastError.empty() ? "-" : ep.lastError);
+    }
+    const auto flapping = manager_.flappingDevices();
+    if (!flapping.empty()) {
+        fmt::print("\n{:<24} {:>11} {:>10} {:>8} {:>10}\n", "flapping uid", "transitions", "suppressed", "penalty", "hold ms");
+        for (const auto& [uid, f] : flapping) {
+            fmt::print("{:<24} {:>11} {:>10} {:>8.1f} {:>10}\n", uid, f.transitions, f.suppressed, f.penalty,
+                       f.holdDown.count());
+        }
+    }
+}
+
 void CliMenu::listDevices() {
-    auto list = manager_.snapshot();
-    if (list.empty()) {
+    auto table = manager_.table();
+    if (table->records.empty()) {
         std::cout << "当前无设备" << std::endl;
         return;
     }
 
     fmt::print("\n{:<24} {:<8} {:<24} {:<10} {:<12}\n", "uid", "type", "model", "osVersion", "onlineSince");
-    for (const auto& d : list) {
-        auto since = manager_.onlineSince(d.uid);
+    for (const auto& kv : table->records) {
+        const auto& d = kv.second->info;
+        const auto& since = kv.second->onlineSince;
         std::string sinceStr = since.has_value() ? Utils::formatTimeHHMMSS(*since) : "-";
         fmt::print("{:<24} {:<8} {:<24} {:<10} {:<12}\n",
                    d.uid,
@@ -66,14 +91,14 @@ void CliMenu::showDeviceDetails() {
     std::string uid;
     if (!(std::cin >> uid)) return;
 
-    auto list = manager_.snapshot();
-    auto it = std::find_if(list.begin(), list.end(), [&](const DeviceInfo& i){ return i.uid == uid; });
-    if (it == list.end()) {
+    auto table = manager_.table();
+    auto it = table->records.find(uid);
+    if (it == table->records.end()) {
         std::cout << "未找到 UID 对应的设备: " << uid << std::endl;
         return;
     }
-    const auto& d = *it;
-    auto since = manager_.onlineSince(d.uid);
+    const auto& d = it->second->info;
+    const auto& since = it->second->onlineSince;
     std::string sinceStr = since.has_value() ? Utils::formatTimeHHMMSS(*since) : "-";
 
     std::cout << "\n=== 设备详情 ===\n";
@@ -90,9 +115,17 @@ void CliMenu::showDeviceDetails() {
         fmt::print("vid: 0x{:04x}\n", (unsigned)d.vid);
         fmt::print("pid: 0x{:04x}\n", (unsigned)d.pid);
     }
+    if (auto flap = manager_.flapState(uid); flap && flap->transitions > 0) {
+        fmt::print("flap: {} transitions={} suppressed={} penalty={:.1f} holdDown={}ms\n",
+                   flap->flapping ? "flapping" : "stable", flap->transitions, flap->suppressed,
+                   flap->penalty, flap->holdDown.count());
+    }
     if (!d.usbPath.empty()) {
         fmt::print("usbPath: {}\n", d.usbPath);
     }
+    if (d.usbSpeedMbps) {
+        fmt::print("usbSpeed: {} Mbps\n", d.usbSpeedMbps);
+    }
     fmt::print("onlineSince: {}\n", sinceStr);
 }
 
@@ -185,12 +218,12 @@ void CliMenu::testIosConnection() {
 
 void CliMenu::iosBackup() {
     // 1. 收集当前在线的 iOS 设备
-    auto all = manager_.snapshot();
+    DeviceManager::Query q;
+    q.type = Type::iOS;
+    q.online = true;
     std::vector<DeviceInfo> iosList;
-    for (const auto& d : all) {
-        if (d.type == Type::iOS && d.online) {
-            iosList.push_back(d);
-        }
+    for (const auto& rec : manager_.query(q)) {
+        iosList.push_back(rec->info);
     }
     if (iosList.empty()) {
         std::cout << "当前没有在线的 iOS 设备" << std::endl;
@@ -357,12 +390,12 @@ void CliMenu::manageIosBackups() {
     }
 
     // 选择目标在线 iOS 设备
-    auto all = manager_.snapshot();
+    DeviceManager::Query q;
+    q.type = Type::iOS;
+    q.online = true;
     std::vector<DeviceInfo> iosList;
-    for (const auto& d : all) {
-        if (d.type == Type::iOS && d.online) {
-            iosList.push_back(d);
-        }
+    for (const auto& rec : manager_.query(q)) {
+        iosList.push_back(rec->info);
     }
     if (iosList.empty()) {
         std::cout << "当前没有在线的 iOS 设备用于还原" << std::endl;
@@ -442,6 +475,8 @@ int CliMenu::run() {
             iosBackup();
         } else if (cmd == "M" || cmd == "m") {
             manageIosBackups();
+        } else if (cmd == "S" || cmd == "s") {
+            showPipelineStats();
         } else {
             std::cout << "无效选项: " << cmd << std::endl;
         }
@@ -2,12 +2,14 @@
 
 #include "core/DeviceManager.h"
 #include "core/ExternalNotifier.h"
+#include "providers/AndroidAdbProvider.h"
 #include "providers/IosUsbmuxProvider.h"
 
 class CliMenu {
 public:
-    CliMenu(DeviceManager& manager, bool& realtimePrintFlag, IosUsbmuxProvider& ios, ExternalNotifier& notifier)
-        : manager_(manager), realtimePrintFlag_(realtimePrintFlag), ios_(ios), notifier_(notifier) {}
+    CliMenu(DeviceManager& manager, bool& realtimePrintFlag, IosUsbmuxProvider& ios, AndroidAdbProvider& adb,
+            ExternalNotifier& notifier)
+        : manager_(manager), realtimePrintFlag_(realtimePrintFlag), ios_(ios), adb_(adb), notifier_(notifier) {}
 
     int run(); // returns exit code
 
@@ -22,9 +24,11 @@ private:
     void testIosConnection();
     void iosBackup();
     void manageIosBackups();
+    void showPipelineStats();
 
     DeviceManager& manager_;
     bool& realtimePrintFlag_;
     IosUsbmuxProvider& ios_;
+    AndroidAdbProvider& adb_;
     ExternalNotifier& notifier_;
 };
@@ -0,0 +1,94 @@
+// AdbProtocol checks: a host:track-devices-proto-binary block as adb sends
+// it (length prefix plus a serialized Devices message) decodes field by
+// field, and ConnectionState numbers map to the names the text tracker uses.
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "providers/AdbProtocol.h"
+#include "Check.h"
+
+namespace {
+// Two devices: a ready phone on USB and one sitting in the bootloader.
+const std::uint8_t kProtoBlock[] = {
+    '0', '0', '5', 'a', // 90-byte Devices message
+    0x0a, 0x42, // device, 66 bytes
+    0x0a, 0x0b, 0x52, 0x35, 0x38, 0x4d, 0x31, 0x32, 0x41, 0x42, 0x43, 0x44, 0x45, // serial
+    0x10, 0x08, // state DEVICE
+    0x1a, 0x05, 0x31, 0x2d, 0x31, 0x2e, 0x32, // bus address
+    0x22, 0x0d, 0x62, 0x65, 0x79, 0x6f, 0x6e, 0x64, 0x31, 0x6c, 0x74, 0x65, 0x65, 0x65, 0x61, // product
+    0x2a, 0x08, 0x53, 0x4d, 0x5f, 0x47, 0x39, 0x37, 0x33, 0x46, // model
+    0x32, 0x07, 0x62, 0x65, 0x79, 0x6f, 0x6e, 0x64, 0x31, // device
+    0x38, 0x01, // USB
+    0x40, 0xe0, 0x03, // negotiated speed
+    0x48, 0x88, 0x27, // max speed
+    0x50, 0x03, // transport id
+    0x0a, 0x14, // device, 20 bytes
+    0x0a, 0x0c, 0x30, 0x41, 0x31, 0x42, 0x32, 0x43, 0x33, 0x44, 0x34, 0x45, 0x35, 0x46, // serial
+    0x10, 0x07, // state BOOTLOADER
+    0x38, 0x01, // USB
+    0x50, 0x07, // transport id
+};
+
+void decodesProtoBlock() {
+    const std::string_view raw(reinterpret_cast<const char*>(kProtoBlock), sizeof(kProtoBlock));
+    std::size_t len = 0;
+    CHECK(adb::parseHexLen4(raw, len));
+    CHECK(len == raw.size() - 4);
+    const std::string_view block = raw.substr(4, len);
+
+    std::vector<adb::ProtoDevice> devices;
+    CHECK(adb::forEachProtoDevice(block, [&devices](std::string_view msg) {
+        adb::ProtoDevice d;
+        CHECK(adb::parseProtoDevice(msg, d));
+        devices.push_back(d);
+    }));
+    CHECK(devices.size() == 2);
+    if (devices.size() != 2) return;
+
+    const auto& phone = devices[0];
+    CHECK(phone.serial == "R58M12ABCDE");
+    CHECK(phone.state == static_cast<int>(adb::ConnectionState::Device));
+    CHECK(adb::connectionStateName(phone.state) == "device");
+    CHECK(phone.busAddress == "1-1.2");
+    CHECK(phone.product == "beyond1lteeea");
+    CHECK(phone.model == "SM_G973F");
+    CHECK(phone.device == "beyond1");
+    CHECK(phone.connectionType == adb::ConnectionType::Usb);
+    CHECK(phone.negotiatedSpeed == 480 && phone.maxSpeed == 5000);
+    CHECK(phone.transportId == 3);
+
+    const auto& boot = devices[1];
+    CHECK(boot.serial == "0A1B2C3D4E5F");
+    CHECK(boot.state == static_cast<int>(adb::ConnectionState::Bootloader));
+    CHECK(adb::connectionStateName(boot.state) == "bootloader");
+    CHECK(boot.model.empty() && boot.transportId == 7);
+
+    // A message cut short is rejected rather than read past its end
+    CHECK(!adb::forEachProtoDevice(block.substr(0, 30), [](std::string_view) {}));
+}
+
+void stateNamesMatchTextTracker() {
+    CHECK(adb::connectionStateName(0) == "any");
+    CHECK(adb::connectionStateName(static_cast<int>(adb::ConnectionState::Unauthorized)) == "unauthorized");
+    CHECK(adb::connectionStateName(static_cast<int>(adb::ConnectionState::Offline)) == "offline");
+    CHECK(adb::connectionStateName(static_cast<int>(adb::ConnectionState::Host)) == "host");
+    CHECK(adb::connectionStateName(static_cast<int>(adb::ConnectionState::Rescue)) == "rescue");
+    CHECK(adb::connectionStateName(13) == "unknown");
+    CHECK(adb::connectionStateName(-1) == "unknown");
+
+    adb::TrackLine t;
+    CHECK(adb::parseTrackLine("R58M12ABCDE\tdevice usb:1-1.2 product:beyond1lteeea model:SM_G973F transport_id:3", t));
+    CHECK(t.state == "device" && t.usb == "1-1.2" && t.model == "SM_G973F" && t.transportId == "3");
+}
+} // namespace
+
+int main() {
+    decodesProtoBlock();
+    stateNamesMatchTextTracker();
+    return check::finish("AdbProtocolTest");
+}
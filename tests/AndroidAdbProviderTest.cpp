@@ -0,0 +1,280 @@
+// AndroidAdbProvider against the in-process fake adb server, once with the
+// text tracker (the server FAILs track-devices-proto-binary, so the provider
+// falls back) and once with the proto-binary tracker. Each run checks attach,
+// getprop enrichment, detach, a dropped connection reconciled within the
+// grace window, and an empty list detaching the rest, through the published
+// table and a subscriber. A last run puts the manager on a SimulatedClock
+// and checks that the enrich throttle and retry backoff follow it.
+
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <asio.hpp>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "FakeAdb.h"
+#include "core/Clock.h"
+#include "core/DeviceManager.h"
+#include "core/Metrics.h"
+#include "providers/AndroidAdbProvider.h"
+#include "Check.h"
+
+namespace {
+using namespace std::chrono_literals;
+using Kind = DeviceEvent::Kind;
+
+void setEnv(const char* key, const std::string& value) {
+#ifdef _WIN32
+    _putenv_s(key, value.c_str());
+#else
+    setenv(key, value.c_str(), 1);
+#endif
+}
+
+// Polls until pred holds; the provider and manager run on their own threads.
+bool eventually(const std::function<bool()>& pred, std::chrono::milliseconds timeout = 5s) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (!pred()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(10ms);
+    }
+    return true;
+}
+
+class Recorder {
+public:
+    void operator()(const DeviceEvent& e) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        got_.push_back(e);
+    }
+    std::size_t count(const std::string& uid, Kind kind) {
+        std::lock_guard<std::mutex> lk(mtx_);
+        std::size_t n = 0;
+        for (const auto& e : got_) n += (e.info.uid == uid && e.kind == kind);
+        return n;
+    }
+
+private:
+    std::mutex mtx_;
+    std::vector<DeviceEvent> got_;
+};
+
+// The fake server on its own io thread; every call is run there.
+class FakeAdb {
+public:
+    explicit FakeAdb(bool proto) : FakeAdb(options(proto)) {}
+    explicit FakeAdb(const fakeadb::ServerOptions& opts) : work_(asio::make_work_guard(io_)), server_(io_, 0, opts) {
+        server_.start();
+        thread_ = std::thread([this]() { io_.run(); });
+    }
+    ~FakeAdb() {
+        work_.reset();
+        io_.stop();
+        thread_.join();
+    }
+
+    unsigned short port() const { return server_.port(); }
+    void publish(const std::string& block) {
+        run([this, block]() { server_.publish(block); });
+    }
+    void restart(const std::string& block) {
+        run([this, block]() {
+            server_.dropTrackers();
+            server_.publish(block);
+        });
+    }
+    fakeadb::Stats stats() {
+        fakeadb::Stats out;
+        run([this, &out]() { out = server_.stats(); });
+        return out;
+    }
+
+private:
+    static fakeadb::ServerOptions options(bool proto) {
+        fakeadb::ServerOptions opts;
+        opts.proto = proto;
+        return opts;
+    }
+    void run(std::function<void()> fn) {
+        std::promise<void> done;
+        asio::post(io_, [&]() {
+            fn();
+            done.set_value();
+        });
+        done.get_future().wait();
+    }
+
+    asio::io_context io_;
+    asio::executor_work_guard<asio::io_context::executor_type> work_;
+    fakeadb::Server server_;
+    std::thread thread_;
+};
+
+std::optional<DeviceManager::Record> record(const DeviceManager& manager, const std::string& uid) {
+    const auto t = manager.table();
+    auto it = t->records.find(uid);
+    if (it == t->records.end()) return std::nullopt;
+    return *it->second;
+}
+
+bool enriched(const DeviceManager& manager, const std::string& uid) {
+    const auto r = record(manager, uid);
+    return r && r->info.manufacturer == "Fake" && r->info.osVersion == "14";
+}
+
+const char* kPhone = "PHONE1\tdevice usb:1-1 product:p1 model:Pixel_8 device:d1 transport_id:1\n";
+const char* kLocked = "LOCKED1\tunauthorized usb:1-2 transport_id:2\n";
+const char* kNew = "NEW1\tdevice usb:1-3 product:p2 model:SM_G973F device:d2 transport_id:3\n";
+
+void runAgainst(bool proto) {
+    const char* mode = proto ? "proto" : "text";
+    FakeAdb adb(proto);
+    adb.publish(std::string(kPhone) + kLocked);
+    setEnv("DW_ADB_SERVERS", fmt::format("127.0.0.1:{}", adb.port()));
+    setEnv("DW_ADB_GRACE_MS", "5000");
+
+    Recorder events; // outlives the manager, whose bus drains into it
+    DeviceManager manager;
+    manager.subscribe([&events](const DeviceEvent& e) { events(e); });
+    AndroidAdbProvider provider(manager);
+    provider.start();
+
+    // Attach, and getprop enrichment of the ready device only
+    CHECK(eventually([&]() { return enriched(manager, "PHONE1") && record(manager, "LOCKED1"); }));
+    if (const auto phone = record(manager, "PHONE1")) {
+        CHECK(phone->info.online && phone->info.adbState == "device");
+        CHECK(phone->info.model == "Pixel_8" && phone->info.abi == "arm64-v8a");
+        CHECK(phone->info.usbPath == "1-1");
+    }
+    if (const auto locked = record(manager, "LOCKED1")) {
+        // Listed, so present to the manager; adbState says why it is unusable
+        CHECK(locked->info.adbState == "unauthorized");
+        CHECK(locked->info.manufacturer.empty());
+    }
+    CHECK(eventually([&]() { return events.count("LOCKED1", Kind::Attach) == 1; }));
+    CHECK(events.count("PHONE1", Kind::Attach) == 1);
+    auto stats = provider.endpointStats();
+    CHECK(stats.size() == 1 && stats[0].connected && stats[0].protoTrack == proto);
+
+    // Detach
+    adb.publish(kPhone);
+    CHECK(eventually([&]() { return !record(manager, "LOCKED1"); }));
+    CHECK(eventually([&]() { return events.count("LOCKED1", Kind::Detach) == 1; }));
+
+    // Connection lost; a device arrives meanwhile. The reconnect diffs the
+    // fresh list against the held one: only the new device changes.
+    const auto since = manager.onlineSince("PHONE1");
+    adb.restart(std::string(kPhone) + kNew);
+    CHECK(eventually([&]() { return enriched(manager, "NEW1"); }));
+    stats = provider.endpointStats();
+    CHECK(stats.size() == 1 && stats[0].drops == 1 && stats[0].reconciled == 1 && stats[0].graceExpired == 0);
+    CHECK(stats.size() == 1 && stats[0].protoTrack == proto);
+    // The new session asked for the binary tracker again before falling back
+    if (!proto) CHECK(adb.stats().fails == 2);
+    CHECK(eventually([&]() { return events.count("NEW1", Kind::Attach) == 1; }));
+    CHECK(events.count("PHONE1", Kind::Attach) == 1 && events.count("PHONE1", Kind::Detach) == 0);
+    CHECK(since && manager.onlineSince("PHONE1") == since);
+
+    // An empty list detaches the last devices
+    adb.publish("");
+    CHECK(eventually([&]() { return !record(manager, "PHONE1") && !record(manager, "NEW1"); }));
+    CHECK(eventually([&]() { return events.count("NEW1", Kind::Detach) == 1; }));
+    CHECK(events.count("PHONE1", Kind::Detach) == 1);
+    stats = provider.endpointStats();
+    CHECK(stats.size() == 1 && stats[0].devices == 0);
+
+    provider.stop();
+    if (check::failures) fmt::print(stderr, "failures so far after {} mode: {}\n", mode, check::failures);
+}
+// Blocks the provider has handled from its only server.
+std::uint64_t blocks(const AndroidAdbProvider& provider) {
+    const auto stats = provider.endpointStats();
+    return stats.empty() ? 0 : stats[0].blocks;
+}
+
+bool enrichIdle() {
+    const auto& m = Metrics::global();
+    return m.enrichInFlight.value() == 0 && m.enrichQueued.value() == 0;
+}
+
+void runOnSimulatedClock() {
+    const char* kPhoneOffline = "PHONE1\toffline usb:1-1 transport_id:1\n";
+    setEnv("DW_ADB_GRACE_MS", "5000");
+
+    // Throttle: a device back online within 30s of its last enrichment is
+    // not fetched again; once the clock has moved 30s on, it is.
+    {
+        FakeAdb adb(false);
+        adb.publish(kPhone);
+        setEnv("DW_ADB_SERVERS", fmt::format("127.0.0.1:{}", adb.port()));
+        SimulatedClock clock;
+        DeviceManager manager(clock);
+        AndroidAdbProvider provider(manager);
+        provider.start();
+
+        CHECK(eventually([&]() { return adb.stats().getprops == 1 && enrichIdle(); }));
+        auto toggle = [&]() {
+            const auto b = blocks(provider);
+            adb.publish(kPhoneOffline);
+            adb.publish(kPhone);
+            return eventually([&]() { return blocks(provider) == b + 2; });
+        };
+        clock.advance(29s);
+        CHECK(toggle());
+        // Scheduling is synchronous with the block: nothing was started
+        CHECK(enrichIdle());
+        CHECK(adb.stats().getprops == 1);
+
+        clock.advance(1s);
+        CHECK(toggle());
+        CHECK(eventually([&]() { return adb.stats().getprops == 2 && enrichIdle(); }));
+        provider.stop();
+    }
+
+    // Retry: a failed enrichment waits out its backoff on the manager's
+    // clock, however long it takes in real time.
+    {
+        fakeadb::ServerOptions opts;
+        opts.failRate = 1.0;
+        FakeAdb adb(opts);
+        adb.publish(kPhone);
+        setEnv("DW_ADB_SERVERS", fmt::format("127.0.0.1:{}", adb.port()));
+        SimulatedClock clock;
+        DeviceManager manager(clock);
+        AndroidAdbProvider provider(manager);
+        provider.start();
+
+        auto retryWaiting = []() {
+            const auto& m = Metrics::global();
+            return m.enrichInFlight.value() == 0 && m.enrichQueued.value() == 1;
+        };
+        CHECK(eventually([&]() { return adb.stats().transports == 1 && retryWaiting(); }));
+        std::this_thread::sleep_for(200ms);
+        CHECK(adb.stats().transports == 1);
+        clock.advance(999ms);
+        std::this_thread::sleep_for(50ms);
+        CHECK(adb.stats().transports == 1);
+        // First retry is due 1s after the failure
+        clock.advance(1ms);
+        CHECK(eventually([&]() { return adb.stats().transports == 2 && retryWaiting(); }));
+        provider.stop();
+    }
+    if (check::failures) fmt::print(stderr, "failures so far after simulated clock: {}\n", check::failures);
+}
+} // namespace
+
+int main() {
+    spdlog::set_level(spdlog::level::warn);
+    runAgainst(false);
+    runAgainst(true);
+    runOnSimulatedClock();
+    return check::finish("AndroidAdbProviderTest");
+}
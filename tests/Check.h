@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdlib>
+
+#include <fmt/core.h>
+
+// Shared harness for the tests in this directory: CHECK reports a failed
+// condition and carries on, so one run lists every failure; main() ends
+// with `return check::finish("<Name>");`.
+namespace check {
+inline int failures = 0;
+
+inline int finish(const char* name) {
+    if (failures) {
+        fmt::print(stderr, "{} check(s) failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    fmt::print("{} passed\n", name);
+    return EXIT_SUCCESS;
+}
+} // namespace check
+
+#define CHECK(cond)                                                                         \
+    do {                                                                                    \
+        if (!(cond)) {                                                                      \
+            fmt::print(stderr, "{}:{}: CHECK({}) failed\n", __FILE__, __LINE__, #cond);     \
+            ++check::failures;                                                              \
+        }                                                                                   \
+    } while (0)
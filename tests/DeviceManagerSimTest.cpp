@@ -0,0 +1,251 @@
+// DeviceManager driven by SimulatedClock: debounce, InfoUpdated coalescing,
+// flap hold-down, journal restore grace and checkpoints run on simulated
+// time, and each step checks exactly which events reached a subscriber.
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "core/Clock.h"
+#include "core/DeviceManager.h"
+#include "Check.h"
+
+namespace {
+using namespace std::chrono_literals;
+using Kind = DeviceEvent::Kind;
+
+DeviceEvent event(Kind kind, const std::string& uid, const std::string& model = {},
+                  const std::string& os = {}) {
+    DeviceEvent e;
+    e.kind = kind;
+    e.info.type = Type::Android;
+    e.info.uid = uid;
+    e.info.online = kind != Kind::Detach;
+    e.info.model = model;
+    e.info.osVersion = os;
+    return e;
+}
+
+// Manager on a simulated clock plus a subscriber recording what it gets.
+// Every step waits (in real time) for the worker to park again, so the
+// events a step produces have been published when it returns.
+class Sim {
+public:
+    explicit Sim(const std::string& journalDir = {}) : Sim(journalOptions(journalDir)) {}
+    explicit Sim(const EventJournal::Options& journal) : manager_(clock_) {
+        if (!journal.dir.empty()) CHECK(manager_.openJournal(journal));
+        token_ = manager_.subscribe([this](const DeviceEvent& e) {
+            std::lock_guard<std::mutex> lk(mtx_);
+            got_.push_back(e);
+            cv_.notify_all();
+        });
+        settle();
+    }
+
+    DeviceManager& manager() { return manager_; }
+
+    void send(const DeviceEvent& e) {
+        manager_.onEvent(e);
+        settle();
+    }
+    void advance(std::chrono::milliseconds d) {
+        clock_.advance(d);
+        CHECK(clock_.waitIdle(1));
+    }
+
+    // Everything delivered since the last call, once the bus has drained.
+    std::vector<DeviceEvent> take() {
+        std::unique_lock<std::mutex> lk(mtx_);
+        const auto deadline = std::chrono::steady_clock::now() + 5s;
+        for (;;) {
+            // delivered counts a callback only after it returns: poll
+            auto s = manager_.subscriberStats(token_);
+            if (s && s->queued == 0 && s->delivered == delivered_ + got_.size()) break;
+            if (std::chrono::steady_clock::now() > deadline) break;
+            cv_.wait_for(lk, 1ms);
+        }
+        delivered_ += got_.size();
+        std::vector<DeviceEvent> out;
+        out.swap(got_);
+        return out;
+    }
+
+private:
+    static EventJournal::Options journalOptions(const std::string& dir) {
+        EventJournal::Options opts;
+        opts.dir = dir;
+        return opts;
+    }
+
+    // A zero advance starts a new generation: the worker has handled what
+    // was queued before it once it parks again.
+    void settle() {
+        clock_.advance(0ns);
+        CHECK(clock_.waitIdle(1));
+    }
+
+    // Declared first: the bus inside manager_ drains into got_ on destruction.
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::vector<DeviceEvent> got_;
+    std::uint64_t delivered_{0}; // taken so far
+    SimulatedClock clock_;
+    DeviceManager manager_;
+    int token_{0};
+};
+
+void debounceHoldsAttach() {
+    Sim sim;
+    sim.send(event(Kind::Attach, "a", "M1"));
+    sim.advance(799ms);
+    CHECK(sim.take().empty());
+    sim.advance(1ms);
+    const auto got = sim.take();
+    CHECK(got.size() == 1 && got[0].kind == Kind::Attach && got[0].info.model == "M1");
+    // onlineSince is simulated wall time: the epoch the clock started at, plus the hold
+    CHECK(sim.manager().onlineSince("a") == std::chrono::system_clock::time_point{} + 800ms);
+    CHECK(got.size() == 1 && got[0].delivered == std::chrono::system_clock::time_point{} + 800ms);
+}
+
+void infoUpdatesCoalesce() {
+    Sim sim;
+    sim.send(event(Kind::Attach, "a", "M1"));
+    sim.advance(800ms);
+    CHECK(sim.take().size() == 1);
+
+    sim.send(event(Kind::InfoUpdated, "a", "M2"));
+    sim.advance(20ms);
+    sim.send(event(Kind::InfoUpdated, "a", {}, "14"));
+    sim.advance(20ms);
+    sim.send(event(Kind::InfoUpdated, "a", "M3"));
+    CHECK(sim.take().empty());
+    // The window is not extended by later updates: 50ms after the first
+    sim.advance(10ms);
+    const auto got = sim.take();
+    CHECK(got.size() == 1);
+    if (got.size() != 1) return;
+    CHECK(got[0].kind == Kind::InfoUpdated);
+    CHECK(got[0].info.model == "M3" && got[0].info.osVersion == "14");
+    CHECK(got[0].changed == (DeviceField::Model | DeviceField::OsVersion));
+}
+
+void flappingExtendsHold() {
+    Sim sim;
+    sim.send(event(Kind::Attach, "f"));
+    sim.advance(800ms);
+    CHECK(sim.take().size() == 1);
+
+    // Quick detach/attach cycles are absorbed by the hold-down
+    for (int i = 0; i < 3; ++i) {
+        sim.send(event(Kind::Detach, "f"));
+        sim.advance(100ms);
+        sim.send(event(Kind::Attach, "f"));
+        sim.advance(100ms);
+    }
+    CHECK(sim.take().empty());
+    const auto st = sim.manager().flapState("f");
+    CHECK(st && st->flapping && st->suppressed == 3);
+    CHECK(st && st->holdDown > 800ms);
+
+    // A detach now waits out the longer hold before subscribers hear of it
+    sim.send(event(Kind::Detach, "f"));
+    const auto held = sim.manager().flapState("f");
+    const auto hold = held ? held->holdDown : 0ms;
+    CHECK(hold > 800ms);
+    sim.advance(hold - 1ms);
+    CHECK(sim.take().empty());
+    sim.advance(1ms);
+    const auto got = sim.take();
+    CHECK(got.size() == 1 && got[0].kind == Kind::Detach);
+}
+
+void journalRestoreGrace(const std::string& dir) {
+    {
+        Sim sim(dir);
+        sim.send(event(Kind::Attach, "gone", "G"));
+        sim.send(event(Kind::Attach, "back", "B"));
+        sim.advance(800ms);
+        CHECK(sim.take().size() == 2);
+    }
+    Sim sim(dir);
+    CHECK(sim.manager().table()->records.size() == 2);
+    // Replay carries the journaled time, not the replaying clock's (now: epoch)
+    CHECK(sim.manager().replayJournal(dir, {}) == 2);
+    const auto replayed = sim.take();
+    CHECK(replayed.size() == 2);
+    for (const auto& e : replayed) CHECK(e.delivered == std::chrono::system_clock::time_point{} + 800ms);
+    // Re-reported within the grace period: confirmed without a new Attach
+    sim.advance(5s);
+    sim.send(event(Kind::Attach, "back", "B"));
+    sim.advance(800ms);
+    CHECK(sim.take().empty());
+    // Never re-reported: detached once the 15s grace runs out
+    sim.advance(9s);
+    CHECK(sim.take().empty());
+    sim.advance(200ms);
+    const auto got = sim.take();
+    CHECK(got.size() == 1 && got[0].kind == Kind::Detach && got[0].info.uid == "gone");
+    const auto t = sim.manager().table();
+    CHECK(t->records.size() == 1 && t->records.count("back") == 1);
+}
+std::size_t segments(const std::string& dir) {
+    std::size_t n = 0;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(dir, ec), end; !ec && it != end; it.increment(ec)) ++n;
+    return n;
+}
+
+void checkpointSkipsPendingAttach(const std::string& dir) {
+    {
+        EventJournal::Options opts;
+        opts.dir = dir;
+        opts.segmentBytes = 1; // every group commit starts a new segment
+        opts.commitInterval = 1ms;
+        Sim sim(opts);
+        sim.send(event(Kind::Attach, "seen", "S"));
+        sim.advance(400ms);
+        sim.send(event(Kind::Attach, "ghost", "G"));
+        sim.advance(400ms);
+        const auto got = sim.take();
+        CHECK(got.size() == 1 && got[0].info.uid == "seen");
+
+        // Journaling seen's Attach rotates the segment: its checkpoint is
+        // written while ghost's Attach is still held back
+        const auto deadline = std::chrono::steady_clock::now() + 5s;
+        while (segments(dir) < 2 && std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(1ms);
+        }
+        CHECK(segments(dir) == 2);
+        // Gone within the debounce window: never announced, never journaled
+        sim.send(event(Kind::Detach, "ghost", "G"));
+        sim.advance(800ms);
+        CHECK(sim.take().empty());
+    }
+    Sim sim(dir);
+    const auto t = sim.manager().table();
+    CHECK(t->records.size() == 1 && t->records.count("seen") == 1);
+}
+} // namespace
+
+int main() {
+    debounceHoldsAttach();
+    infoUpdatesCoalesce();
+    flappingExtendsHold();
+
+    const auto dir = std::filesystem::temp_directory_path() /
+                     fmt::format("dw-simtest-{}", std::chrono::steady_clock::now().time_since_epoch().count());
+    journalRestoreGrace(dir.string());
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+    checkpointSkipsPendingAttach(dir.string());
+    std::filesystem::remove_all(dir, ec);
+
+    return check::finish("DeviceManagerSimTest");
+}
@@ -0,0 +1,83 @@
+// EnrichCache checks: LRU eviction by the caller's wall time, fingerprint
+// replacement, and a save/load round trip.
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include <fmt/core.h>
+
+#include "providers/EnrichCache.h"
+#include "Check.h"
+
+namespace {
+using namespace std::chrono_literals;
+
+std::chrono::system_clock::time_point at(std::chrono::seconds s) {
+    return std::chrono::system_clock::time_point{} + s;
+}
+
+EnrichCache::Props props(const std::string& fingerprint, const std::string& model) {
+    return {{EnrichCache::kFingerprintKey, fingerprint}, {"ro.product.model", model}};
+}
+
+void evictsLeastRecentlyUsed(const std::string& path) {
+    EnrichCache::Options opts;
+    opts.path = path;
+    opts.maxEntries = 2;
+    EnrichCache cache(opts);
+    CHECK(cache.store("A", props("fa", "MA"), at(1s)));
+    CHECK(cache.store("B", props("fb", "MB"), at(2s)));
+    // Touching A makes B the oldest
+    CHECK(cache.find("A", at(3s)) != nullptr);
+    CHECK(cache.store("C", props("fc", "MC"), at(4s)));
+    CHECK(cache.size() == 2);
+    CHECK(cache.find("B", at(5s)) == nullptr);
+    CHECK(cache.find("A", at(5s)) != nullptr);
+    CHECK(cache.find("C", at(5s)) != nullptr);
+}
+
+void fingerprintKeysTheEntry(const std::string& path) {
+    EnrichCache::Options opts;
+    opts.path = path;
+    EnrichCache cache(opts);
+    CHECK(!cache.store("A", {{"ro.product.model", "M"}}, at(1s)));
+    CHECK(cache.size() == 0);
+    CHECK(cache.store("A", props("build-1", "M1"), at(1s)));
+    CHECK(cache.store("A", props("build-2", "M2"), at(2s)));
+    CHECK(cache.fingerprint("A") == "build-2");
+    const auto* p = cache.find("A", at(3s));
+    CHECK(p && p->at("ro.product.model") == "M2");
+}
+
+void roundTrip(const std::string& path) {
+    EnrichCache::Options opts;
+    opts.path = path;
+    {
+        EnrichCache cache(opts);
+        CHECK(cache.store("A", props("fa", "MA"), at(10s)));
+        CHECK(cache.store("B", props("fb", "MB"), at(20s)));
+        CHECK(cache.dirty());
+        CHECK(cache.save());
+        CHECK(!cache.dirty());
+    }
+    EnrichCache cache(opts);
+    CHECK(cache.load() == 2);
+    CHECK(cache.fingerprint("B") == "fb");
+    const auto* p = cache.find("A", at(30s));
+    CHECK(p && p->at("ro.product.model") == "MA");
+}
+} // namespace
+
+int main() {
+    const auto dir = std::filesystem::temp_directory_path() /
+                     fmt::format("dw-cachetest-{}", std::chrono::steady_clock::now().time_since_epoch().count());
+    std::filesystem::create_directories(dir);
+    evictsLeastRecentlyUsed((dir / "lru.bin").string());
+    fingerprintKeysTheEntry((dir / "fp.bin").string());
+    roundTrip((dir / "rt.bin").string());
+    std::error_code ec;
+    std::filesystem::remove_all(dir, ec);
+
+    return check::finish("EnrichCacheTest");
+}
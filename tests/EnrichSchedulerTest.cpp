@@ -0,0 +1,150 @@
+// EnrichScheduler checks on explicit time points: the in-flight cap,
+// Attach-before-Refresh ordering, retry backoff, cancellation of a running
+// serial, and throttle expiry by time and by LRU size.
+
+#include <chrono>
+#include <optional>
+#include <string>
+
+#include "providers/EnrichScheduler.h"
+#include "Check.h"
+
+namespace {
+using namespace std::chrono_literals;
+using Priority = EnrichScheduler::Priority;
+
+EnrichScheduler::Options options() {
+    EnrichScheduler::Options opts;
+    opts.maxInFlight = 2;
+    opts.throttle = 30s;
+    opts.maxAttempts = 4;
+    opts.retryBase = 1s;
+    opts.retryMax = 30s;
+    return opts;
+}
+
+void capsInFlight() {
+    EnrichScheduler s(options());
+    EnrichScheduler::TimePoint now{};
+    for (const char* serial : {"a", "b", "c"}) CHECK(s.request(serial, Priority::Attach, now));
+    CHECK(s.next(now) == "a");
+    CHECK(s.next(now) == "b");
+    CHECK(!s.next(now));
+    CHECK(s.inFlight() == 2 && s.queued() == 1);
+    // Already running or waiting: not queued twice
+    CHECK(!s.request("a", Priority::Attach, now));
+    CHECK(!s.request("c", Priority::Attach, now));
+    s.finished("a", true, now);
+    CHECK(s.next(now) == "c");
+    CHECK(!s.next(now));
+}
+
+void attachBeforeRefresh() {
+    EnrichScheduler s(options());
+    EnrichScheduler::TimePoint now{};
+    CHECK(s.request("r1", Priority::Refresh, now));
+    CHECK(s.request("r2", Priority::Refresh, now));
+    CHECK(s.request("a1", Priority::Attach, now));
+    CHECK(s.request("a2", Priority::Attach, now));
+    // A waiting refresh asked for again as an attach is promoted, keeping
+    // its place in line among the attaches
+    CHECK(!s.request("r2", Priority::Attach, now));
+    CHECK(s.next(now) == "r2");
+    CHECK(s.next(now) == "a1");
+    s.finished("r2", true, now);
+    s.finished("a1", true, now);
+    CHECK(s.next(now) == "a2");
+    CHECK(s.next(now) == "r1");
+}
+
+void retriesWithBackoff() {
+    EnrichScheduler s(options());
+    EnrichScheduler::TimePoint now{};
+    CHECK(s.request("x", Priority::Attach, now));
+    const std::chrono::milliseconds expected[] = {1s, 2s, 4s};
+    for (const auto backoff : expected) {
+        CHECK(s.next(now) == "x");
+        const auto retryIn = s.finished("x", false, now);
+        CHECK(retryIn == backoff);
+        CHECK(s.nextDue() == now + backoff);
+        // Not due a moment early
+        CHECK(!s.next(now + backoff - 1ms));
+        now += backoff;
+    }
+    // Fourth failure: attempts exhausted, nothing left waiting
+    CHECK(s.next(now) == "x");
+    CHECK(!s.finished("x", false, now));
+    CHECK(!s.nextDue() && s.queued() == 0);
+    // Not throttled either: a later request starts over
+    CHECK(s.request("x", Priority::Refresh, now));
+}
+
+void cancelWhileRunning() {
+    EnrichScheduler s(options());
+    EnrichScheduler::TimePoint now{};
+    CHECK(s.request("x", Priority::Attach, now));
+    CHECK(s.next(now) == "x");
+    s.cancel("x");
+    // The run still holds its slot until it reports back; no retry follows
+    CHECK(s.running("x") && s.inFlight() == 1);
+    CHECK(!s.finished("x", false, now));
+    CHECK(s.inFlight() == 0 && s.queued() == 0);
+
+    // Re-attached while the cancelled run unwinds: queued once it finishes
+    CHECK(s.request("y", Priority::Attach, now));
+    CHECK(s.next(now) == "y");
+    s.cancel("y");
+    CHECK(s.request("y", Priority::Refresh, now));
+    CHECK(!s.next(now));
+    CHECK(!s.finished("y", true, now));
+    CHECK(s.queued() == 1);
+    CHECK(s.next(now) == "y");
+
+    // A cancelled waiting retry is dropped with its deadline
+    s.finished("y", false, now);
+    CHECK(s.nextDue());
+    s.cancel("y");
+    CHECK(!s.nextDue() && s.queued() == 0);
+}
+
+void throttleExpires() {
+    EnrichScheduler s(options());
+    EnrichScheduler::TimePoint now{};
+    CHECK(s.request("x", Priority::Attach, now));
+    CHECK(s.next(now) == "x");
+    s.finished("x", true, now);
+    CHECK(s.tracked() == 1);
+    CHECK(!s.request("x", Priority::Refresh, now + 30s - 1ms));
+    CHECK(s.request("x", Priority::Refresh, now + 30s));
+    CHECK(s.tracked() == 0);
+}
+
+void throttleEvictsLeastRecent() {
+    auto opts = options();
+    opts.maxInFlight = 8;
+    opts.maxTracked = 2;
+    EnrichScheduler s(opts);
+    EnrichScheduler::TimePoint now{};
+    for (const char* serial : {"a", "b", "c"}) {
+        CHECK(s.request(serial, Priority::Attach, now));
+        CHECK(s.next(now) == serial);
+        s.finished(serial, true, now);
+        now += 1s;
+    }
+    // Only the two most recent stay throttled
+    CHECK(s.tracked() == 2);
+    CHECK(s.request("a", Priority::Refresh, now));
+    CHECK(!s.request("b", Priority::Refresh, now));
+    CHECK(!s.request("c", Priority::Refresh, now));
+}
+} // namespace
+
+int main() {
+    capsInFlight();
+    attachBeforeRefresh();
+    retriesWithBackoff();
+    cancelWhileRunning();
+    throttleExpires();
+    throttleEvictsLeastRecent();
+    return check::finish("EnrichSchedulerTest");
+}
@@ -0,0 +1,196 @@
+// EventBus behaviour checks: per-uid merging for a lagging CoalescePerUid
+// subscriber, interest routing of filtered subscribers, and a reused
+// registry bit never carrying its previous holder's interest.
+
+#include <chrono>
+#include <future>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "core/EventBus.h"
+#include "Check.h"
+
+namespace {
+DeviceEvent event(DeviceEvent::Kind kind, const std::string& uid, std::uint32_t changed,
+                  const std::string& model = {}) {
+    DeviceEvent e;
+    e.kind = kind;
+    e.info.type = Type::Android;
+    e.info.uid = uid;
+    e.info.online = kind != DeviceEvent::Kind::Detach;
+    e.info.model = model;
+    e.changed = changed;
+    return e;
+}
+
+// Collects delivered events; the first one blocks until release().
+class Recorder {
+public:
+    explicit Recorder(bool holdFirst) : hold_(holdFirst) {
+        if (!hold_) entered_.set_value();
+    }
+
+    void operator()(const DeviceEvent& e) {
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            got_.push_back(e);
+        }
+        if (hold_) {
+            hold_ = false;
+            entered_.set_value();
+            release_.get_future().wait();
+        }
+    }
+
+    void waitEntered() { entered_.get_future().wait(); }
+    void release() { release_.set_value(); }
+
+    std::vector<DeviceEvent> events() {
+        std::lock_guard<std::mutex> lk(mtx_);
+        return got_;
+    }
+
+private:
+    bool hold_;
+    std::promise<void> entered_;
+    std::promise<void> release_;
+    std::mutex mtx_;
+    std::vector<DeviceEvent> got_;
+};
+
+bool waitDelivered(const EventBus& bus, int token, std::uint64_t n) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (std::chrono::steady_clock::now() < deadline) {
+        auto s = bus.stats(token);
+        if (s && s->delivered >= n && s->queued == 0) return true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return false;
+}
+
+void lagCoalescesPerUid() {
+    using K = DeviceEvent::Kind;
+    Recorder rec(true); // outlives the bus, which drains into it
+    EventBus bus(8);
+    EventBus::Options opts;
+    opts.overflow = EventBus::Overflow::CoalescePerUid;
+    const int token = bus.subscribe([&rec](const DeviceEvent& e) { rec(e); }, opts);
+    CHECK(token > 0);
+
+    bus.publish(event(K::Attach, "gate", DeviceField::All));
+    rec.waitEntered();
+    // Six events behind on a ring of eight: more than half, so the
+    // subscriber catches up coalesced.
+    bus.publish(event(K::Attach, "a", DeviceField::All, "M1"));
+    bus.publish(event(K::InfoUpdated, "a", DeviceField::Model, "M2"));
+    bus.publish(event(K::Detach, "b", DeviceField::All));
+    bus.publish(event(K::Attach, "b", DeviceField::All, "B"));
+    bus.publish(event(K::InfoUpdated, "c", DeviceField::Model, "C1"));
+    bus.publish(event(K::InfoUpdated, "c", DeviceField::OsVersion, "C2"));
+    rec.release();
+    CHECK(waitDelivered(bus, token, 4));
+
+    const auto got = rec.events();
+    CHECK(got.size() == 4);
+    if (got.size() != 4) return;
+    // Attach + InfoUpdated: still an Attach, with the newer info
+    CHECK(got[1].info.uid == "a");
+    CHECK(got[1].kind == K::Attach);
+    CHECK(got[1].info.model == "M2");
+    CHECK(got[1].changed == DeviceField::All);
+    // Detach + Attach: the device came back
+    CHECK(got[2].info.uid == "b");
+    CHECK(got[2].kind == K::Attach);
+    CHECK(got[2].info.online);
+    // InfoUpdated + InfoUpdated: both changed bits survive
+    CHECK(got[3].info.uid == "c");
+    CHECK(got[3].kind == K::InfoUpdated);
+    CHECK(got[3].info.model == "C2");
+    CHECK(got[3].changed == (DeviceField::Model | DeviceField::OsVersion));
+
+    auto s = bus.stats(token);
+    CHECK(s && s->coalesced == 3);
+    CHECK(s && s->dropped == 0);
+}
+
+void filtersRouteByInterest() {
+    using K = DeviceEvent::Kind;
+    Recorder all(false), one(false), detaches(false);
+    EventBus bus(8);
+    const int tAll = bus.subscribe([&all](const DeviceEvent& e) { all(e); }, {});
+    EventBus::Options byUid;
+    byUid.filter.uids = {"x"};
+    const int tOne = bus.subscribe([&one](const DeviceEvent& e) { one(e); }, byUid);
+    EventBus::Options byKind;
+    byKind.filter.kinds = EventFilter::kindBit(K::Detach);
+    const int tDet = bus.subscribe([&detaches](const DeviceEvent& e) { detaches(e); }, byKind);
+
+    // More than a ring of events nobody but tAll wants. The filtered
+    // subscribers are Block (the default): they must skip these without
+    // ever being woken for them and without stalling the writer.
+    for (int i = 0; i < 20; ++i) bus.publish(event(K::Attach, fmt::format("n{}", i), DeviceField::All));
+    bus.publish(event(K::Attach, "x", DeviceField::All));
+    bus.publish(event(K::Detach, "y", DeviceField::All));
+    CHECK(waitDelivered(bus, tAll, 22));
+    CHECK(waitDelivered(bus, tOne, 1));
+    CHECK(waitDelivered(bus, tDet, 1));
+
+    const auto gotOne = one.events();
+    CHECK(gotOne.size() == 1 && gotOne[0].info.uid == "x");
+    const auto gotDet = detaches.events();
+    CHECK(gotDet.size() == 1 && gotDet[0].info.uid == "y");
+    auto s = bus.stats(tOne);
+    CHECK(s && s->enqueued == 1 && s->dropped == 0);
+    s = bus.stats(tDet);
+    CHECK(s && s->enqueued == 1 && s->dropped == 0);
+
+    // Unsubscribed: no longer in the interest index
+    bus.unsubscribe(tOne);
+    bus.publish(event(K::InfoUpdated, "x", DeviceField::Model, "later"));
+    CHECK(waitDelivered(bus, tAll, 23));
+    CHECK(one.events().size() == 1);
+}
+
+// The writer matches an event against the interest index it loaded before
+// stamping the slot. A subscriber that reuses a registry bit freed meanwhile
+// must not receive what the bit's previous holder wanted.
+void reusedBitKeepsOwnFilter() {
+    using K = DeviceEvent::Kind;
+    Recorder mine(false); // outlives the bus, which drains into it
+    EventBus bus(8);
+    const int any = bus.subscribe([](const DeviceEvent&) {}, {});
+    EventBus::Options byUid;
+    byUid.filter.uids = {"z"}; // puts a uid lookup into every match
+    CHECK(bus.subscribe([](const DeviceEvent&) {}, byUid) > 0);
+
+    // Hashing a huge uid keeps the writer inside match() while the bit of
+    // `any` is freed and reclaimed.
+    std::promise<void> started;
+    std::thread writer([&]() {
+        const DeviceEvent e = event(K::Attach, std::string(std::size_t{64} << 20, 'u'), DeviceField::All);
+        started.set_value();
+        bus.publish(e);
+    });
+    started.get_future().wait();
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    bus.unsubscribe(any);
+    byUid.filter.uids = {"mine"};
+    const int own = bus.subscribe([&mine](const DeviceEvent& e) { mine(e); }, byUid);
+    writer.join();
+    bus.publish(event(K::Attach, "mine", DeviceField::All));
+    CHECK(waitDelivered(bus, own, 1));
+    const auto got = mine.events();
+    CHECK(got.size() == 1 && got[0].info.uid == "mine");
+}
+} // namespace
+
+int main() {
+    lagCoalescesPerUid();
+    filtersRouteByInterest();
+    reusedBitKeepsOwnFilter();
+    return check::finish("EventBusTest");
+}
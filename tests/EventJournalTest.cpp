@@ -0,0 +1,144 @@
+// EventJournal checks: restore() starts at the newest segment whose
+// checkpoint is complete, falls back past a torn one, and replay() still
+// reads every segment.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <fmt/core.h>
+
+#ifndef _WIN32
+#include <csignal>
+#include <sys/resource.h>
+#endif
+
+#include "core/EventJournal.h"
+#include "Check.h"
+
+namespace fs = std::filesystem;
+
+namespace {
+DeviceEvent attach(const std::string& uid) {
+    DeviceEvent e;
+    e.kind = DeviceEvent::Kind::Attach;
+    e.info.type = Type::Android;
+    e.info.uid = uid;
+    e.info.online = true;
+    return e;
+}
+
+std::vector<fs::path> segments(const fs::path& dir) {
+    std::vector<fs::path> out;
+    for (const auto& de : fs::directory_iterator(dir)) out.push_back(de.path());
+    std::sort(out.begin(), out.end());
+    return out;
+}
+
+// Writes one segment per journal lifetime; segment n's checkpoint holds
+// "s0".."s{n-1}" and its one event is "e{n}".
+void writeSegments(const fs::path& dir, int n) {
+    for (int i = 0; i < n; ++i) {
+        EventJournal::Options opts;
+        opts.dir = dir.string();
+        EventJournal j(opts);
+        CHECK(j.open([i]() {
+            std::vector<EventJournal::Entry> state;
+            for (int k = 0; k < i; ++k) {
+                EventJournal::Entry e;
+                e.state = true;
+                e.evt = attach(fmt::format("s{}", k));
+                state.push_back(e);
+            }
+            return state;
+        }));
+        j.append(attach(fmt::format("e{}", i)), std::chrono::system_clock::now());
+        j.flush();
+    }
+}
+
+std::vector<std::string> uids(std::size_t (*read)(const std::string&, const std::function<void(const EventJournal::Entry&)>&),
+                              const fs::path& dir) {
+    std::vector<std::string> out;
+    read(dir.string(), [&out](const EventJournal::Entry& e) { out.push_back(e.evt.info.uid); });
+    return out;
+}
+
+void restoreSkipsOldSegments(const fs::path& dir) {
+    writeSegments(dir, 3);
+    CHECK(segments(dir).size() == 3);
+    // Newest segment: checkpoint s0 s1, then e2
+    const auto restored = uids(&EventJournal::restore, dir);
+    CHECK((restored == std::vector<std::string>{"s0", "s1", "e2"}));
+    // Full history: e0 | s0 e1 | s0 s1 e2
+    CHECK(uids(&EventJournal::replay, dir).size() == 6);
+}
+
+void restoreFallsBackPastTornCheckpoint(const fs::path& dir) {
+    writeSegments(dir, 3);
+    const auto segs = segments(dir);
+    // Cut the newest segment inside its second checkpoint record: past the
+    // 12-byte header and the first frame (8-byte frame header + payload)
+    const auto newest = segs.back();
+    std::ifstream in(newest, std::ios::binary);
+    unsigned char len[4] = {};
+    in.seekg(12);
+    in.read(reinterpret_cast<char*>(len), sizeof(len));
+    in.close();
+    const std::uintmax_t first = 8 + (len[0] | len[1] << 8 | len[2] << 16 | static_cast<std::uint32_t>(len[3]) << 24);
+    fs::resize_file(newest, 12 + first + 4);
+    const auto restored = uids(&EventJournal::restore, dir);
+    CHECK((restored == std::vector<std::string>{"s0", "e1", "s0"}));
+}
+
+#ifndef _WIN32
+// A group the file system refuses (here: past RLIMIT_FSIZE) ends its segment;
+// the journal carries on in a fresh one whose checkpoint covers the lost group.
+void failedGroupWriteRotates(const fs::path& dir) {
+    std::signal(SIGXFSZ, SIG_IGN);
+    rlimit old{};
+    getrlimit(RLIMIT_FSIZE, &old);
+
+    EventJournal::Options opts;
+    opts.dir = dir.string();
+    opts.commitInterval = std::chrono::hours(1); // only flush() commits
+    EventJournal j(opts);
+    CHECK(j.open([]() {
+        EventJournal::Entry e;
+        e.state = true;
+        e.evt = attach("s0");
+        return std::vector<EventJournal::Entry>{e};
+    }));
+    rlimit lim = old;
+    lim.rlim_cur = 4096;
+    setrlimit(RLIMIT_FSIZE, &lim);
+    for (int i = 0; i < 200; ++i) j.append(attach(fmt::format("big{:04}", i)), std::chrono::system_clock::now());
+    j.flush();
+    setrlimit(RLIMIT_FSIZE, &old);
+
+    j.append(attach("after"), std::chrono::system_clock::now());
+    j.flush();
+    CHECK(segments(dir).size() == 2);
+    const auto restored = uids(&EventJournal::restore, dir);
+    CHECK((restored == std::vector<std::string>{"s0", "after"}));
+}
+#endif
+} // namespace
+
+int main() {
+    const auto base = fs::temp_directory_path() /
+                      fmt::format("dw-journaltest-{}", std::chrono::steady_clock::now().time_since_epoch().count());
+    restoreSkipsOldSegments(base / "a");
+    restoreFallsBackPastTornCheckpoint(base / "b");
+#ifndef _WIN32
+    failedGroupWriteRotates(base / "c");
+#endif
+    std::error_code ec;
+    fs::remove_all(base, ec);
+
+    return check::finish("EventJournalTest");
+}
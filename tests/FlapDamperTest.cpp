@@ -0,0 +1,86 @@
+// FlapDamper checks: the incrementally kept flapping count agrees with the
+// decayed penalties as holds start, extend and expire, and only offline
+// devices are forgotten once their penalty has decayed away.
+
+#include <chrono>
+#include <random>
+#include <string>
+
+#include <fmt/core.h>
+
+#include "core/FlapDamper.h"
+#include "Check.h"
+
+namespace {
+using namespace std::chrono_literals;
+
+std::size_t scanCount(const FlapDamper& d, FlapDamper::TimePoint now) {
+    return d.flapping(now).size();
+}
+
+void countFollowsDecay() {
+    FlapDamper d;
+    FlapDamper::TimePoint now{};
+    const std::string uid = "dev";
+    d.report(uid, true, now);
+    CHECK(d.flappingCount(now) == 0);
+    // Five quick transitions: past the threshold even with a little decay
+    for (int i = 0; i < 5; ++i) {
+        now += 1s;
+        d.report(uid, i % 2 == 1, now);
+    }
+    CHECK(d.flappingCount(now) == 1);
+    CHECK(d.state(uid, now) && d.state(uid, now)->flapping);
+    // A half-life later the penalty is below the threshold again
+    now += d.options().halfLife;
+    CHECK(d.flappingCount(now) == 0);
+    CHECK(scanCount(d, now) == 0);
+}
+
+void randomAgainstScan() {
+    FlapDamper d;
+    std::mt19937 rng(7);
+    FlapDamper::TimePoint now{};
+    std::vector<bool> online(50, false);
+    for (int step = 0; step < 20000; ++step) {
+        now += std::chrono::milliseconds(rng() % 2000);
+        const std::size_t i = rng() % online.size();
+        if (rng() % 4 != 0) online[i] = !online[i];
+        d.report(fmt::format("u{}", i), online[i], now);
+        if (step % 97 == 0) CHECK(d.flappingCount(now) == scanCount(d, now));
+    }
+    now += 1h;
+    CHECK(d.flappingCount(now) == 0);
+}
+
+void forgetsOnlyOffline() {
+    FlapDamper d;
+    FlapDamper::TimePoint now{};
+    d.report("up", true, now);
+    d.report("down", true, now);
+    for (int i = 0; i < 3; ++i) {
+        now += 1s;
+        d.report("up", i % 2 == 1, now);
+        d.report("down", i % 2 == 1, now);
+    }
+    d.report("up", true, now); // back online
+    CHECK(d.state("up", now) && d.state("up", now)->transitions == 4);
+    CHECK(d.state("down", now) && d.state("down", now)->transitions == 3);
+
+    // Long decayed; any report prunes what is due
+    now += 1h;
+    d.report("other", true, now);
+    CHECK(!d.state("down", now));
+    // Still online: its detach is a transition, not a first sighting
+    CHECK(d.state("up", now));
+    d.report("up", false, now);
+    CHECK(d.state("up", now) && d.state("up", now)->transitions == 5);
+}
+} // namespace
+
+int main() {
+    countFollowsDecay();
+    randomAgainstScan();
+    forgetsOnlyOffline();
+    return check::finish("FlapDamperTest");
+}
@@ -0,0 +1,165 @@
+// MetricsServer over real sockets on an ephemeral port: /metrics answers 200
+// with well-formed Prometheus text, other paths 404 and other methods 405,
+// a client that never sends its request is dropped at the deadline, and the
+// server serves again after stop() and start().
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <set>
+#include <sstream>
+#include <string>
+#include <system_error>
+
+#include <asio.hpp>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "core/DeviceManager.h"
+#include "core/MetricsServer.h"
+#include "Check.h"
+
+namespace {
+using namespace std::chrono_literals;
+using asio::ip::tcp;
+
+struct Reply {
+    std::string status; // "200 OK"
+    std::string headers;
+    std::string body;
+};
+
+// Sends request (may be empty) and reads until the server closes, giving up
+// after a few seconds so a server that never answers fails the checks
+// instead of hanging the test.
+std::string roundTrip(unsigned short port, const std::string& request) {
+    asio::io_context io;
+    tcp::socket sock(io);
+    sock.connect(tcp::endpoint(asio::ip::make_address("127.0.0.1"), port));
+    if (!request.empty()) asio::write(sock, asio::buffer(request));
+    std::string raw;
+    std::array<char, 4096> chunk{};
+    std::function<void(std::error_code, std::size_t)> onRead = [&](std::error_code ec, std::size_t n) {
+        raw.append(chunk.data(), n);
+        if (!ec) sock.async_read_some(asio::buffer(chunk), onRead);
+    };
+    sock.async_read_some(asio::buffer(chunk), onRead);
+    io.run_for(3s);
+    return raw;
+}
+
+Reply request(unsigned short port, const std::string& method, const std::string& target) {
+    const std::string raw = roundTrip(port, fmt::format("{} {} HTTP/1.1\r\nHost: localhost\r\n\r\n", method, target));
+    Reply r;
+    const auto eol = raw.find("\r\n");
+    const auto end = raw.find("\r\n\r\n");
+    if (eol == std::string::npos || end == std::string::npos || raw.compare(0, 9, "HTTP/1.1 ") != 0) return r;
+    r.status = raw.substr(9, eol - 9);
+    r.headers = raw.substr(eol + 2, end - eol - 2);
+    r.body = raw.substr(end + 4);
+    return r;
+}
+
+bool isNumber(const std::string& s) {
+    if (s == "+Inf" || s == "-Inf" || s == "NaN") return true;
+    char* end = nullptr;
+    std::strtod(s.c_str(), &end);
+    return !s.empty() && *end == '\0';
+}
+
+// Every sample belongs to a family declared by a preceding # TYPE, HELP and
+// TYPE come in pairs, and each sample line is `name[{labels}] value`.
+void checkExposition(const std::string& body) {
+    CHECK(!body.empty() && body.back() == '\n');
+    std::set<std::string> families;
+    std::set<std::string> histograms;
+    std::istringstream in(body);
+    std::string line;
+    std::string helped;
+    int samples = 0;
+    while (std::getline(in, line)) {
+        if (line.rfind("# HELP ", 0) == 0) {
+            helped = line.substr(7, line.find(' ', 7) - 7);
+            continue;
+        }
+        if (line.rfind("# TYPE ", 0) == 0) {
+            std::istringstream t(line.substr(7));
+            std::string name;
+            std::string type;
+            t >> name >> type;
+            CHECK(name == helped);
+            CHECK(type == "counter" || type == "gauge" || type == "histogram");
+            families.insert(name);
+            if (type == "histogram") histograms.insert(name);
+            continue;
+        }
+        CHECK(line.empty() || line[0] != '#');
+        const auto space = line.rfind(' ');
+        CHECK(space != std::string::npos);
+        if (space == std::string::npos) continue;
+        CHECK(isNumber(line.substr(space + 1)));
+        std::string name = line.substr(0, std::min(line.find('{'), space));
+        if (line.find('{') < space) CHECK(line[space - 1] == '}');
+        for (const char* suffix : {"_bucket", "_sum", "_count"}) {
+            const std::string sfx = suffix;
+            if (name.size() > sfx.size() && name.compare(name.size() - sfx.size(), sfx.size(), sfx) == 0 &&
+                histograms.count(name.substr(0, name.size() - sfx.size()))) {
+                name.resize(name.size() - sfx.size());
+                break;
+            }
+        }
+        CHECK(families.count(name) == 1);
+        ++samples;
+    }
+    CHECK(samples > 0);
+}
+
+void servesMetrics(MetricsServer& server) {
+    const auto port = server.port();
+    CHECK(port != 0);
+
+    const Reply ok = request(port, "GET", "/metrics");
+    CHECK(ok.status == "200 OK");
+    CHECK(ok.headers.find("Content-Type: text/plain; version=0.0.4") != std::string::npos);
+    CHECK(ok.headers.find(fmt::format("Content-Length: {}", ok.body.size())) != std::string::npos);
+    CHECK(ok.body.find("# TYPE devicewatcher_events_in_total counter\n") != std::string::npos);
+    CHECK(ok.body.find("devicewatcher_devices{type=\"android\",state=\"online\"} 0\n") != std::string::npos);
+    CHECK(ok.body.find("# TYPE devicewatcher_stage_latency_seconds histogram\n") != std::string::npos);
+    checkExposition(ok.body);
+
+    CHECK(request(port, "GET", "/metrics?name[]=x").status == "200 OK");
+    CHECK(request(port, "GET", "/other").status == "404 Not Found");
+    CHECK(request(port, "POST", "/metrics").status == "405 Method Not Allowed");
+}
+
+void dropsSilentClient(MetricsServer& server) {
+    const auto start = std::chrono::steady_clock::now();
+    const std::string raw = roundTrip(server.port(), "");
+    const auto took = std::chrono::steady_clock::now() - start;
+    CHECK(raw.empty());
+    // Closed at the 200ms deadline, well before a stuck client would be noticed
+    CHECK(took >= 150ms && took < 3s);
+    // The listener is still serving afterwards
+    CHECK(request(server.port(), "GET", "/metrics").status == "200 OK");
+}
+} // namespace
+
+int main() {
+    spdlog::set_level(spdlog::level::warn);
+    DeviceManager manager;
+    MetricsServer server(manager, 200ms);
+    CHECK(!server.start("no-port"));
+    CHECK(server.start("127.0.0.1:0"));
+    servesMetrics(server);
+    dropsSilentClient(server);
+
+    // Restartable: a second start() after stop() must serve again
+    server.stop();
+    CHECK(server.port() == 0);
+    CHECK(server.start("127.0.0.1:0"));
+    servesMetrics(server);
+    server.stop();
+    return check::finish("MetricsServerTest");
+}
@@ -0,0 +1,92 @@
+// PersistentMap/PersistentSet checks against std::unordered_map: random
+// insert/erase with lookups and full iteration, forced hash collisions, and
+// old versions staying intact after later edits.
+
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "core/PersistentMap.h"
+#include "Check.h"
+
+namespace {
+// Few distinct hashes, so leaves collide and branches split deep.
+struct PoorHash {
+    std::size_t operator()(const std::string& s) const { return std::hash<std::string>{}(s) & 0x3F; }
+};
+
+template <class Map, class Ref>
+bool sameAs(const Map& m, const Ref& ref) {
+    if (m.size() != ref.size() || m.empty() != ref.empty()) return false;
+    std::size_t seen = 0;
+    for (const auto& kv : m) {
+        auto it = ref.find(kv.first);
+        if (it == ref.end() || it->second != kv.second) return false;
+        ++seen;
+    }
+    if (seen != ref.size()) return false;
+    for (const auto& kv : ref) {
+        auto it = m.find(kv.first);
+        if (it == m.end() || it->second != kv.second) return false;
+    }
+    return true;
+}
+
+template <class Hash>
+void randomAgainstReference(unsigned seed) {
+    std::mt19937 rng(seed);
+    PersistentMap<std::string, int, Hash> m;
+    std::unordered_map<std::string, int> ref;
+    std::vector<std::pair<PersistentMap<std::string, int, Hash>, std::unordered_map<std::string, int>>> versions;
+
+    for (int step = 0; step < 20000; ++step) {
+        const std::string key = fmt::format("k{}", rng() % 2000);
+        if (rng() % 3 == 0) {
+            CHECK(m.erase(key) == (ref.erase(key) == 1));
+        } else {
+            const int v = static_cast<int>(rng() % 1000);
+            m.insert({key, v});
+            ref[key] = v;
+        }
+        CHECK(m.size() == ref.size());
+        if (step % 2500 == 0) versions.emplace_back(m, ref);
+    }
+    CHECK(sameAs(m, ref));
+    // Earlier versions are untouched by everything after them
+    for (const auto& v : versions) CHECK(sameAs(v.first, v.second));
+
+    for (const auto& kv : ref) CHECK(m.erase(kv.first));
+    CHECK(m.empty());
+    CHECK(m.begin() == m.end());
+    CHECK(m.find("k1") == m.end());
+}
+
+void setBasics() {
+    PersistentSet<std::string> s;
+    std::unordered_set<std::string> ref;
+    for (int i = 0; i < 500; ++i) {
+        s.insert(fmt::format("u{}", i));
+        ref.insert(fmt::format("u{}", i));
+    }
+    const auto before = s;
+    s.insert("u1");
+    CHECK(s.size() == 500);
+    CHECK(s.erase("u7"));
+    CHECK(!s.erase("u7"));
+    CHECK(s.count("u7") == 0 && before.count("u7") == 1);
+    std::size_t n = 0;
+    for (const auto& uid : before) n += ref.count(uid);
+    CHECK(n == 500);
+}
+} // namespace
+
+int main() {
+    randomAgainstReference<std::hash<std::string>>(1);
+    randomAgainstReference<PoorHash>(2);
+    setBasics();
+    return check::finish("PersistentMapTest");
+}
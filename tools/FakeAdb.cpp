@@ -0,0 +1,280 @@
+#include "FakeAdb.h"
+
+#include <charconv>
+
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "providers/AdbProtocol.h"
+
+using asio::ip::tcp;
+
+namespace fakeadb {
+namespace {
+std::string fail(std::string_view msg) {
+    return "FAIL" + frame(msg);
+}
+
+void putVarint(std::string& out, std::uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back(static_cast<char>((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+    out.push_back(static_cast<char>(v));
+}
+
+void putBytes(std::string& out, std::uint32_t field, std::string_view v) {
+    if (v.empty()) return;
+    putVarint(out, field << 3 | 2);
+    putVarint(out, v.size());
+    out.append(v);
+}
+
+void putNumber(std::string& out, std::uint32_t field, std::uint64_t v) {
+    putVarint(out, field << 3);
+    putVarint(out, v);
+}
+
+int stateNumber(std::string_view name) {
+    for (int s = 0; s <= static_cast<int>(adb::ConnectionState::Rescue); ++s) {
+        if (adb::connectionStateName(s) == name) return s;
+    }
+    return static_cast<int>(adb::ConnectionState::Any);
+}
+} // namespace
+
+std::string frame(std::string_view payload) {
+    return fmt::format("{:04x}", payload.size()) + std::string(payload);
+}
+
+std::string protoBlock(std::string_view textBlock) {
+    std::string out;
+    adb::forEachLine(textBlock, [&out](std::string_view line) {
+        adb::TrackLine t;
+        if (!adb::parseTrackLine(line, t)) return;
+        // Field numbers as in adb_host.proto's Device
+        std::string dev;
+        putBytes(dev, 1, t.serial);
+        putNumber(dev, 2, static_cast<std::uint64_t>(stateNumber(t.state)));
+        putBytes(dev, 3, t.usb);
+        putBytes(dev, 4, t.product);
+        putBytes(dev, 5, t.model);
+        putBytes(dev, 6, t.device);
+        putNumber(dev, 7, static_cast<std::uint64_t>(t.usb.empty() ? adb::ConnectionType::Socket
+                                                                   : adb::ConnectionType::Usb));
+        std::uint64_t transportId = 0;
+        std::from_chars(t.transportId.data(), t.transportId.data() + t.transportId.size(), transportId);
+        putNumber(dev, 10, transportId);
+        std::string entry;
+        putBytes(entry, 1, dev);
+        if (out.size() + entry.size() <= kMaxBlock) out += entry;
+    });
+    return out;
+}
+
+Session::Session(Server& server, tcp::socket socket)
+    : server_(server), socket_(std::move(socket)), timer_(socket_.get_executor()) {}
+
+void Session::close() {
+    std::error_code ec;
+    socket_.close(ec);
+}
+
+Server::Server(asio::io_context& io, unsigned short port, ServerOptions opts)
+    : acceptor_(io, tcp::endpoint(asio::ip::make_address("127.0.0.1"), port)),
+      port_(acceptor_.local_endpoint().port()), opts_(opts), rng_(port_) {}
+
+void Server::publish(std::string block) {
+    if (block.size() > kMaxBlock) {
+        // Keep whole lines only
+        const auto cut = block.rfind('\n', kMaxBlock - 1);
+        block.resize(cut == std::string::npos ? 0 : cut + 1);
+        if (!truncatedWarned_) {
+            spdlog::warn("[fake-adb] :{} device list exceeds {} bytes; truncating (use more --servers)", port_,
+                         kMaxBlock);
+            truncatedWarned_ = true;
+        }
+    }
+    if (block == block_) return;
+    block_ = std::move(block);
+    proto_ = protoBlock(block_);
+    states_.clear();
+    adb::forEachLine(block_, [this](std::string_view line) {
+        adb::TrackLine t;
+        if (adb::parseTrackLine(line, t)) states_[std::string(t.serial)] = {std::string(t.state), std::string(t.model)};
+    });
+    const std::string text = frame(block_);
+    const std::string proto = frame(proto_);
+    for (auto it = trackers_.begin(); it != trackers_.end();) {
+        if (auto s = it->session.lock()) {
+            const std::string& data = it->proto ? proto : text;
+            s->push(data);
+            ++stats_.blocks;
+            stats_.bytes += data.size();
+            ++it;
+        } else {
+            it = trackers_.erase(it);
+        }
+    }
+}
+
+void Server::dropTrackers() {
+    for (auto& t : trackers_) {
+        if (auto s = t.session.lock()) s->close();
+    }
+    trackers_.clear();
+}
+
+std::string Server::transportError(const std::string& serial) {
+    auto it = states_.find(serial);
+    if (it == states_.end()) return fmt::format("device '{}' not found", serial);
+    if (it->second.state != "device") return fmt::format("device {}", it->second.state);
+    if (opts_.failRate > 0 && std::uniform_real_distribution<double>(0, 1)(rng_) < opts_.failRate) {
+        return "device still connecting";
+    }
+    return {};
+}
+
+std::vector<std::pair<std::string, std::string>> Server::props(const std::string& serial, bool full) const {
+    std::string model;
+    if (auto it = states_.find(serial); it != states_.end()) model = it->second.model;
+    std::vector<std::pair<std::string, std::string>> p = {
+        {"ro.build.fingerprint", fmt::format("fake/{}/{}:14/FAKE.240101.001/1:user/release-keys", model, serial)},
+        {"ro.build.version.release", "14"},
+        {"ro.build.version.sdk", "34"},
+        {"ro.product.cpu.abi", "arm64-v8a"},
+        {"ro.product.manufacturer", "Fake"},
+        {"ro.product.model", model},
+        {"ro.serialno", serial},
+    };
+    if (full) {
+        for (int i = 0; i < 900; ++i) p.emplace_back(fmt::format("vendor.fake.prop{:04}", i), std::to_string(i % 7));
+    }
+    return p;
+}
+
+void Server::accept() {
+    acceptor_.async_accept([this](std::error_code ec, tcp::socket socket) {
+        if (ec) return;
+        std::make_shared<Session>(*this, std::move(socket))->start();
+        accept();
+    });
+}
+
+void Session::readRequest() {
+    auto self = shared_from_this();
+    asio::async_read(socket_, asio::buffer(lenBuf_), [self](std::error_code ec, std::size_t) {
+        if (ec) return;
+        std::size_t n = 0;
+        if (!adb::parseHexLen4(std::string_view(self->lenBuf_.data(), self->lenBuf_.size()), n)) return self->close();
+        self->req_.resize(n);
+        asio::async_read(self->socket_, asio::buffer(self->req_), [self](std::error_code ec2, std::size_t) {
+            if (ec2) return;
+            self->handle(self->req_);
+        });
+    });
+}
+
+void Session::handle(const std::string& req) {
+    auto& stats = server_.stats();
+    if (!serial_.empty()) return handleShell(req);
+    if (req == "host:track-devices-l") return track(false);
+    if (req == "host:track-devices-proto-binary" && server_.options().proto) return track(true);
+    const std::string prefix = "host:transport:";
+    if (req.rfind(prefix, 0) == 0) {
+        ++stats.transports;
+        const std::string serial = req.substr(prefix.size());
+        const std::string err = server_.transportError(serial);
+        if (!err.empty()) {
+            ++stats.fails;
+            return reply(fail(err), true);
+        }
+        serial_ = serial;
+        auto self = shared_from_this();
+        return reply("OKAY", false, [self]() { self->readRequest(); });
+    }
+    ++stats.fails;
+    reply(fail("unknown host service"), true);
+}
+
+void Session::track(bool proto) {
+    auto self = shared_from_this();
+    reply("OKAY", false, [self, proto]() {
+        self->push(self->server_.framed(proto));
+        self->server_.addTracker(self, proto);
+        self->watchClose();
+    });
+}
+
+void Session::handleShell(const std::string& req) {
+    ++server_.stats().getprops;
+    std::string out = "OKAY";
+    if (req == "shell:getprop") {
+        for (const auto& kv : server_.props(serial_, true)) out += fmt::format("[{}]: [{}]\n", kv.first, kv.second);
+    } else if (req.rfind("shell:for p in ", 0) == 0) {
+        // The provider's targeted loop: "for p in k1 k2; do echo ...; done"
+        const std::string keys = req.substr(15, req.find(';') - 15);
+        const auto all = server_.props(serial_, false);
+        std::size_t pos = 0;
+        while (pos < keys.size()) {
+            auto end = keys.find(' ', pos);
+            if (end == std::string::npos) end = keys.size();
+            const std::string key = keys.substr(pos, end - pos);
+            pos = end + 1;
+            if (key.empty()) continue;
+            std::string value;
+            for (const auto& kv : all) {
+                if (kv.first == key) value = kv.second;
+            }
+            out += fmt::format("[{}]: [{}]\n", key, value);
+        }
+    } else if (req.rfind("shell:", 0) != 0) {
+        ++server_.stats().fails;
+        return reply(fail("unknown service"), true);
+    }
+    reply(std::move(out), true);
+}
+
+void Session::reply(std::string data, bool closeAfter, std::function<void()> next) {
+    auto self = shared_from_this();
+    auto send = [self, data = std::move(data), closeAfter, next = std::move(next)]() mutable {
+        self->push(std::move(data));
+        self->closeAfterWrite_ = closeAfter;
+        if (next) next();
+    };
+    if (server_.options().latency.count() == 0) return send();
+    timer_.expires_after(server_.options().latency);
+    timer_.async_wait([send = std::move(send)](std::error_code ec) mutable {
+        if (!ec) send();
+    });
+}
+
+void Session::push(std::string data) {
+    out_.push_back(std::move(data));
+    if (out_.size() == 1) write();
+}
+
+void Session::write() {
+    auto self = shared_from_this();
+    asio::async_write(socket_, asio::buffer(out_.front()), [self](std::error_code ec, std::size_t) {
+        if (ec) return self->close();
+        self->out_.pop_front();
+        if (!self->out_.empty()) return self->write();
+        if (self->closeAfterWrite_) {
+            std::error_code ignored;
+            self->socket_.shutdown(tcp::socket::shutdown_both, ignored);
+            self->close();
+        }
+    });
+}
+
+// Trackers never send again; a completed read means the client went away.
+void Session::watchClose() {
+    auto self = shared_from_this();
+    socket_.async_read_some(asio::buffer(sink_), [self](std::error_code ec, std::size_t) {
+        if (ec) return self->close();
+        self->watchClose();
+    });
+}
+
+} // namespace fakeadb
@@ -0,0 +1,141 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <asio.hpp>
+
+// The adb host protocol as FakeAdbServer speaks it, for the tool and for
+// tests that run AndroidAdbProvider against it in-process.
+//
+// Covered as far as the provider uses it: host:track-devices-l,
+// host:track-devices-proto-binary (only with ServerOptions::proto; FAIL
+// otherwise, so the provider's text fallback runs), host:transport:<serial>
+// followed by shell:getprop or a targeted getprop loop, and FAIL for
+// everything else.
+namespace fakeadb {
+
+// Length prefixes are 4 hex digits; a block cannot grow past this.
+constexpr std::size_t kMaxBlock = 0xFFFF;
+
+struct ServerOptions {
+    std::chrono::milliseconds latency{0}; // before every reply
+    double failRate{0};                   // share of host:transport answered with FAIL
+    bool proto{false};                    // serve host:track-devices-proto-binary
+};
+
+struct Stats {
+    std::uint64_t blocks{0};
+    std::uint64_t bytes{0};
+    std::uint64_t transports{0};
+    std::uint64_t getprops{0};
+    std::uint64_t fails{0};
+};
+
+// 4-hex length prefix + payload.
+std::string frame(std::string_view payload);
+
+// A track-devices-l block re-encoded as the Devices message adb sends on
+// host:track-devices-proto-binary. Devices that would push it past
+// kMaxBlock are left out.
+std::string protoBlock(std::string_view textBlock);
+
+class Server;
+
+// One client connection: reads requests and answers them in order.
+class Session : public std::enable_shared_from_this<Session> {
+public:
+    Session(Server& server, asio::ip::tcp::socket socket);
+
+    void start() { readRequest(); }
+    // Tracker connections get every new block.
+    void push(std::string data);
+    void close();
+
+private:
+    void readRequest();
+    void handle(const std::string& req);
+    void handleShell(const std::string& req);
+    void track(bool proto);
+    // Sends data after the configured latency; then either closes or keeps
+    // going with next.
+    void reply(std::string data, bool closeAfter, std::function<void()> next = {});
+    void write();
+    void watchClose();
+
+    Server& server_;
+    asio::ip::tcp::socket socket_;
+    asio::steady_timer timer_;
+    std::array<char, 4> lenBuf_{};
+    std::string req_;
+    std::string serial_; // set by host:transport
+    std::deque<std::string> out_;
+    bool closeAfterWrite_{false};
+    std::array<char, 64> sink_{};
+};
+
+// Listens on one port and serves the device list it is given. Every member
+// must be called on the io_context's thread.
+class Server {
+public:
+    // port 0 picks a free one; see port().
+    Server(asio::io_context& io, unsigned short port, ServerOptions opts);
+
+    void start() { accept(); }
+
+    // New device list as a track-devices-l block: remembered for later
+    // trackers and pushed to current ones, in each tracker's format.
+    void publish(std::string block);
+    // Closes every tracking connection, as a restarting adb server would.
+    void dropTrackers();
+
+    const std::string& block() const { return block_; }
+    const ServerOptions& options() const { return opts_; }
+    Stats& stats() { return stats_; }
+    unsigned short port() const { return port_; }
+    void addTracker(const std::shared_ptr<Session>& s, bool proto) { trackers_.push_back({s, proto}); }
+    std::size_t trackers() const { return trackers_.size(); }
+    // Current block framed for a new tracker.
+    std::string framed(bool proto) const { return frame(proto ? proto_ : block_); }
+
+    // Empty when the device is listed, else the FAIL message.
+    std::string transportError(const std::string& serial);
+
+    // Properties a virtual device reports; full adds the bulk of a real dump.
+    std::vector<std::pair<std::string, std::string>> props(const std::string& serial, bool full) const;
+
+private:
+    struct State {
+        std::string state;
+        std::string model;
+    };
+    struct Tracker {
+        std::weak_ptr<Session> session;
+        bool proto;
+    };
+
+    void accept();
+
+    asio::ip::tcp::acceptor acceptor_;
+    unsigned short port_;
+    ServerOptions opts_;
+    std::mt19937 rng_;
+    std::string block_;
+    std::string proto_; // block_ as a Devices message
+    std::unordered_map<std::string, State> states_; // serial -> last listed state
+    std::vector<Tracker> trackers_;
+    Stats stats_;
+    bool truncatedWarned_{false};
+};
+
+} // namespace fakeadb
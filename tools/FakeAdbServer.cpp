@@ -0,0 +1,394 @@
+// Stand-in ADB server for exercising AndroidAdbProvider without phones.
+//
+//   FakeAdbServer serve  [--port P] [--servers K] [--devices N] [--churn C] [--latency MS] [--fail-rate F] [--proto]
+//   FakeAdbServer record [--upstream HOST:PORT] --out FILE
+//   FakeAdbServer replay --in FILE [--port P] [--speed X] [--loop] [--latency MS] [--proto]
+//
+// serve scripts N virtual devices split over K servers on ports P..P+K-1
+// (point DW_ADB_SERVERS at them). C is device changes per second per server:
+// state flips, unplugs and replugs. F is the share of host:transport requests
+// answered with FAIL. --proto also serves host:track-devices-proto-binary;
+// without it that request gets FAIL, so the provider's text fallback runs.
+//
+// record connects to a real adb server and appends every track-devices-l
+// block to FILE with its arrival time; replay serves those blocks again at
+// X times the recorded pace.
+//
+// The protocol side lives in FakeAdb.h, shared with the provider tests.
+//
+// Recording format, one entry per block:
+//   @<ms since start> <bytes>\n<block>\n
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <asio.hpp>
+#include <fmt/core.h>
+#include <spdlog/spdlog.h>
+
+#include "FakeAdb.h"
+#include "providers/AdbProtocol.h"
+
+using asio::ip::tcp;
+using fakeadb::Server;
+using fakeadb::ServerOptions;
+using fakeadb::Stats;
+using fakeadb::frame;
+
+namespace {
+using SteadyClock = std::chrono::steady_clock;
+
+constexpr std::chrono::milliseconds kChurnTick(100);
+constexpr std::chrono::seconds kStatsInterval(10);
+
+struct Config {
+    std::string mode;
+    unsigned short port{15037};
+    std::size_t servers{1};
+    std::size_t devices{100};
+    double churn{0};
+    ServerOptions server;
+    std::string upstream{"127.0.0.1:5037"};
+    std::string file;
+    double speed{1};
+    bool loop{false};
+};
+
+struct VirtualDevice {
+    std::string serial;
+    std::string model;
+    std::string usb;
+    int transportId{0};
+    bool present{true};
+    bool online{true};
+};
+
+// Scripted devices behind one server, changed a few at a time.
+class Fleet {
+public:
+    Fleet(asio::io_context& io, Server& server, std::size_t first, std::size_t count, double churn)
+        : server_(server), timer_(io), churn_(churn), rng_(static_cast<unsigned>(first + 1)) {
+        static const char* kModels[] = {"Pixel_6", "Pixel_8", "SM_G973F", "moto_g_power", "M2101K6G", "CPH2451"};
+        for (std::size_t i = 0; i < count; ++i) {
+            VirtualDevice d;
+            d.serial = fmt::format("FAKE{:06}", first + i);
+            d.model = kModels[(first + i) % std::size(kModels)];
+            d.usb = fmt::format("{}-{}.{}", 1 + i / 64 % 4, 1 + i / 8 % 8, 1 + i % 8);
+            d.transportId = static_cast<int>(++nextTransport_);
+            devices_.push_back(std::move(d));
+        }
+        server_.publish(block());
+    }
+
+    void start() {
+        if (churn_ <= 0 || devices_.empty()) return;
+        tick();
+    }
+
+private:
+    std::string block() const {
+        std::string out;
+        for (const auto& d : devices_) {
+            if (!d.present) continue;
+            out += fmt::format("{}\t{} usb:{} product:{} model:{} device:{} transport_id:{}\n", d.serial,
+                               d.online ? "device" : "offline", d.usb, d.model, d.model, d.model, d.transportId);
+        }
+        return out;
+    }
+
+    void tick() {
+        timer_.expires_after(kChurnTick);
+        timer_.async_wait([this](std::error_code ec) {
+            if (ec) return;
+            pending_ += churn_ * std::chrono::duration<double>(kChurnTick).count();
+            bool changed = false;
+            std::uniform_int_distribution<std::size_t> pick(0, devices_.size() - 1);
+            for (; pending_ >= 1; pending_ -= 1) {
+                VirtualDevice& d = devices_[pick(rng_)];
+                if (!d.present) {
+                    d.present = true;
+                    d.online = true;
+                    d.transportId = static_cast<int>(++nextTransport_);
+                } else if (rng_() % 3 == 0) {
+                    d.present = false;
+                } else {
+                    d.online = !d.online;
+                }
+                changed = true;
+            }
+            if (changed) server_.publish(block());
+            tick();
+        });
+    }
+
+    Server& server_;
+    asio::steady_timer timer_;
+    double churn_;
+    double pending_{0};
+    std::mt19937 rng_;
+    std::vector<VirtualDevice> devices_;
+    std::uint64_t nextTransport_{0};
+};
+
+struct RecordedBlock {
+    std::chrono::milliseconds at;
+    std::string block;
+};
+
+std::vector<RecordedBlock> loadRecording(const std::string& path) {
+    std::vector<RecordedBlock> out;
+    std::ifstream in(path, std::ios::binary);
+    std::string header;
+    while (std::getline(in, header)) {
+        if (header.empty() || header[0] != '@') continue;
+        long long ms = 0;
+        std::size_t n = 0;
+        if (std::sscanf(header.c_str(), "@%lld %zu", &ms, &n) != 2) break;
+        RecordedBlock b{std::chrono::milliseconds(ms), std::string(n, '\0')};
+        if (n && !in.read(&b.block[0], static_cast<std::streamsize>(n))) break;
+        in.ignore(1); // trailing '\n'
+        out.push_back(std::move(b));
+    }
+    return out;
+}
+
+// Publishes recorded blocks on the recorded schedule, scaled by speed.
+class Replayer {
+public:
+    Replayer(asio::io_context& io, Server& server, std::vector<RecordedBlock> blocks, double speed, bool loop)
+        : server_(server), timer_(io), blocks_(std::move(blocks)), speed_(speed), loop_(loop) {}
+
+    void start() {
+        start_ = SteadyClock::now();
+        next_ = 0;
+        schedule();
+    }
+
+private:
+    void schedule() {
+        if (next_ >= blocks_.size()) {
+            spdlog::info("[fake-adb] replay finished ({} blocks)", blocks_.size());
+            if (loop_ && !blocks_.empty()) start();
+            return;
+        }
+        const auto at = std::chrono::duration_cast<SteadyClock::duration>(
+            std::chrono::duration<double, std::milli>(blocks_[next_].at.count() / speed_));
+        timer_.expires_at(start_ + at);
+        timer_.async_wait([this](std::error_code ec) {
+            if (ec) return;
+            server_.publish(blocks_[next_].block);
+            ++next_;
+            schedule();
+        });
+    }
+
+    Server& server_;
+    asio::steady_timer timer_;
+    std::vector<RecordedBlock> blocks_;
+    double speed_;
+    bool loop_;
+    SteadyClock::time_point start_;
+    std::size_t next_{0};
+};
+
+int record(const Config& cfg) {
+    if (cfg.file.empty()) {
+        fmt::print(stderr, "record needs --out FILE\n");
+        return 2;
+    }
+    const auto colon = cfg.upstream.rfind(':');
+    const std::string host = cfg.upstream.substr(0, colon);
+    const std::string port = colon == std::string::npos ? "5037" : cfg.upstream.substr(colon + 1);
+    try {
+        asio::io_context io;
+        tcp::socket socket(io);
+        asio::connect(socket, tcp::resolver(io).resolve(host, port));
+        asio::write(socket, asio::buffer(frame("host:track-devices-l")));
+        std::array<char, 4> status{};
+        asio::read(socket, asio::buffer(status));
+        if (std::string_view(status.data(), 4) != "OKAY") {
+            fmt::print(stderr, "upstream refused host:track-devices-l\n");
+            return 1;
+        }
+        std::ofstream out(cfg.file, std::ios::binary | std::ios::trunc);
+        out << "# devicewatcher track-devices recording v1\n";
+        const auto start = SteadyClock::now();
+        std::size_t blocks = 0;
+        for (;;) {
+            std::array<char, 4> len{};
+            asio::read(socket, asio::buffer(len));
+            std::size_t n = 0;
+            if (!adb::parseHexLen4(std::string_view(len.data(), len.size()), n)) {
+                fmt::print(stderr, "invalid length header from upstream\n");
+                return 1;
+            }
+            std::string block(n, '\0');
+            if (n) asio::read(socket, asio::buffer(&block[0], n));
+            const auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(SteadyClock::now() - start);
+            out << '@' << ms.count() << ' ' << n << '\n' << block << '\n';
+            out.flush();
+            spdlog::info("[fake-adb] recorded block {} ({} bytes) at {}ms", ++blocks, n, ms.count());
+        }
+    } catch (const std::exception& ex) {
+        // The upstream closing the stream ends a recording normally.
+        spdlog::info("[fake-adb] recording stopped: {}", ex.what());
+    }
+    return 0;
+}
+
+void usage(const char* argv0) {
+    fmt::print(stderr,
+               "Usage: {0} serve  [--port P] [--servers K] [--devices N] [--churn C] [--latency MS] [--fail-rate F]"
+               " [--proto]\n"
+               "       {0} record [--upstream HOST:PORT] --out FILE\n"
+               "       {0} replay --in FILE [--port P] [--speed X] [--loop] [--latency MS] [--proto]\n",
+               argv0);
+}
+
+// Whole string must be a number in [lo, hi], and whole if integral.
+bool parseNumber(const char* s, double lo, double hi, bool integral, double& out) {
+    char* end = nullptr;
+    out = std::strtod(s, &end);
+    if (end == s || *end != '\0' || !(out >= lo && out <= hi)) return false;
+    return !integral || out == std::floor(out);
+}
+
+// nullopt (after printing why) on an unknown flag or a bad/missing value.
+std::optional<Config> parseArgs(int argc, char** argv) {
+    Config cfg;
+    if (argc < 2) return std::nullopt;
+    cfg.mode = argv[1];
+    for (int i = 2; i < argc; ++i) {
+        const std::string a = argv[i];
+        if (a == "--proto") {
+            cfg.server.proto = true;
+            continue;
+        }
+        if (a == "--loop") {
+            cfg.loop = true;
+            continue;
+        }
+        const bool text = a == "--upstream" || a == "--out" || a == "--in";
+        double lo = 0, hi = 0;
+        bool integral = true;
+        if (a == "--port") hi = 65535;
+        else if (a == "--servers") { lo = 1; hi = 1024; }
+        else if (a == "--devices") hi = 1e6;
+        else if (a == "--latency") hi = 3600e3;
+        else if (a == "--churn") { hi = 1e6; integral = false; }
+        else if (a == "--fail-rate") { hi = 1; integral = false; }
+        else if (a == "--speed") { lo = 1e-3; hi = 1e6; integral = false; }
+        else if (!text) {
+            fmt::print(stderr, "unknown option {}\n", a);
+            return std::nullopt;
+        }
+        if (i + 1 >= argc) {
+            fmt::print(stderr, "{} needs a value\n", a);
+            return std::nullopt;
+        }
+        const char* v = argv[++i];
+        if (a == "--upstream") cfg.upstream = v;
+        else if (text) cfg.file = v;
+        if (text) continue;
+
+        double n = 0;
+        if (!parseNumber(v, lo, hi, integral, n)) {
+            fmt::print(stderr, "bad value for {}: {}\n", a, v);
+            return std::nullopt;
+        }
+        if (a == "--port") cfg.port = static_cast<unsigned short>(n);
+        else if (a == "--servers") cfg.servers = static_cast<std::size_t>(n);
+        else if (a == "--devices") cfg.devices = static_cast<std::size_t>(n);
+        else if (a == "--latency") cfg.server.latency = std::chrono::milliseconds(static_cast<long long>(n));
+        else if (a == "--churn") cfg.churn = n;
+        else if (a == "--fail-rate") cfg.server.failRate = n;
+        else cfg.speed = n;
+    }
+    if (cfg.port != 0 && cfg.port + cfg.servers - 1 > 65535) {
+        fmt::print(stderr, "--port {} with --servers {} runs past port 65535\n", cfg.port, cfg.servers);
+        return std::nullopt;
+    }
+    return cfg;
+}
+} // namespace
+
+int main(int argc, char** argv) {
+    const auto parsed = parseArgs(argc, argv);
+    if (!parsed) {
+        usage(argv[0]);
+        return 2;
+    }
+    const Config cfg = *parsed;
+    if (cfg.mode == "record") return record(cfg);
+    if (cfg.mode != "serve" && cfg.mode != "replay") {
+        usage(argv[0]);
+        return 2;
+    }
+
+    asio::io_context io;
+    std::vector<std::unique_ptr<Server>> servers;
+    std::vector<std::unique_ptr<Fleet>> fleets;
+    std::unique_ptr<Replayer> replayer;
+    try {
+        if (cfg.mode == "serve") {
+            for (std::size_t k = 0; k < cfg.servers; ++k) {
+                const std::size_t first = cfg.devices * k / cfg.servers;
+                const std::size_t count = cfg.devices * (k + 1) / cfg.servers - first;
+                servers.push_back(std::make_unique<Server>(io, static_cast<unsigned short>(cfg.port + k), cfg.server));
+                fleets.push_back(std::make_unique<Fleet>(io, *servers.back(), first, count, cfg.churn));
+                spdlog::info("[fake-adb] serving {} device(s) on 127.0.0.1:{}", count, cfg.port + k);
+            }
+        } else {
+            auto blocks = loadRecording(cfg.file);
+            if (blocks.empty()) {
+                fmt::print(stderr, "no blocks in {}\n", cfg.file);
+                return 1;
+            }
+            servers.push_back(std::make_unique<Server>(io, cfg.port, cfg.server));
+            spdlog::info("[fake-adb] replaying {} block(s) from {} at {}x on 127.0.0.1:{}", blocks.size(), cfg.file,
+                         cfg.speed, cfg.port);
+            replayer = std::make_unique<Replayer>(io, *servers.back(), std::move(blocks), cfg.speed, cfg.loop);
+        }
+    } catch (const std::exception& ex) {
+        fmt::print(stderr, "cannot listen: {}\n", ex.what());
+        return 1;
+    }
+    for (auto& s : servers) s->start();
+    for (auto& f : fleets) f->start();
+    if (replayer) replayer->start();
+
+    // Periodic totals, for throughput runs
+    asio::steady_timer statsTimer(io);
+    std::function<void()> report = [&]() {
+        statsTimer.expires_after(kStatsInterval);
+        statsTimer.async_wait([&](std::error_code ec) {
+            if (ec) return;
+            for (auto& s : servers) {
+                const Stats& st = s->stats();
+                spdlog::info("[fake-adb] :{} trackers={} blocks={} bytes={} transports={} getprops={} fails={}",
+                             s->port(), s->trackers(), st.blocks, st.bytes, st.transports, st.getprops, st.fails);
+            }
+            report();
+        });
+    };
+    report();
+
+    asio::signal_set signals(io, SIGINT, SIGTERM);
+    signals.async_wait([&](std::error_code, int) { io.stop(); });
+    io.run();
+    return 0;
+}